@@ -8,6 +8,7 @@
  */
 
 #include <string.h>
+#include <time.h>
 
 #include "protocol_examples_common.h"
 #include "sdkconfig.h"
@@ -15,12 +16,15 @@
 #include "esp_wifi.h"
 #include "esp_log.h"
 #include "esp_event_loop.h"
+#include "esp_timer.h"
 #include "tcpip_adapter.h"
+#include "nvs.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
 #include "lwip/err.h"
 #include "lwip/sys.h"
+#include "lwip/dhcp.h"
 
 #define GOT_IPV4_BIT BIT(0)
 #define GOT_IPV6_BIT BIT(1)
@@ -38,8 +42,9 @@
 
 static EventGroupHandle_t s_connect_event_group;
 static ip4_addr_t s_ip_addr;
-static char s_connection_name[32] = CONFIG_EXAMPLE_WIFI_SSID;
-static char s_connection_passwd[32] = CONFIG_EXAMPLE_WIFI_PASSWORD;
+// One byte longer than the Wi-Fi config fields so that the longest SSID and password stay terminated
+static char s_connection_name[33] = CONFIG_EXAMPLE_WIFI_SSID;
+static char s_connection_passwd[65] = CONFIG_EXAMPLE_WIFI_PASSWORD;
 
 #ifdef CONFIG_EXAMPLE_CONNECT_IPV6
 static ip6_addr_t s_ipv6_addr;
@@ -47,6 +52,169 @@ static ip6_addr_t s_ipv6_addr;
 
 static const char *TAG = "example_connect";
 
+static wifi_config_t s_wifi_config;
+static bool s_manual_reconnect;
+
+#ifdef CONFIG_EXAMPLE_WIFI_FAST_RECONNECT
+#define FAST_CONNECT_NAMESPACE "wifi_cache"
+#define FAST_CONNECT_KEY "last"
+#define FAST_CONNECT_VERSION 2
+// The system clock reads earlier than 2020-01-01 until SNTP has set it
+#define FAST_CONNECT_CLOCK_VALID 1577836800
+
+/* Last successful association and DHCP lease. Connection attempts go straight to
+ * the cached BSSID and channel instead of scanning. While less than half of the
+ * lease has passed, the leased address is also configured statically instead of
+ * running DHCP, and the DHCP client is restarted once connected to renew it. */
+typedef struct {
+    uint32_t version;
+    uint8_t ssid[32];
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint32_t lease_time;    // seconds, as offered by the DHCP server
+    int64_t acquired;       // UTC seconds when the lease was obtained, 0 if the clock was not set
+    tcpip_adapter_ip_info_t ip_info;
+    tcpip_adapter_dns_info_t dns;
+} fast_connect_cache_t;
+
+static fast_connect_cache_t s_cache;
+static bool s_cache_valid;
+static bool s_fast_attempt;
+static bool s_lease_reused;
+static bool s_got_ip;
+// Monotonic time the cached lease was obtained, when that happened during this boot
+static bool s_acquired_this_boot;
+static int64_t s_acquired_us;
+
+static void fast_connect_store(void)
+{
+    nvs_handle handle;
+    esp_err_t err = nvs_open(FAST_CONNECT_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(handle, FAST_CONNECT_KEY, &s_cache, sizeof(s_cache));
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to store connection cache: %s", esp_err_to_name(err));
+    }
+}
+
+static void fast_connect_load(void)
+{
+    nvs_handle handle;
+    size_t len = sizeof(s_cache);
+
+    s_cache_valid = false;
+    if (nvs_open(FAST_CONNECT_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return;
+    }
+    esp_err_t err = nvs_get_blob(handle, FAST_CONNECT_KEY, &s_cache, &len);
+    nvs_close(handle);
+
+    // A different layout or SSID means the cache belongs to another build or network
+    if (err != ESP_OK || len != sizeof(s_cache) || s_cache.version != FAST_CONNECT_VERSION ||
+            strncmp((char *)s_cache.ssid, s_connection_name, sizeof(s_cache.ssid)) != 0) {
+        return;
+    }
+    s_cache_valid = true;
+}
+
+static void fast_connect_invalidate(void)
+{
+    nvs_handle handle;
+
+    s_cache_valid = false;
+    s_acquired_this_boot = false;
+    if (nvs_open(FAST_CONNECT_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK) {
+        nvs_erase_key(handle, FAST_CONNECT_KEY);
+        nvs_commit(handle);
+        nvs_close(handle);
+    }
+}
+
+/* Record the AP and lease each time DHCP binds, after a full connection or a renewal */
+static void fast_connect_save(const tcpip_adapter_ip_info_t *ip_info)
+{
+    wifi_ap_record_t ap_info;
+    struct netif *netif;
+    struct dhcp *dhcp;
+
+    if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK ||
+            tcpip_adapter_get_netif(TCPIP_ADAPTER_IF_STA, (void **)&netif) != ESP_OK ||
+            (dhcp = netif_dhcp_data(netif)) == NULL) {
+        return;
+    }
+
+    memset(&s_cache, 0, sizeof(s_cache));
+    s_cache.version = FAST_CONNECT_VERSION;
+    memcpy(s_cache.ssid, s_connection_name, strnlen(s_connection_name, sizeof(s_cache.ssid)));
+    memcpy(s_cache.bssid, ap_info.bssid, sizeof(s_cache.bssid));
+    s_cache.channel = ap_info.primary;
+    s_cache.lease_time = dhcp->offered_t0_lease;
+    time_t now = time(NULL);
+    s_cache.acquired = now >= FAST_CONNECT_CLOCK_VALID ? now : 0;
+    s_cache.ip_info = *ip_info;
+    tcpip_adapter_get_dns_info(TCPIP_ADAPTER_IF_STA, TCPIP_ADAPTER_DNS_MAIN, &s_cache.dns);
+    s_cache_valid = true;
+    s_acquired_this_boot = true;
+    s_acquired_us = esp_timer_get_time();
+    fast_connect_store();
+}
+
+/* The cached address may be reused until half of the lease has passed, when a DHCP
+ * client would start renewing it. Without a known age, e.g. after a reboot before
+ * the clock is set, the address is requested again. */
+static bool fast_connect_lease_usable(void)
+{
+    int64_t age;
+    time_t now = time(NULL);
+
+    if (s_acquired_this_boot) {
+        age = (esp_timer_get_time() - s_acquired_us) / 1000000;
+    } else if (s_cache.acquired != 0 && now >= FAST_CONNECT_CLOCK_VALID) {
+        age = now - s_cache.acquired;
+    } else {
+        return false;
+    }
+    return age >= 0 && age < s_cache.lease_time / 2;
+}
+
+/* Configure the next connection attempt */
+static void fast_connect_prepare(void)
+{
+    s_got_ip = false;
+    s_fast_attempt = s_cache_valid;
+    s_lease_reused = s_fast_attempt && fast_connect_lease_usable();
+
+    if (s_fast_attempt) {
+        s_wifi_config.sta.bssid_set = true;
+        memcpy(s_wifi_config.sta.bssid, s_cache.bssid, sizeof(s_cache.bssid));
+        s_wifi_config.sta.channel = s_cache.channel;
+    } else {
+        s_wifi_config.sta.bssid_set = false;
+        s_wifi_config.sta.channel = 0;
+    }
+
+    if (s_lease_reused) {
+        tcpip_adapter_dhcpc_stop(TCPIP_ADAPTER_IF_STA);
+        tcpip_adapter_set_ip_info(TCPIP_ADAPTER_IF_STA, &s_cache.ip_info);
+        tcpip_adapter_set_dns_info(TCPIP_ADAPTER_IF_STA, TCPIP_ADAPTER_DNS_MAIN, &s_cache.dns);
+    } else {
+        tcpip_adapter_dhcpc_start(TCPIP_ADAPTER_IF_STA);
+    }
+
+    if (s_fast_attempt) {
+        ESP_LOGI(TAG, "Fast connect to %02x:%02x:%02x:%02x:%02x:%02x on channel %d with %s",
+                 s_cache.bssid[0], s_cache.bssid[1], s_cache.bssid[2], s_cache.bssid[3], s_cache.bssid[4], s_cache.bssid[5],
+                 s_cache.channel, s_lease_reused ? "cached lease" : "DHCP");
+    }
+    ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &s_wifi_config));
+}
+#endif // CONFIG_EXAMPLE_WIFI_FAST_RECONNECT
+
 static void on_wifi_disconnect(void *arg, esp_event_base_t event_base,
                                int32_t event_id, void *event_data)
 {
@@ -57,7 +225,18 @@ static void on_wifi_disconnect(void *arg, esp_event_base_t event_base,
         /*Switch to 802.11 bgn mode */
         esp_wifi_set_protocol(ESP_IF_WIFI_STA, WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N);
     }
-    ESP_ERROR_CHECK(esp_wifi_connect());
+#ifdef CONFIG_EXAMPLE_WIFI_FAST_RECONNECT
+    // The cached AP or lease did not work: drop it and do a full scan and DHCP
+    if (s_fast_attempt && !s_got_ip) {
+        ESP_LOGW(TAG, "Fast connect failed (reason %d), falling back to scan and DHCP", event->reason);
+        fast_connect_invalidate();
+    }
+#endif
+    // The application schedules the next attempt itself, see example_set_manual_reconnect()
+    if (s_manual_reconnect) {
+        return;
+    }
+    ESP_ERROR_CHECK(example_reconnect());
 }
 
 #ifdef CONFIG_EXAMPLE_CONNECT_IPV6
@@ -73,6 +252,18 @@ static void on_got_ip(void *arg, esp_event_base_t event_base,
 {
     ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
     memcpy(&s_ip_addr, &event->ip_info.ip, sizeof(s_ip_addr));
+#ifdef CONFIG_EXAMPLE_WIFI_FAST_RECONNECT
+    s_got_ip = true;
+    if (s_lease_reused) {
+        // Connected on the cached address: renew the lease in the background,
+        // the cache is stored again when the DHCP server acknowledges it
+        s_lease_reused = false;
+        ESP_LOGI(TAG, "Connected with cached lease " IPSTR ", renewing", IP2STR(&event->ip_info.ip));
+        tcpip_adapter_dhcpc_start(TCPIP_ADAPTER_IF_STA);
+    } else {
+        fast_connect_save(&event->ip_info);
+    }
+#endif
     xEventGroupSetBits(s_connect_event_group, GOT_IPV4_BIT);
 }
 
@@ -106,15 +297,22 @@ static void start(void)
     ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_GOT_IP6, &on_got_ipv6, NULL));
 #endif    
 
+    // The AP and lease are cached separately, keep the driver's own copy out of flash
     ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
-    wifi_config_t wifi_config = { 0 };
+    memset(&s_wifi_config, 0, sizeof(s_wifi_config));
 
-    strncpy((char *)&wifi_config.sta.ssid, s_connection_name, 32);
-    strncpy((char *)&wifi_config.sta.password, s_connection_passwd, 32);
+    // An SSID or password that fills the whole field is stored without a terminator
+    memcpy(s_wifi_config.sta.ssid, s_connection_name, strnlen(s_connection_name, sizeof(s_wifi_config.sta.ssid)));
+    memcpy(s_wifi_config.sta.password, s_connection_passwd, strnlen(s_connection_passwd, sizeof(s_wifi_config.sta.password)));
 
-    ESP_LOGI(TAG, "Connecting to %s...", wifi_config.sta.ssid);
+    ESP_LOGI(TAG, "Connecting to %s...", s_wifi_config.sta.ssid);
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config));
+#ifdef CONFIG_EXAMPLE_WIFI_FAST_RECONNECT
+    fast_connect_load();
+    fast_connect_prepare();
+#else
+    ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &s_wifi_config));
+#endif
     ESP_ERROR_CHECK(esp_wifi_start());
     ESP_ERROR_CHECK(esp_wifi_connect());
 }
@@ -167,10 +365,25 @@ esp_err_t example_disconnect(void)
     return ESP_OK;
 }
 
+void example_set_manual_reconnect(bool manual)
+{
+    s_manual_reconnect = manual;
+}
+
+esp_err_t example_reconnect(void)
+{
+#ifdef CONFIG_EXAMPLE_WIFI_FAST_RECONNECT
+    fast_connect_prepare();
+#endif
+    return esp_wifi_connect();
+}
+
 esp_err_t example_set_connection_info(const char *ssid, const char *passwd)
 {
-    strncpy(s_connection_name, ssid, sizeof(s_connection_name));
-    strncpy(s_connection_passwd, passwd, sizeof(s_connection_passwd));
+    strncpy(s_connection_name, ssid, sizeof(s_connection_name) - 1);
+    s_connection_name[sizeof(s_connection_name) - 1] = '\0';
+    strncpy(s_connection_passwd, passwd, sizeof(s_connection_passwd) - 1);
+    s_connection_passwd[sizeof(s_connection_passwd) - 1] = '\0';
 
     return ESP_OK;
 }
@@ -13,6 +13,7 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
 #include "esp_err.h"
 #include "tcpip_adapter.h"
 
@@ -40,6 +41,23 @@ esp_err_t example_connect(void);
  */
 esp_err_t example_disconnect(void);
 
+/**
+ * @brief Let the application decide when to retry a lost Wi-Fi connection
+ *
+ * By default every disconnect is followed by an immediate reconnect. When
+ * manual reconnect is enabled the disconnect handler only updates its own
+ * state, and the application calls example_reconnect() for the next attempt,
+ * e.g. after a backoff delay. Call before example_connect().
+ */
+void example_set_manual_reconnect(bool manual);
+
+/**
+ * @brief Start a new connection attempt to the configured AP
+ *
+ * @return result of esp_wifi_connect()
+ */
+esp_err_t example_reconnect(void);
+
 /**
  * @brief Configure stdin and stdout to use blocking I/O
  *
@@ -1,3 +1,97 @@
-esp_err_t sht3x_mode_init(void);
-uint8_t sht3x_get_humiture_periodic(float *Tem_val,float *Hum_val);
-uint8_t SHT3x_ReadSerialNumber(uint32_t* serialNumber);
+#ifndef __SHT3X_H__
+#define __SHT3X_H__
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <esp_err.h>
+#include <driver/i2c.h>
+
+/* 传感器实例句柄，每个器件地址对应一个 */
+typedef struct sht3x_dev_t *sht3x_handle_t;
+
+/* 传感器实例配置，同一I2C端口上的传感器必须使用相同的引脚 */
+typedef struct {
+	i2c_port_t port;    /* I2C端口 */
+	int sda_pin;        /* SDA引脚 */
+	int scl_pin;        /* SCL引脚 */
+	uint8_t addr;       /* 7位器件地址，ADDR引脚接低为0x44，接高为0x45 */
+} sht3x_config_t;
+
+/* 周期测量模式：每秒测量次数 */
+typedef enum {
+	SHT3X_MPS_0_5 = 0,
+	SHT3X_MPS_1,
+	SHT3X_MPS_2,
+	SHT3X_MPS_4,
+	SHT3X_MPS_10,
+} sht3x_mps_t;
+
+/* 测量重复性 */
+typedef enum {
+	SHT3X_REPEATABILITY_HIGH = 0,
+	SHT3X_REPEATABILITY_MEDIUM,
+	SHT3X_REPEATABILITY_LOW,
+} sht3x_repeatability_t;
+
+/* 后台采集得到的一条原始采样 */
+typedef struct {
+	uint16_t raw_temperature;   /* 温度原始值 */
+	uint16_t raw_humidity;      /* 湿度原始值 */
+	uint32_t tick;              /* 采集时的系统tick */
+	uint32_t seq;               /* 采样序号，从0开始递增 */
+} sht3x_sample_t;
+
+/* 统计窗口内一个量的统计结果，单位与测量值相同(0.01°C或0.01%) */
+typedef struct {
+	int16_t min;
+	int16_t max;
+	int16_t mean;
+	uint16_t stddev;    /* 样本标准差 */
+} sht3x_moments_t;
+
+/* 一个统计窗口内周期采集结果的统计量 */
+typedef struct {
+	uint32_t count;                 /* 窗口内的采样数，为0时其余字段无意义 */
+	sht3x_moments_t temperature;
+	sht3x_moments_t humidity;
+} sht3x_window_t;
+
+/* I2C事务耗时直方图分桶上界(us)，最后一个桶收集所有更大的值 */
+#define SHT3X_I2C_TIME_BUCKETS_US {250, 500, 1000, 2000, 5000, 10000, 50000, UINT32_MAX}
+#define SHT3X_I2C_TIME_BUCKET_NUM 8
+
+/* 驱动运行统计，均为开机后的累计值 */
+typedef struct {
+	uint32_t i2c_transactions;                          /* I2C事务数 */
+	uint32_t i2c_errors;                                /* 失败的I2C事务数，包括周期模式下数据未就绪的NACK */
+	uint32_t crc_errors;                                /* 周期采集的CRC校验失败次数 */
+	uint32_t i2c_time_max_us;                           /* 单次I2C事务的最大耗时 */
+	uint32_t i2c_time_hist[SHT3X_I2C_TIME_BUCKET_NUM];  /* I2C事务耗时直方图 */
+	uint32_t bus_clears;                                /* 在SCL上手动发出时钟释放SDA的次数 */
+	uint32_t reinits;                                   /* 重新安装I2C驱动并复位传感器的次数 */
+	uint32_t recoveries;                                /* 周期采集连续失败后经恢复重新读到数据的次数 */
+} sht3x_stats_t;
+
+/* 以0.01为单位的整数打印格式，例如 ESP_LOGI(TAG, SHT3X_CENTI_FMT, SHT3X_CENTI_ARGS(v)) */
+#define SHT3X_CENTI_FMT "%s%d.%02d"
+#define SHT3X_CENTI_ARGS(v) ((v) < 0 ? "-" : ""), (int)((v) < 0 ? -(v) : (v)) / 100, (int)((v) < 0 ? -(v) : (v)) % 100
+
+esp_err_t sht3x_init(const sht3x_config_t *config, sht3x_handle_t *handle);
+uint8_t sht3x_get_humiture_periodic(sht3x_handle_t dev, int16_t *Tem_val, uint16_t *Hum_val, uint16_t *count);
+bool sht3x_is_ready(sht3x_handle_t dev);
+esp_err_t SHT3x_ReadSerialNumber(sht3x_handle_t dev, uint32_t* serialNumber);
+
+esp_err_t sht3x_periodic_start(const sht3x_handle_t *handles, size_t count, sht3x_mps_t mps, sht3x_repeatability_t repeatability);
+esp_err_t sht3x_periodic_add(sht3x_handle_t dev);
+esp_err_t sht3x_periodic_stop(void);
+esp_err_t sht3x_get_latest(sht3x_handle_t dev, sht3x_sample_t *sample);
+size_t sht3x_get_recent(sht3x_handle_t dev, sht3x_sample_t *samples, size_t count);
+void sht3x_take_window(sht3x_handle_t dev, sht3x_window_t *out);
+void sht3x_get_stats(sht3x_stats_t *out);
+esp_err_t sht3x_recover(i2c_port_t port);
+bool sht3x_is_failed(sht3x_handle_t dev);
+
+uint8_t sht3x_crc8(const uint8_t *word);
+int16_t sht3x_raw_to_centi_celsius(uint16_t raw);
+uint16_t sht3x_raw_to_centi_percent(uint16_t raw);
+#endif
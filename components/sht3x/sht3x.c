@@ -1,8 +1,14 @@
 #include <string.h>
 #include <sys/param.h>
 #include <driver/i2c.h>
+#include <driver/gpio.h>
+#include <rom/ets_sys.h>
+#include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <esp_log.h>
+#include <esp_timer.h>
+
+#include "sht3x.h"
 
 #define WRITE_BIT 0x00                      /*!< I2C master write */
 #define READ_BIT 0x01                       /*!< I2C master read  */
@@ -12,11 +18,7 @@
 #define ACK_VAL 0x0                         /*!< I2C ack value  */
 #define NACK_VAL 0x1                        /*!< I2C nack value */
 
-#define IIC_CTRL_NUM I2C_NUM_0              /*!< I2C port number */
-#define SDA_PIN_NUM CONFIG_SHT3X_I2C_SDA_PIN_NUM                      /*!< gpio number for I2C data  */
-#define SCL_PIN_NUM CONFIG_SHT3X_I2C_SCL_PIN_NUM                      /*!< gpio number for I2C clock */
-
-#define SHT3X_DeviceAddr (CONFIG_SHT3X_DEVICE_ADDR<<1)          /* SHT3X的器件地址 */
+#define SHT3X_MAX_SENSORS CONFIG_SHT3X_MAX_SENSORS            /* 最多支持的传感器数量 */
 
 //日志标签
 static const char *TAG="MAIN";
@@ -56,24 +58,109 @@ typedef enum
     LOW_10_CMD     = 0x272A,
 	/* 周期测量模式读取数据命令 */
 	READOUT_FOR_PERIODIC_MODE = 0xE000,
+	/* 退出周期测量模式命令 */
+	BREAK_CMD = 0x3093,
 	/* 读取传感器编号命令 */
 	READ_SERIAL_NUMBER = 0x3780,
 } sht3x_cmd_t;
 
+/* 软件复位后到可以接收命令的时间，手册最大值1.5ms */
+#define SOFT_RESET_TIME_MS 2
+/* 读取序列号命令到数据就绪的时间 */
+#define SERIAL_NUMBER_TIME_MS 1
+/* 读取序列号的尝试次数，CRC错误或无应答时重试 */
+#define SERIAL_NUMBER_ATTEMPTS 3
+
+/* 总线恢复参数
+ * 周期模式下连续RECOVERY_FAILURES次读取失败即执行下一级恢复：
+ * 第一级在SCL上发出9个时钟释放被拉低的SDA并重新发送周期测量命令，
+ * 之后每级都重新安装I2C驱动、软件复位总线上的所有传感器并恢复周期测量，
+ * 重新安装RECOVERY_REINITS次仍未恢复即视为失效，由调用者决定是否重启 */
+#define RECOVERY_FAILURES 3
+#define RECOVERY_REINITS 3
+#define RECOVERY_STEPS (1 + RECOVERY_REINITS)
+/* 手动产生时钟时的半周期(us)，约100kHz */
+#define BUS_CLEAR_HALF_PERIOD_US 5
+
+/* 采样环形缓冲区长度 */
+#define SAMPLE_RING_SIZE CONFIG_SHT3X_SAMPLE_RING_SIZE
+#define SAMPLE_RING_MASK (SAMPLE_RING_SIZE - 1)
+_Static_assert((SAMPLE_RING_SIZE & SAMPLE_RING_MASK) == 0, "SHT3X_SAMPLE_RING_SIZE must be a power of 2");
+
+/* 滤波参数 */
+#define FILTER_MEDIAN_WINDOW CONFIG_SHT3X_FILTER_MEDIAN_WINDOW
+#define FILTER_EMA_SHIFT CONFIG_SHT3X_FILTER_EMA_SHIFT
+#define FILTER_FRAC_BITS 8                  /* EMA状态的小数位数 */
+
+/* 周期模式的滤波状态：每条原始采样先经过滑动窗口中值滤波剔除尖峰，再做定点EMA平滑
+ * 只有采集任务写入，读取方在临界区内拷贝 */
+typedef struct {
+	uint16_t window_t[FILTER_MEDIAN_WINDOW];  /* 最近的温度原始值 */
+	uint16_t window_h[FILTER_MEDIAN_WINDOW];  /* 最近的湿度原始值 */
+	uint8_t window_len;
+	uint8_t window_pos;
+	int32_t ema_t;                          /* 温度原始值，左移FILTER_FRAC_BITS位 */
+	int32_t ema_h;                          /* 湿度原始值，左移FILTER_FRAC_BITS位 */
+	uint16_t count;                         /* 上次读取之后滤入的原始采样数 */
+	uint32_t tick;                          /* 最近一次滤入时的系统tick */
+} sht3x_filter_t;
+
+/* 统计窗口的定点小数位数，均值精度为1/256个0.01单位 */
+#define WINDOW_FRAC_BITS 8
+
+/* 统计窗口内一个量的累加状态，Welford增量算法：每条采样只更新均值和与均值之差的平方和，
+ * 不保存采样本身，也不会像直接累加平方和那样在大数相减时损失精度 */
+typedef struct {
+	int32_t min;
+	int32_t max;
+	int32_t mean;                           /* 均值，左移WINDOW_FRAC_BITS位 */
+	int64_t m2;                             /* 与均值之差的平方和，左移2*WINDOW_FRAC_BITS位 */
+} window_moments_t;
+
+/* 周期模式的统计窗口，只有采集任务写入，读取方在临界区内拷贝并清零 */
+typedef struct {
+	uint32_t count;
+	window_moments_t t;
+	window_moments_t h;
+} sht3x_window_acc_t;
+
+/* 传感器实例，从静态数组中分配，驱动不申请堆内存 */
+struct sht3x_dev_t {
+	i2c_port_t port;
+	uint8_t addr;                           /* 8位写地址，即7位地址左移一位 */
+	sht3x_sample_t ring[SAMPLE_RING_SIZE];  /* 周期模式采样环形缓冲区 */
+	volatile uint32_t seq;                  /* 已写入的采样条数 */
+	sht3x_filter_t filter;
+	sht3x_window_acc_t window;
+	uint8_t failures;                       /* 周期模式下连续失败的读取次数 */
+	uint8_t recovery;                       /* 本次故障中已执行的恢复级数，恢复正常后清零 */
+};
+
+static struct sht3x_dev_t devices[SHT3X_MAX_SENSORS];
+static size_t device_count;
+static bool bus_installed[I2C_NUM_MAX];
+static sht3x_config_t bus_configs[I2C_NUM_MAX];    /* 安装驱动时的引脚，恢复总线时使用 */
+
+/* 描述：生成I2C主机配置 */
+static void i2c_master_config(const sht3x_config_t *config, i2c_config_t *conf)
+{
+    conf->mode = I2C_MODE_MASTER;
+    conf->sda_io_num = config->sda_pin;
+    conf->sda_pullup_en = GPIO_PULLUP_ENABLE;
+    conf->scl_io_num = config->scl_pin;
+    conf->scl_pullup_en = GPIO_PULLUP_ENABLE;
+    conf->clk_stretch_tick = 300;     /* 标准模式(100 kbit/s) */
+}
+
 /**
  * @brief i2c master initialization
  */
-static esp_err_t i2c_master_init(void)
+static esp_err_t i2c_master_init(const sht3x_config_t *config)
 {
-    int i2c_master_port = IIC_CTRL_NUM;
+    int i2c_master_port = config->port;
 
     i2c_config_t conf;
-    conf.mode = I2C_MODE_MASTER;
-    conf.sda_io_num = SDA_PIN_NUM;
-    conf.sda_pullup_en = GPIO_PULLUP_ENABLE;
-    conf.scl_io_num = SCL_PIN_NUM;
-    conf.scl_pullup_en = GPIO_PULLUP_ENABLE;
-    conf.clk_stretch_tick = 300;     /* 标准模式(100 kbit/s) */
+    i2c_master_config(config, &conf);
 
 	esp_err_t ret;
 	ret = i2c_driver_install(i2c_master_port, conf.mode);
@@ -89,95 +176,79 @@ static esp_err_t i2c_master_init(void)
     return ESP_OK;
 }
 
+/* 驱动运行统计
+ * 只在I2C事务和采集任务中递增，读取方直接拷贝，个别计数短暂不一致不影响统计用途，因此不加锁 */
+static const uint32_t i2c_time_buckets_us[SHT3X_I2C_TIME_BUCKET_NUM] = SHT3X_I2C_TIME_BUCKETS_US;
+static sht3x_stats_t stats;
+
+/* 描述：记录一次I2C事务的耗时和结果
+ * 参数start_us：事务开始时间
+ * 参数ret：事务结果 */
+static void sht3x_i2c_record(int64_t start_us, esp_err_t ret)
+{
+	uint32_t elapsed_us = esp_timer_get_time() - start_us;
+	int i = 0;
+	while (elapsed_us > i2c_time_buckets_us[i]) {
+		i++;
+	}
+	stats.i2c_time_hist[i]++;
+
+	stats.i2c_transactions++;
+	if (ret != ESP_OK) {
+		stats.i2c_errors++;
+	}
+	if (elapsed_us > stats.i2c_time_max_us) {
+		stats.i2c_time_max_us = elapsed_us;
+	}
+}
+
 /* 描述：向SHT30发送一条16bit指令
+ * 参数dev：传感器实例
  * 参数cmd：SHT30指令（在SHT30_MODE中枚举定义）
  * 返回值：成功返回ESP_OK                     */
-static esp_err_t SHT3x_Send_Cmd(sht3x_cmd_t sht3x_cmd)
+static esp_err_t SHT3x_Send_Cmd(sht3x_handle_t dev, sht3x_cmd_t sht3x_cmd)
 {
     uint8_t cmd_buffer[2];
     cmd_buffer[0] = sht3x_cmd >> 8;
     cmd_buffer[1] = sht3x_cmd;
+    int64_t start_us = esp_timer_get_time();
     i2c_cmd_handle_t cmd = i2c_cmd_link_create();
     i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, SHT3X_DeviceAddr | WRITE_BIT, ACK_CHECK_EN);
+    i2c_master_write_byte(cmd, dev->addr | WRITE_BIT, ACK_CHECK_EN);
     i2c_master_write_byte(cmd, cmd_buffer[0], ACK_CHECK_EN);
     i2c_master_write_byte(cmd, cmd_buffer[1], ACK_CHECK_EN);
     i2c_master_stop(cmd);
-    esp_err_t ret = i2c_master_cmd_begin(IIC_CTRL_NUM, cmd, 1000 / portTICK_RATE_MS);
+    esp_err_t ret = i2c_master_cmd_begin(dev->port, cmd, 1000 / portTICK_RATE_MS);
     i2c_cmd_link_delete(cmd);
+	sht3x_i2c_record(start_us, ret);
 
 	return ret;
 }
 
 /* 描述：从SHT3x读取数据
+ * 参数dev：传感器实例
  * 参数data_len：读取多少个字节数据
  * 参数data_arr：读取的数据存放在一个数组里
  * 返回值：读取成功返回ESP_OK
 */
-static esp_err_t SHT3x_Recv_Data(size_t data_len, uint8_t* data_arr)
+static esp_err_t SHT3x_Recv_Data(sht3x_handle_t dev, size_t data_len, uint8_t* data_arr)
 {
+	int64_t start_us = esp_timer_get_time();
 	i2c_cmd_handle_t cmd = i2c_cmd_link_create();
     i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, SHT3X_DeviceAddr | READ_BIT, ACK_CHECK_EN);
+    i2c_master_write_byte(cmd, dev->addr | READ_BIT, ACK_CHECK_EN);
     if (data_len > 1) {
         i2c_master_read(cmd, data_arr, data_len - 1, ACK_VAL);
     }
     i2c_master_read_byte(cmd, data_arr + data_len - 1, NACK_VAL);
     i2c_master_stop(cmd);
-    esp_err_t ret = i2c_master_cmd_begin(IIC_CTRL_NUM, cmd, 1000 / portTICK_RATE_MS);
+    esp_err_t ret = i2c_master_cmd_begin(dev->port, cmd, 1000 / portTICK_RATE_MS);
     i2c_cmd_link_delete(cmd);
+	sht3x_i2c_record(start_us, ret);
 
 	return ret;
 }
 
-/* 描述：读取传感器编号
- * 参数：存储编号数据的指针
- * 返回值：0-读取成功，1-读取失败 */
-esp_err_t SHT3x_ReadSerialNumber(uint32_t* serialNumber)
-{
-	uint8_t Num_buf[4] = {0xFF,0xFF,0xFF,0xFF};
-
-	SHT3x_Send_Cmd(READ_SERIAL_NUMBER);
-	vTaskDelay(500 / portTICK_PERIOD_MS);   /* 延时50ms，有问题时需要适当延长！！！！！！*/
-
-	esp_err_t ret = SHT3x_Recv_Data(4,Num_buf);
-
-	*serialNumber = ((Num_buf[0] << 24) | (Num_buf[1] << 16) |(Num_buf[2] << 8) |(Num_buf[3]));
-	if(0xFFFFFFFF == *serialNumber) {
-		return ESP_ERR_INVALID_RESPONSE;
-	}
-
-	//设备编码已经通过入参返回，这里只需要返回成功即可
-	if(ret == ESP_OK) {
-		return ESP_OK;
-	}
-
-    ESP_LOGE(TAG, "SHT3x_ReadSerialNumber ERR :%s",esp_err_to_name(ret));
-    return ret;
-}
-
-/* 描述：SHT3x初始化函数，并将其设置为周期测量模式
- * 参数：无
- * 返回值：初始化成功返回ESP_OK */
-esp_err_t sht3x_mode_init(void)
-{
-	esp_err_t ret;
-
-    /* 初始化IIC控制器 */
-	ESP_LOGI(TAG, "Init I2C in master mode");
-    ret = i2c_master_init();
-	if (ret!=ESP_OK) {
-		return ret;
-	}
-
-	ESP_LOGI(TAG, "Reset SHT3X");
-	ret = SHT3x_Send_Cmd(SOFT_RESET_CMD);
-	if (ret!=ESP_OK) {
-		return ret;
-	}
-	return ESP_OK;
-}
-
 /* 描述：数据CRC校验
  * 参数message：需要校验的数据
  * 参数initial_value：crc初始值
@@ -206,44 +277,719 @@ static uint8_t CheckCrc8(uint8_t* const message, uint8_t initial_value)
     return remainder;
 }
 
-/* 描述：温湿度数据获取函数,周期读取，注意，需要提前设置周期模式 
- * 参数Tem_val：存储温度数据的指针, 温度单位为0.01°C
- * 参数Hum_val：存储湿度数据的指针, 温度单位为0.01%
- * 返回值：0-读取成功，1-读取失败 **********************************/
-uint8_t sht3x_get_humiture_periodic(float *Tem_val,float *Hum_val)
+/* 描述：计算一个16位数据字的CRC，与传感器回复中该字之后的校验字节比较
+ * 参数word：2字节数据
+ * 返回值：计算得到的CRC码 */
+uint8_t sht3x_crc8(const uint8_t *word)
+{
+	return CheckCrc8((uint8_t *)word, 0xFF);
+}
+
+/* 描述：读取传感器编号
+ * 传感器返回两个16位字，各自带一个CRC字节，共6个字节
+ * 参数dev：传感器实例
+ * 参数serialNumber：存储编号数据的指针
+ * 返回值：成功返回ESP_OK，CRC错误返回ESP_ERR_INVALID_CRC */
+esp_err_t SHT3x_ReadSerialNumber(sht3x_handle_t dev, uint32_t* serialNumber)
+{
+	uint8_t Num_buf[6];
+	esp_err_t ret;
+
+	//序列号只在启动时读取一次，干扰造成的单次失败直接重试
+	for (int attempt = 0; attempt < SERIAL_NUMBER_ATTEMPTS; attempt++) {
+		ret = SHT3x_Send_Cmd(dev, READ_SERIAL_NUMBER);
+		if (ret == ESP_OK) {
+			//vTaskDelay的第一个tick可能不完整，多等一个tick
+			vTaskDelay((SERIAL_NUMBER_TIME_MS + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS + 1);
+			ret = SHT3x_Recv_Data(dev, 6, Num_buf);
+		}
+
+		if (ret != ESP_OK) {
+			ESP_LOGE(TAG, "SHT3x_ReadSerialNumber ERR :%s",esp_err_to_name(ret));
+			continue;
+		}
+
+		if (CheckCrc8(Num_buf, 0xFF) != Num_buf[2] || CheckCrc8(&Num_buf[3], 0xFF) != Num_buf[5]) {
+			ESP_LOGE(TAG, "SHT3x_ReadSerialNumber CRC_ERROR");
+			stats.crc_errors++;
+			ret = ESP_ERR_INVALID_CRC;
+			continue;
+		}
+		break;
+	}
+
+	if (ret != ESP_OK) {
+		return ret;
+	}
+
+	*serialNumber = ((uint32_t)Num_buf[0] << 24) | ((uint32_t)Num_buf[1] << 16) | ((uint32_t)Num_buf[3] << 8) | Num_buf[4];
+	return ESP_OK;
+}
+
+/* 描述：初始化一个SHT3x传感器实例并软件复位，同一I2C端口上的多个传感器共用总线驱动
+ * 参数config：总线和器件地址配置
+ * 参数handle：返回的传感器实例
+ * 返回值：初始化成功返回ESP_OK */
+esp_err_t sht3x_init(const sht3x_config_t *config, sht3x_handle_t *handle)
+{
+	esp_err_t ret;
+
+	if (config->port >= I2C_NUM_MAX) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	for (size_t i = 0; i < device_count; i++) {
+		if (devices[i].port == config->port && devices[i].addr == config->addr << 1) {
+			return ESP_ERR_INVALID_STATE;
+		}
+	}
+
+	if (device_count == SHT3X_MAX_SENSORS) {
+		return ESP_ERR_NO_MEM;
+	}
+
+    /* 初始化IIC控制器 */
+	if (!bus_installed[config->port]) {
+		ESP_LOGI(TAG, "Init I2C %d in master mode", config->port);
+		ret = i2c_master_init(config);
+		if (ret!=ESP_OK) {
+			return ret;
+		}
+		bus_installed[config->port] = true;
+		bus_configs[config->port] = *config;
+	}
+
+	struct sht3x_dev_t *dev = &devices[device_count];
+	dev->port = config->port;
+	dev->addr = config->addr << 1;
+	dev->seq = 0;
+	dev->failures = 0;
+	dev->recovery = 0;
+	memset(&dev->filter, 0, sizeof(dev->filter));
+	memset(&dev->window, 0, sizeof(dev->window));
+
+	ESP_LOGI(TAG, "Reset SHT3X at 0x%02x", config->addr);
+	ret = SHT3x_Send_Cmd(dev, SOFT_RESET_CMD);
+	if (ret!=ESP_OK) {
+		return ret;
+	}
+	vTaskDelay((SOFT_RESET_TIME_MS + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS + 1);
+
+	device_count++;
+	*handle = dev;
+	return ESP_OK;
+}
+
+/* 周期测量模式命令表，按[每秒测量次数][重复性]索引 */
+static const sht3x_cmd_t periodic_cmds[][3] = {
+	[SHT3X_MPS_0_5] = {HIGH_0_5_CMD, MEDIUM_0_5_CMD, LOW_0_5_CMD},
+	[SHT3X_MPS_1]   = {HIGH_1_CMD,   MEDIUM_1_CMD,   LOW_1_CMD},
+	[SHT3X_MPS_2]   = {HIGH_2_CMD,   MEDIUM_2_CMD,   LOW_2_CMD},
+	[SHT3X_MPS_4]   = {HIGH_4_CMD,   MEDIUM_4_CMD,   LOW_4_CMD},
+	[SHT3X_MPS_10]  = {HIGH_10_CMD,  MEDIUM_10_CMD,  LOW_10_CMD},
+};
+
+/* 各周期模式下两次测量之间的间隔(ms) */
+static const uint32_t periodic_interval_ms[] = {
+	[SHT3X_MPS_0_5] = 2000,
+	[SHT3X_MPS_1]   = 1000,
+	[SHT3X_MPS_2]   = 500,
+	[SHT3X_MPS_4]   = 250,
+	[SHT3X_MPS_10]  = 100,
+};
+
+/* 周期模式下由同一个采集任务轮流读取的传感器 */
+static sht3x_handle_t periodic_devices[SHT3X_MAX_SENSORS];
+static size_t periodic_count;
+static TaskHandle_t fetch_task_handle;
+static uint32_t fetch_interval_ms;
+static sht3x_cmd_t periodic_cmd;        /* 进入周期模式时使用的命令，恢复时重新发送 */
+
+/* 采样环形缓冲区
+ * 每个传感器一个，只有采集任务写入，写入顺序为：先写槽位，再递增seq。
+ * 读取方拷贝槽位后再次检查seq，若期间该槽位已被覆盖则重读，因此读写双方都无需加锁。 */
+
+/* 描述：把一条新采样写入环形缓冲区，仅由采集任务调用 */
+static void sample_ring_push(sht3x_handle_t dev, uint16_t raw_temperature, uint16_t raw_humidity)
+{
+	uint32_t seq = dev->seq;
+	sht3x_sample_t *slot = &dev->ring[seq & SAMPLE_RING_MASK];
+
+	slot->raw_temperature = raw_temperature;
+	slot->raw_humidity = raw_humidity;
+	slot->tick = xTaskGetTickCount();
+	slot->seq = seq;
+
+	__sync_synchronize();
+	dev->seq = seq + 1;
+}
+
+/* 描述：判断序号为seq的槽位在读取后是否仍然有效（未被采集任务覆盖） */
+static bool sample_ring_still_valid(sht3x_handle_t dev, uint32_t seq)
+{
+	__sync_synchronize();
+	return (dev->seq - seq) < SAMPLE_RING_SIZE;
+}
+
+/* 描述：求窗口中的中值，窗口长度不超过FILTER_MEDIAN_WINDOW，偶数长度时取较小的一个 */
+static uint16_t filter_median(const uint16_t *window, int len)
+{
+	uint16_t sorted[FILTER_MEDIAN_WINDOW];
+
+	//窗口很小，插入排序即可
+	for (int i = 0; i < len; i++) {
+		int j = i;
+		while (j > 0 && sorted[j - 1] > window[i]) {
+			sorted[j] = sorted[j - 1];
+			j--;
+		}
+		sorted[j] = window[i];
+	}
+	return sorted[(len - 1) / 2];
+}
+
+/* 描述：把一个值计入统计窗口
+ * 参数m：累加状态
+ * 参数n：计入本值之后的采样数
+ * 参数x：0.01单位的测量值 */
+static void window_moments_push(window_moments_t *m, uint32_t n, int32_t x)
+{
+	int32_t v = x * (1 << WINDOW_FRAC_BITS);
+
+	if (n == 1) {
+		m->min = x;
+		m->max = x;
+		m->mean = v;
+		m->m2 = 0;
+		return;
+	}
+
+	m->min = MIN(m->min, x);
+	m->max = MAX(m->max, x);
+
+	//均值的增量四舍五入，直接截断会让误差朝同一方向累积
+	int32_t delta = v - m->mean;
+	int32_t half = (delta < 0 ? -(int32_t)n : (int32_t)n) / 2;
+	m->mean += (delta + half) / (int32_t)n;
+	m->m2 += (int64_t)delta * (v - m->mean);
+}
+
+/* 描述：64位整数平方根，向下取整 */
+static uint32_t isqrt64(uint64_t v)
+{
+	uint64_t root = 0;
+	uint64_t bit = 1ULL << 62;
+
+	while (bit > v) {
+		bit >>= 2;
+	}
+	while (bit) {
+		if (v >= root + bit) {
+			v -= root + bit;
+			root = (root >> 1) + bit;
+		} else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return root;
+}
+
+/* 描述：由累加状态求出统计结果，四舍五入到0.01单位
+ * 参数m：累加状态
+ * 参数n：采样数，不为0
+ * 参数out：统计结果 */
+static void window_moments_finish(const window_moments_t *m, uint32_t n, sht3x_moments_t *out)
+{
+	//舍入误差可能使平方和略小于0
+	uint64_t variance = n > 1 && m->m2 > 0 ? (uint64_t)m->m2 / (n - 1) : 0;
+
+	out->min = m->min;
+	out->max = m->max;
+	out->mean = (m->mean + (1 << (WINDOW_FRAC_BITS - 1))) >> WINDOW_FRAC_BITS;
+	out->stddev = (isqrt64(variance) + (1 << (WINDOW_FRAC_BITS - 1))) >> WINDOW_FRAC_BITS;
+}
+
+/* 描述：把一条原始采样滤入滤波状态，仅由采集任务调用 */
+static void filter_push(sht3x_handle_t dev, uint16_t raw_temperature, uint16_t raw_humidity)
+{
+	sht3x_filter_t *f = &dev->filter;
+
+	f->window_t[f->window_pos] = raw_temperature;
+	f->window_h[f->window_pos] = raw_humidity;
+	f->window_pos = (f->window_pos + 1) % FILTER_MEDIAN_WINDOW;
+	if (f->window_len < FILTER_MEDIAN_WINDOW) {
+		f->window_len++;
+	}
+
+	uint16_t raw_median_t = filter_median(f->window_t, f->window_len);
+	uint16_t raw_median_h = filter_median(f->window_h, f->window_len);
+	int32_t median_t = (int32_t)raw_median_t << FILTER_FRAC_BITS;
+	int32_t median_h = (int32_t)raw_median_h << FILTER_FRAC_BITS;
+	//统计窗口使用中值滤波之后、EMA平滑之前的值，剔除单次尖峰但保留真实的极值
+	int16_t centi_t = sht3x_raw_to_centi_celsius(raw_median_t);
+	uint16_t centi_h = sht3x_raw_to_centi_percent(raw_median_h);
+
+	//窗口填满之前中值本身还不稳定，直接作为EMA的初值
+	taskENTER_CRITICAL();
+	if (f->window_len < FILTER_MEDIAN_WINDOW) {
+		f->ema_t = median_t;
+		f->ema_h = median_h;
+	} else {
+		//ema += (x - ema) / 2^shift，算术右移对负数向下取整，误差小于一个小数位
+		f->ema_t += (median_t - f->ema_t) >> FILTER_EMA_SHIFT;
+		f->ema_h += (median_h - f->ema_h) >> FILTER_EMA_SHIFT;
+	}
+	if (f->count < UINT16_MAX) {
+		f->count++;
+	}
+	f->tick = xTaskGetTickCount();
+
+	sht3x_window_acc_t *w = &dev->window;
+	if (w->count < UINT32_MAX) {
+		w->count++;
+		window_moments_push(&w->t, w->count, centi_t);
+		window_moments_push(&w->h, w->count, centi_h);
+	}
+	taskEXIT_CRITICAL();
+}
+
+/* 描述：读取一次测量结果并校验CRC
+ * 参数dev：传感器实例
+ * 参数raw_temperature：温度原始值
+ * 参数raw_humidity：湿度原始值
+ * 返回值：成功返回ESP_OK，数据未就绪时传感器NACK，返回I2C错误 */
+static esp_err_t sht3x_read_measurement(sht3x_handle_t dev, uint16_t *raw_temperature, uint16_t *raw_humidity)
 {
-	uint8_t ret=0;
 	uint8_t buff[6];
-	uint16_t tem,hum;
-	float Temperature=0;
-	float Humidity=0;
 
-	ret = SHT3x_Send_Cmd(MEDIUM_ENABLED_CMD);
-	vTaskDelay(50 / portTICK_PERIOD_MS);   /* 延时50ms，有问题时需要适当延长！！！！！！*/
-	ret = SHT3x_Recv_Data(6,buff);
+	esp_err_t ret = SHT3x_Recv_Data(dev, 6, buff);
+	if (ret != ESP_OK) {
+		return ret;
+	}
 
-	/* 校验温度数据和湿度数据是否接收正确 */
-	if(CheckCrc8(buff, 0xFF) != buff[2] || CheckCrc8(&buff[3], 0xFF) != buff[5])
-	{
-		ESP_LOGE(TAG, "CRC_ERROR,ret = 0x%x",ret);
+	if (CheckCrc8(buff, 0xFF) != buff[2] || CheckCrc8(&buff[3], 0xFF) != buff[5]) {
+		ESP_LOGE(TAG, "Readout CRC_ERROR from 0x%02x", dev->addr >> 1);
+		stats.crc_errors++;
+		return ESP_ERR_INVALID_CRC;
+	}
+
+	*raw_temperature = ((uint16_t)buff[0] << 8) | buff[1];
+	*raw_humidity = ((uint16_t)buff[3] << 8) | buff[4];
+	return ESP_OK;
+}
+
+/* 描述：在SCL上手动发出最多9个时钟，让停在读取中途、拉低SDA的从机移出剩余的位并释放总线，最后产生STOP
+ * 引脚被切换为开漏GPIO，调用后需要重新配置I2C驱动
+ * 参数port：I2C端口
+ * 返回值：SDA已释放返回ESP_OK，否则返回ESP_FAIL */
+static esp_err_t i2c_bus_clear(i2c_port_t port)
+{
+	const sht3x_config_t *config = &bus_configs[port];
+	gpio_config_t conf = {
+		.pin_bit_mask = (1UL << config->sda_pin) | (1UL << config->scl_pin),
+		.mode = GPIO_MODE_OUTPUT_OD,
+		.pull_up_en = GPIO_PULLUP_ENABLE,
+		.pull_down_en = GPIO_PULLDOWN_DISABLE,
+		.intr_type = GPIO_INTR_DISABLE,
+	};
+
+	stats.bus_clears++;
+	gpio_config(&conf);
+	gpio_set_level(config->sda_pin, 1);
+	gpio_set_level(config->scl_pin, 1);
+	ets_delay_us(BUS_CLEAR_HALF_PERIOD_US);
+
+	for (int i = 0; i < 9 && gpio_get_level(config->sda_pin) == 0; i++) {
+		gpio_set_level(config->scl_pin, 0);
+		ets_delay_us(BUS_CLEAR_HALF_PERIOD_US);
+		gpio_set_level(config->scl_pin, 1);
+		ets_delay_us(BUS_CLEAR_HALF_PERIOD_US);
+	}
+
+	//STOP：SCL为高时SDA由低变高
+	gpio_set_level(config->scl_pin, 0);
+	ets_delay_us(BUS_CLEAR_HALF_PERIOD_US);
+	gpio_set_level(config->sda_pin, 0);
+	ets_delay_us(BUS_CLEAR_HALF_PERIOD_US);
+	gpio_set_level(config->scl_pin, 1);
+	ets_delay_us(BUS_CLEAR_HALF_PERIOD_US);
+	gpio_set_level(config->sda_pin, 1);
+	ets_delay_us(BUS_CLEAR_HALF_PERIOD_US);
+
+	if (gpio_get_level(config->sda_pin) == 0) {
+		ESP_LOGE(TAG, "I2C %d SDA still held low after bus clear", port);
+		return ESP_FAIL;
+	}
+	return ESP_OK;
+}
+
+/* 描述：执行下一级恢复，仅由采集任务在传感器连续读取失败时调用
+ * 第一级只释放总线并重新发送周期测量命令，之后每级重新初始化整个端口，全部用完后标记为失效
+ * 参数dev：连续读取失败的传感器 */
+static void sht3x_recover_step(sht3x_handle_t dev)
+{
+	dev->failures = 0;
+	if (dev->recovery > RECOVERY_STEPS) {
+		//已标记为失效，继续按周期尝试读取，不再重复恢复
+		return;
+	}
+
+	dev->recovery++;
+	if (dev->recovery > RECOVERY_STEPS) {
+		ESP_LOGE(TAG, "SHT3X 0x%02x failed after %d recovery steps", dev->addr >> 1, RECOVERY_STEPS);
+		return;
+	}
+
+	ESP_LOGW(TAG, "SHT3X 0x%02x readout failing, recovery step %d", dev->addr >> 1, dev->recovery);
+	if (dev->recovery == 1) {
+		i2c_config_t conf;
+		i2c_master_config(&bus_configs[dev->port], &conf);
+		i2c_bus_clear(dev->port);
+		i2c_param_config(dev->port, &conf);
+		SHT3x_Send_Cmd(dev, periodic_cmd);
+	} else {
+		sht3x_recover(dev->port);
+	}
+}
+
+/* 描述：周期模式采集任务，按测量间隔依次读取所有传感器的最新结果并写入各自的环形缓冲区
+ * 传感器在周期模式下自行完成转换，多个传感器在同一次唤醒中读取，不会各自等待转换时间 */
+static void sht3x_fetch_task(void *arg)
+{
+	uint16_t raw_temperature, raw_humidity;
+	esp_err_t ret;
+	TickType_t last_wake = xTaskGetTickCount();
+
+	while (true) {
+		vTaskDelayUntil(&last_wake, fetch_interval_ms / portTICK_PERIOD_MS);
+
+		for (size_t i = 0; i < periodic_count; i++) {
+			sht3x_handle_t dev = periodic_devices[i];
+
+			ret = SHT3x_Send_Cmd(dev, READOUT_FOR_PERIODIC_MODE);
+			if (ret == ESP_OK) {
+				ret = sht3x_read_measurement(dev, &raw_temperature, &raw_humidity);
+			}
+
+			//传感器尚未完成新的测量时会NACK，等待下一个周期即可，连续失败才恢复总线
+			if (ret != ESP_OK) {
+				ESP_LOGD(TAG, "Periodic readout from 0x%02x not ready: %s", dev->addr >> 1, esp_err_to_name(ret));
+				if (++dev->failures >= RECOVERY_FAILURES) {
+					sht3x_recover_step(dev);
+				}
+				continue;
+			}
+
+			if (dev->recovery > 0) {
+				ESP_LOGW(TAG, "SHT3X 0x%02x recovered after %d steps", dev->addr >> 1, dev->recovery);
+				stats.recoveries++;
+			}
+			dev->failures = 0;
+			dev->recovery = 0;
+
+			sample_ring_push(dev, raw_temperature, raw_humidity);
+			filter_push(dev, raw_temperature, raw_humidity);
+		}
+	}
+}
+
+/* 描述：让一组传感器进入周期测量模式，并启动后台采集任务
+ * 参数handles：传感器实例数组
+ * 参数count：传感器数量
+ * 参数mps：每秒测量次数
+ * 参数repeatability：测量重复性
+ * 返回值：成功返回ESP_OK */
+esp_err_t sht3x_periodic_start(const sht3x_handle_t *handles, size_t count, sht3x_mps_t mps, sht3x_repeatability_t repeatability)
+{
+	if (count == 0 || count > SHT3X_MAX_SENSORS || mps > SHT3X_MPS_10 || repeatability > SHT3X_REPEATABILITY_LOW) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	if (fetch_task_handle != NULL) {
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		esp_err_t ret = SHT3x_Send_Cmd(handles[i], periodic_cmds[mps][repeatability]);
+		if (ret != ESP_OK) {
+			ESP_LOGE(TAG, "Fail to enter periodic mode at 0x%02x: %s", handles[i]->addr >> 1, esp_err_to_name(ret));
+			while (i-- > 0) {
+				SHT3x_Send_Cmd(handles[i], BREAK_CMD);
+			}
+			return ret;
+		}
+		periodic_devices[i] = handles[i];
+	}
+	periodic_count = count;
+	periodic_cmd = periodic_cmds[mps][repeatability];
+
+	fetch_interval_ms = periodic_interval_ms[mps];
+	ESP_LOGI(TAG, "SHT3X periodic mode started on %d sensors, interval %u ms", (int)count, fetch_interval_ms);
+
+	if (xTaskCreate(sht3x_fetch_task, "sht3x_fetch_task", 2048, NULL, 6, &fetch_task_handle) != pdPASS) {
+		sht3x_periodic_stop();
+		return ESP_ERR_NO_MEM;
+	}
+
+	return ESP_OK;
+}
+
+/* 描述：让一个传感器加入已经运行的周期测量模式，用于启动时没有响应、之后才初始化成功的传感器
+ * 参数dev：传感器实例
+ * 返回值：成功返回ESP_OK，周期模式未启动返回ESP_ERR_INVALID_STATE */
+esp_err_t sht3x_periodic_add(sht3x_handle_t dev)
+{
+	if (fetch_task_handle == NULL) {
+		return ESP_ERR_INVALID_STATE;
+	}
+	if (periodic_count == SHT3X_MAX_SENSORS) {
+		return ESP_ERR_NO_MEM;
+	}
+
+	esp_err_t ret = SHT3x_Send_Cmd(dev, periodic_cmd);
+	if (ret != ESP_OK) {
+		ESP_LOGE(TAG, "Fail to enter periodic mode at 0x%02x: %s", dev->addr >> 1, esp_err_to_name(ret));
+		return ret;
+	}
+
+	//先写入数组再增加计数，采集任务不会读到未写入的实例
+	taskENTER_CRITICAL();
+	periodic_devices[periodic_count] = dev;
+	periodic_count++;
+	taskEXIT_CRITICAL();
+	ESP_LOGI(TAG, "SHT3X 0x%02x joined periodic mode", dev->addr >> 1);
+	return ESP_OK;
+}
+
+/* 描述：停止后台采集任务，并让所有传感器退出周期测量模式
+ * 返回值：成功返回ESP_OK */
+esp_err_t sht3x_periodic_stop(void)
+{
+	esp_err_t ret = ESP_OK;
+
+	if (periodic_count == 0) {
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	if (fetch_task_handle != NULL) {
+		vTaskDelete(fetch_task_handle);
+		fetch_task_handle = NULL;
+	}
+
+	for (size_t i = 0; i < periodic_count; i++) {
+		esp_err_t err = SHT3x_Send_Cmd(periodic_devices[i], BREAK_CMD);
+		if (err != ESP_OK) {
+			ret = err;
+		}
+	}
+	periodic_count = 0;
+
+	return ret;
+}
+
+/* 描述：获取最新的一条采样，不访问I2C总线
+ * 参数dev：传感器实例
+ * 参数sample：存储采样的指针
+ * 返回值：成功返回ESP_OK，尚无采样返回ESP_ERR_NOT_FOUND */
+esp_err_t sht3x_get_latest(sht3x_handle_t dev, sht3x_sample_t *sample)
+{
+	while (true) {
+		uint32_t seq = dev->seq;
+		if (seq == 0) {
+			return ESP_ERR_NOT_FOUND;
+		}
+
+		*sample = dev->ring[(seq - 1) & SAMPLE_RING_MASK];
+		if (sample_ring_still_valid(dev, seq - 1)) {
+			return ESP_OK;
+		}
+	}
+}
+
+/* 描述：获取最近的若干条采样，不访问I2C总线
+ * 参数dev：传感器实例
+ * 参数samples：存储采样的数组，按从新到旧的顺序填充
+ * 参数count：数组长度
+ * 返回值：实际获取到的采样条数 */
+size_t sht3x_get_recent(sht3x_handle_t dev, sht3x_sample_t *samples, size_t count)
+{
+	while (true) {
+		uint32_t seq = dev->seq;
+		size_t n = MIN(count, MIN(seq, SAMPLE_RING_SIZE - 1));
+
+		for (size_t i = 0; i < n; i++) {
+			samples[i] = dev->ring[(seq - 1 - i) & SAMPLE_RING_MASK];
+		}
+
+		//最旧的一条仍有效，则其余更新的采样也一定有效
+		if (n == 0 || sample_ring_still_valid(dev, seq - n)) {
+			return n;
+		}
+	}
+}
+
+/* 描述：取出上次调用以来周期采集结果的统计量，并开始新的统计窗口，不访问I2C总线
+ * 统计的是中值滤波之后、EMA平滑之前的值，采样率即周期测量的频率
+ * 参数dev：传感器实例
+ * 参数out：统计结果，窗口内没有采样时count为0 */
+void sht3x_take_window(sht3x_handle_t dev, sht3x_window_t *out)
+{
+	taskENTER_CRITICAL();
+	sht3x_window_acc_t w = dev->window;
+	dev->window.count = 0;
+	taskEXIT_CRITICAL();
+
+	memset(out, 0, sizeof(*out));
+	out->count = w.count;
+	if (w.count > 0) {
+		window_moments_finish(&w.t, w.count, &out->temperature);
+		window_moments_finish(&w.h, w.count, &out->humidity);
+	}
+}
+
+/* 描述：恢复一个I2C端口：删除驱动，手动发出时钟释放总线，重新安装驱动，再软件复位端口上的所有传感器，
+ * 周期模式下的传感器复位后重新进入周期测量。周期模式下由采集任务自动调用，
+ * 其他时候只能在没有其他I2C事务时调用，例如启动时初始化传感器失败之后
+ * 参数port：I2C端口
+ * 返回值：驱动重新安装且所有传感器都接受了命令返回ESP_OK，否则返回第一个错误 */
+esp_err_t sht3x_recover(i2c_port_t port)
+{
+	esp_err_t ret = ESP_OK;
+
+	if (port >= I2C_NUM_MAX || !bus_installed[port]) {
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	ESP_LOGW(TAG, "Reinit I2C %d", port);
+	stats.reinits++;
+	i2c_driver_delete(port);
+	bus_installed[port] = false;
+	i2c_bus_clear(port);
+	ret = i2c_master_init(&bus_configs[port]);
+	if (ret != ESP_OK) {
+		ESP_LOGE(TAG, "Fail to reinstall I2C %d: %s", port, esp_err_to_name(ret));
+		return ret;
+	}
+	bus_installed[port] = true;
+
+	//软件复位前先退出周期模式
+	for (size_t i = 0; i < periodic_count; i++) {
+		if (periodic_devices[i]->port == port) {
+			SHT3x_Send_Cmd(periodic_devices[i], BREAK_CMD);
+		}
+	}
+	for (size_t i = 0; i < device_count; i++) {
+		if (devices[i].port == port) {
+			esp_err_t err = SHT3x_Send_Cmd(&devices[i], SOFT_RESET_CMD);
+			if (err != ESP_OK && ret == ESP_OK) {
+				ret = err;
+			}
+		}
+	}
+	vTaskDelay((SOFT_RESET_TIME_MS + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS + 1);
+
+	for (size_t i = 0; i < periodic_count; i++) {
+		if (periodic_devices[i]->port == port) {
+			esp_err_t err = SHT3x_Send_Cmd(periodic_devices[i], periodic_cmd);
+			if (err != ESP_OK && ret == ESP_OK) {
+				ret = err;
+			}
+		}
+	}
+
+	return ret;
+}
+
+/* 描述：判断周期模式下的传感器是否已经用完所有恢复手段仍然无法读取，重新读到数据后恢复为false
+ * 参数dev：传感器实例
+ * 返回值：失效返回true，调用者可以据此重启设备 */
+bool sht3x_is_failed(sht3x_handle_t dev)
+{
+	return dev->recovery > RECOVERY_STEPS;
+}
+
+/* 描述：获取驱动运行统计
+ * 参数out：存储统计结果的指针 */
+void sht3x_get_stats(sht3x_stats_t *out)
+{
+	*out = stats;
+}
+
+/* 描述：温度原始值转换为0.01°C为单位的整数，全程整数运算
+ * T = -45 + 175 * raw / (2^16-1)，四舍五入，与浮点公式在全部65536个原始值上结果一致
+ * 参数raw：温度原始值
+ * 返回值：温度，单位0.01°C */
+int16_t sht3x_raw_to_centi_celsius(uint16_t raw)
+{
+	return (int16_t)((17500u * raw + 32767u) / 65535u) - 4500;
+}
+
+/* 描述：湿度原始值转换为0.01%为单位的整数，全程整数运算
+ * RH = 100 * raw / (2^16-1)，四舍五入，与浮点公式在全部65536个原始值上结果一致
+ * 参数raw：湿度原始值
+ * 返回值：湿度，单位0.01% */
+uint16_t sht3x_raw_to_centi_percent(uint16_t raw)
+{
+	return (uint16_t)((10000u * raw + 32767u) / 65535u);
+}
+
+/* 描述：判断周期测量模式下的滤波结果是否已经可用，不影响滤入采样的计数
+ * 参数dev：传感器实例
+ * 返回值：可用返回true */
+bool sht3x_is_ready(sht3x_handle_t dev)
+{
+	taskENTER_CRITICAL();
+	bool valid = dev->filter.window_len >= (FILTER_MEDIAN_WINDOW + 1) / 2;
+	taskEXIT_CRITICAL();
+	return valid;
+}
+
+/* 描述：温湿度数据获取函数，返回后台采集并滤波后的结果，注意，需要提前调用sht3x_periodic_start
+ * 参数dev：传感器实例
+ * 参数Tem_val：存储温度数据的指针, 温度单位为0.01°C
+ * 参数Hum_val：存储湿度数据的指针, 湿度单位为0.01%
+ * 参数count：存储自上次调用以来滤入的原始采样数，可以为NULL
+ * 返回值：0-读取成功，1-读取失败 **********************************/
+uint8_t sht3x_get_humiture_periodic(sht3x_handle_t dev, int16_t *Tem_val, uint16_t *Hum_val, uint16_t *count)
+{
+	sht3x_filter_t *f = &dev->filter;
+	int16_t Temperature;
+	uint16_t Humidity;
+
+	taskENTER_CRITICAL();
+	int32_t ema_t = f->ema_t;
+	int32_t ema_h = f->ema_h;
+	uint16_t n = f->count;
+	uint32_t tick = f->tick;
+	//至少半个窗口的采样才能剔除单次尖峰
+	bool valid = f->window_len >= (FILTER_MEDIAN_WINDOW + 1) / 2;
+	f->count = 0;
+	taskEXIT_CRITICAL();
+
+	if (!valid) {
+		ESP_LOGE(TAG, "No periodic sample available");
 		return 1;
 	}
 
-	/* 转换温度数据 */
-	tem = (((uint16_t)buff[0]<<8) | buff[1]);//温度数据拼接
-	// T = -45 + 175 * tem / (2^16-1)
-	Temperature= 175.0*tem/65535.0-45.0;
+	/* 连续多个周期没有新采样，说明传感器或总线异常，不再返回旧数据 */
+	if ((xTaskGetTickCount() - tick) * portTICK_PERIOD_MS > 3 * fetch_interval_ms + 1000) {
+		ESP_LOGE(TAG, "Periodic sample is stale");
+		return 1;
+	}
 
-	/* 转换湿度数据 */
-	hum = (((uint16_t)buff[3]<<8) | buff[4]);//湿度数据拼接
-	// RH = hum*100 / (2^16-1)
-	Humidity= 100.0*hum/65535.0;
+	//滤波结果四舍五入回原始值，再用与单次采样相同的整数公式换算
+	Temperature = sht3x_raw_to_centi_celsius((ema_t + (1 << (FILTER_FRAC_BITS - 1))) >> FILTER_FRAC_BITS);
+	Humidity = sht3x_raw_to_centi_percent((ema_h + (1 << (FILTER_FRAC_BITS - 1))) >> FILTER_FRAC_BITS);
 
 	/* 过滤错误数据 */
-	if((Temperature>=-20)&&(Temperature<=125)&&(Humidity>=0)&&(Humidity<=100))
+	if((Temperature>=-2000)&&(Temperature<=12500)&&(Humidity<=10000))
 	{
 		*Tem_val = Temperature;
 		*Hum_val = Humidity;
+		if (count != NULL) {
+			*count = n;
+		}
 		return 0;
 	} else{
 		return 1;
@@ -0,0 +1,5 @@
+/* 主机构建模拟层：CPU周期计数器，按1GHz的名义主频返回纳秒数 */
+#pragma once
+#include <stdint.h>
+
+uint32_t soc_get_ccount(void);
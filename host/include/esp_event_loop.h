@@ -0,0 +1,11 @@
+/* 主机构建模拟层：旧版事件结构体 */
+#pragma once
+#include <stdint.h>
+#include "esp_event.h"
+
+typedef struct {
+    uint8_t ssid[32];
+    uint8_t ssid_len;
+    uint8_t bssid[6];
+    uint8_t reason;
+} system_event_sta_disconnected_t;
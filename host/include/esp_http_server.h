@@ -0,0 +1,50 @@
+/* 主机构建模拟层：URI处理函数保存在表中，通过host_httpd_get()调用 */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "esp_err.h"
+
+typedef void *httpd_handle_t;
+
+typedef enum {
+    HTTP_GET = 1,
+    HTTP_POST = 3,
+} httpd_method_t;
+
+typedef struct httpd_req {
+    const char *uri;
+    void *user_ctx;
+    char status[32];
+    char content_type[64];
+} httpd_req_t;
+
+typedef struct {
+    uint16_t server_port;
+    uint16_t max_open_sockets;
+    uint16_t max_uri_handlers;
+    uint32_t stack_size;
+    unsigned task_priority;
+} httpd_config_t;
+
+#define HTTPD_DEFAULT_CONFIG() {    \
+        .server_port = 80,          \
+        .max_open_sockets = 7,      \
+        .max_uri_handlers = 8,      \
+        .stack_size = 4096,         \
+        .task_priority = 5,         \
+    }
+
+typedef struct {
+    const char *uri;
+    httpd_method_t method;
+    esp_err_t (*handler)(httpd_req_t *r);
+    void *user_ctx;
+} httpd_uri_t;
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config);
+esp_err_t httpd_stop(httpd_handle_t handle);
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler);
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status);
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type);
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len);
@@ -0,0 +1,5 @@
+/* 主机构建模拟层 */
+#pragma once
+#include "esp_err.h"
+
+esp_err_t esp_netif_init(void);
@@ -0,0 +1,25 @@
+/* 主机构建模拟层：芯片级系统函数 */
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum {
+	ESP_RST_UNKNOWN = 0,
+	ESP_RST_POWERON,
+	ESP_RST_EXT,
+	ESP_RST_SW,
+	ESP_RST_PANIC,
+	ESP_RST_INT_WDT,
+	ESP_RST_TASK_WDT,
+	ESP_RST_WDT,
+	ESP_RST_DEEPSLEEP,
+	ESP_RST_BROWNOUT,
+	ESP_RST_SDIO,
+} esp_reset_reason_t;
+
+void esp_restart(void) __attribute__((noreturn));
+esp_err_t esp_efuse_mac_get_default(uint8_t *mac);
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+uint32_t esp_random(void);
+esp_reset_reason_t esp_reset_reason(void);
@@ -0,0 +1,5 @@
+/* 主机构建模拟层：高精度计时，使用模拟时间 */
+#pragma once
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
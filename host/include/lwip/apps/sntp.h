@@ -0,0 +1,14 @@
+/* 主机构建模拟层：sntp_init之后一段时间系统时间同步为主机时间 */
+#pragma once
+#include <time.h>
+#include <stdlib.h>
+//与SDK中lwip的头文件一样，间接引入FreeRTOS
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define SNTP_OPMODE_POLL 0
+
+void sntp_setoperatingmode(int operating_mode);
+void sntp_setservername(int idx, const char *server);
+void sntp_init(void);
+void sntp_stop(void);
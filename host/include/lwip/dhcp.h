@@ -0,0 +1,10 @@
+/* 主机构建模拟层：DHCP客户端状态，只保留服务器给出的租期 */
+#pragma once
+#include <stdint.h>
+#include "lwip/netif.h"
+
+struct dhcp {
+    uint32_t offered_t0_lease;  //租期，单位秒
+};
+
+#define netif_dhcp_data(netif) ((netif)->dhcp)
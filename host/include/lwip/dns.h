@@ -0,0 +1,2 @@
+/* 主机构建模拟层 */
+#pragma once
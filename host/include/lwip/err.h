@@ -0,0 +1,2 @@
+/* 主机构建模拟层：空头文件 */
+#pragma once
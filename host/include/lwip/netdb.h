@@ -0,0 +1,3 @@
+/* 主机构建模拟层 */
+#pragma once
+#include <netdb.h>
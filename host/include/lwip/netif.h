@@ -0,0 +1,8 @@
+/* 主机构建模拟层：网络接口，只保留DHCP客户端数据 */
+#pragma once
+
+struct dhcp;
+
+struct netif {
+    struct dhcp *dhcp;
+};
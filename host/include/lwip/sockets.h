@@ -0,0 +1,6 @@
+/* 主机构建模拟层：lwIP套接字接口直接使用主机的BSD套接字 */
+#pragma once
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
@@ -0,0 +1,5 @@
+/* 主机构建模拟层：ROM函数 */
+#pragma once
+#include <stdint.h>
+
+void ets_delay_us(uint32_t us);
@@ -0,0 +1,57 @@
+/* 主机构建模拟层：站点接口的地址和DHCP客户端状态 */
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+
+#define ESP_ERR_TCPIP_ADAPTER_BASE                  0x5000
+#define ESP_ERR_TCPIP_ADAPTER_INVALID_PARAMS        (ESP_ERR_TCPIP_ADAPTER_BASE + 0x01)
+#define ESP_ERR_TCPIP_ADAPTER_DHCP_ALREADY_STARTED  (ESP_ERR_TCPIP_ADAPTER_BASE + 0x03)
+#define ESP_ERR_TCPIP_ADAPTER_DHCP_ALREADY_STOPPED  (ESP_ERR_TCPIP_ADAPTER_BASE + 0x04)
+
+typedef enum {
+    TCPIP_ADAPTER_IF_STA = 0,
+    TCPIP_ADAPTER_IF_AP,
+    TCPIP_ADAPTER_IF_MAX
+} tcpip_adapter_if_t;
+
+typedef enum {
+    TCPIP_ADAPTER_DHCP_INIT = 0,
+    TCPIP_ADAPTER_DHCP_STARTED,
+    TCPIP_ADAPTER_DHCP_STOPPED,
+} tcpip_adapter_dhcp_status_t;
+
+typedef enum {
+    TCPIP_ADAPTER_DNS_MAIN = 0,
+    TCPIP_ADAPTER_DNS_BACKUP,
+    TCPIP_ADAPTER_DNS_MAX
+} tcpip_adapter_dns_type_t;
+
+//地址按网络字节序存放
+typedef struct {
+    uint32_t addr;
+} ip4_addr_t;
+
+typedef ip4_addr_t ip_addr_t;
+
+typedef struct {
+    ip4_addr_t ip;
+    ip4_addr_t netmask;
+    ip4_addr_t gw;
+} tcpip_adapter_ip_info_t;
+
+typedef struct {
+    ip_addr_t ip;
+} tcpip_adapter_dns_info_t;
+
+#define IPSTR "%d.%d.%d.%d"
+#define IP2STR(ipaddr) ((const uint8_t *)&(ipaddr)->addr)[0], ((const uint8_t *)&(ipaddr)->addr)[1], \
+    ((const uint8_t *)&(ipaddr)->addr)[2], ((const uint8_t *)&(ipaddr)->addr)[3]
+
+esp_err_t tcpip_adapter_dhcpc_start(tcpip_adapter_if_t tcpip_if);
+esp_err_t tcpip_adapter_dhcpc_stop(tcpip_adapter_if_t tcpip_if);
+esp_err_t tcpip_adapter_dhcpc_get_status(tcpip_adapter_if_t tcpip_if, tcpip_adapter_dhcp_status_t *status);
+esp_err_t tcpip_adapter_set_ip_info(tcpip_adapter_if_t tcpip_if, const tcpip_adapter_ip_info_t *ip_info);
+esp_err_t tcpip_adapter_get_netif(tcpip_adapter_if_t tcpip_if, void **netif);
+esp_err_t tcpip_adapter_get_ip_info(tcpip_adapter_if_t tcpip_if, tcpip_adapter_ip_info_t *ip_info);
+esp_err_t tcpip_adapter_set_dns_info(tcpip_adapter_if_t tcpip_if, tcpip_adapter_dns_type_t type, tcpip_adapter_dns_info_t *dns);
+esp_err_t tcpip_adapter_get_dns_info(tcpip_adapter_if_t tcpip_if, tcpip_adapter_dns_type_t type, tcpip_adapter_dns_info_t *dns);
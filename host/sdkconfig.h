@@ -0,0 +1,47 @@
+/* 主机构建使用的配置，与各Kconfig中的默认值保持一致 */
+#pragma once
+
+#define CONFIG_MQTT_URI "mqtt://127.0.0.1:1883"
+#define CONFIG_METRICS_HTTP_PORT 8080
+#define CONFIG_TELEMETRY_PERIOD_MS 300000
+#define CONFIG_CONN_BACKOFF_BASE_MS 2000
+#define CONFIG_CONN_BACKOFF_CAP_MS 120000
+#define CONFIG_CONN_ATTEMPT_TIMEOUT_MS 20000
+#define CONFIG_DLOG_RING_SIZE 2048
+#define CONFIG_REPORT_FORMAT 0
+#define CONFIG_REPORT_QOS 0
+#define CONFIG_REPORT_INFLIGHT_MAX 4
+#define CONFIG_REPORT_ACK_TIMEOUT_MS 30000
+#define CONFIG_REPORT_QUEUE_LEN 32
+#define CONFIG_REPORT_BATCH_MAX 16
+#define CONFIG_REPORT_BATCH_COUNT 1
+#define CONFIG_REPORT_BATCH_AGE_MS 60000
+#define CONFIG_REPORT_DEADBAND_TEMPERATURE 0
+#define CONFIG_REPORT_DEADBAND_HUMITURE 0
+#define CONFIG_REPORT_MAX_SILENCE_MS 600000
+#define CONFIG_REPORT_WINDOW_MS 0
+#define CONFIG_REPORT_TASK_STACK_SIZE 4096
+#define CONFIG_FLASH_LOG_DRAIN_BATCH 16
+#define CONFIG_FLASH_LOG_DRAIN_BATCHES 2
+//主机构建打开InfluxDB后端，发送到本机，可以用 nc -ulk 8089 查看
+#define CONFIG_EXPORT_INFLUX 1
+#define CONFIG_EXPORT_INFLUX_HOST "127.0.0.1"
+#define CONFIG_EXPORT_INFLUX_PORT 8089
+#define CONFIG_EXPORT_INFLUX_MEASUREMENT "sht3x"
+#define CONFIG_EXPORT_INFLUX_BATCH_COUNT 1
+
+#define CONFIG_SHT3X_DEVICE_ADDR 0x44
+#define CONFIG_SHT3X_SECOND_SENSOR 1
+#define CONFIG_SHT3X_SECOND_DEVICE_ADDR 0x45
+#define CONFIG_SHT3X_I2C_SDA_PIN_NUM 4
+#define CONFIG_SHT3X_I2C_SCL_PIN_NUM 5
+#define CONFIG_SHT3X_PERIODIC_MPS 1
+#define CONFIG_SHT3X_PERIODIC_REPEATABILITY 1
+#define CONFIG_SHT3X_SAMPLE_RING_SIZE 16
+#define CONFIG_SHT3X_FILTER_MEDIAN_WINDOW 5
+#define CONFIG_SHT3X_FILTER_EMA_SHIFT 2
+#define CONFIG_SHT3X_MAX_SENSORS 2
+
+#define CONFIG_EXAMPLE_WIFI_SSID "host"
+#define CONFIG_EXAMPLE_WIFI_PASSWORD ""
+#define CONFIG_EXAMPLE_WIFI_FAST_RECONNECT 1
@@ -0,0 +1,647 @@
+/* ESP-IDF系统组件的主机实现：日志、系统、事件循环、Wi-Fi、NVS、分区、HTTP服务和SNTP */
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <esp_err.h>
+#include <esp_log.h>
+#include <esp_system.h>
+#include <esp_netif.h>
+#include <esp_event.h>
+#include <esp_partition.h>
+#include <esp_http_server.h>
+#include <esp_timer.h>
+#include <nvs_flash.h>
+#include <rom/ets_sys.h>
+#include <driver/soc.h>
+#include <lwip/apps/sntp.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "host.h"
+
+/* ---------- 日志 ---------- */
+
+const char *esp_err_to_name(esp_err_t code)
+{
+	switch (code) {
+		case ESP_OK: return "ESP_OK";
+		case ESP_FAIL: return "ESP_FAIL";
+		case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+		case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+		case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+		case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+		case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+		case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+		case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+		case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+		case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+		case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+		default: return "UNKNOWN ERROR";
+	}
+}
+
+uint32_t esp_log_timestamp(void)
+{
+	return host_now_us() / 1000;
+}
+
+uint32_t esp_log_early_timestamp(void)
+{
+	return host_now_us() / 1000;
+}
+
+int64_t esp_timer_get_time(void)
+{
+	return host_now_us();
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+	static const char letters[] = "NEWIDV";
+	va_list args;
+
+	if (host_config.quiet && level > ESP_LOG_WARN) {
+		return;
+	}
+
+	fprintf(stderr, "%c (%u) %s: ", letters[level], esp_log_timestamp(), tag);
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	va_end(args);
+	fputc('\n', stderr);
+}
+
+/* ---------- 系统 ---------- */
+
+void esp_restart(void)
+{
+	fprintf(stderr, "esp_restart() called, exiting\n");
+	exit(2);
+}
+
+//主机上每次运行都视为上电复位
+esp_reset_reason_t esp_reset_reason(void)
+{
+	return ESP_RST_POWERON;
+}
+
+esp_err_t esp_efuse_mac_get_default(uint8_t *mac)
+{
+	static const uint8_t host_mac[6] = {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01};
+	memcpy(mac, host_mac, 6);
+	return ESP_OK;
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+	return 40 * 1024;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+	return 40 * 1024;
+}
+
+uint32_t esp_random(void)
+{
+	return host_rand();
+}
+
+//基准测试的计时使用真实时间而不是模拟时间，与perf的测量一致
+uint32_t soc_get_ccount(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+//只用于微秒级的忙等待，远小于模拟时间的精度，直接返回
+void ets_delay_us(uint32_t us)
+{
+}
+
+esp_err_t esp_netif_init(void)
+{
+	return ESP_OK;
+}
+
+/* ---------- 事件循环 ---------- */
+
+esp_event_base_t const WIFI_EVENT = "WIFI_EVENT";
+esp_event_base_t const IP_EVENT = "IP_EVENT";
+
+#define EVENT_HANDLER_MAX 16
+
+static struct {
+	esp_event_base_t base;
+	int32_t id;
+	esp_event_handler_t handler;
+	void *arg;
+} event_handlers[EVENT_HANDLER_MAX];
+
+esp_err_t esp_event_loop_create_default(void)
+{
+	return ESP_OK;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t event_base, int32_t event_id, esp_event_handler_t event_handler, void *event_handler_arg)
+{
+	for (int i = 0; i < EVENT_HANDLER_MAX; i++) {
+		if (event_handlers[i].handler == NULL) {
+			event_handlers[i].base = event_base;
+			event_handlers[i].id = event_id;
+			event_handlers[i].handler = event_handler;
+			event_handlers[i].arg = event_handler_arg;
+			return ESP_OK;
+		}
+	}
+	return ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_event_handler_unregister(esp_event_base_t event_base, int32_t event_id, esp_event_handler_t event_handler)
+{
+	for (int i = 0; i < EVENT_HANDLER_MAX; i++) {
+		if (event_handlers[i].base == event_base && event_handlers[i].id == event_id && event_handlers[i].handler == event_handler) {
+			event_handlers[i].handler = NULL;
+		}
+	}
+	return ESP_OK;
+}
+
+esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id, void *event_data, size_t event_data_size, TickType_t ticks_to_wait)
+{
+	for (int i = 0; i < EVENT_HANDLER_MAX; i++) {
+		if (event_handlers[i].handler && event_handlers[i].base == event_base &&
+				(event_handlers[i].id == event_id || event_handlers[i].id == ESP_EVENT_ANY_ID)) {
+			event_handlers[i].handler(event_handlers[i].arg, event_base, event_id, event_data);
+		}
+	}
+	return ESP_OK;
+}
+
+/* ---------- NVS ---------- */
+
+//内存中的键值表，进程退出即丢失，可以用host_nvs_load/host_nvs_save在多次运行之间保存以模拟重启
+#define NVS_KEY_NAME_MAX_SIZE 16
+#define NVS_MAX_NAMESPACES 8
+#define NVS_MAX_ENTRIES 64
+#define NVS_DATA_MAX 96
+
+typedef enum {
+	NVS_ENTRY_I32,
+	NVS_ENTRY_STR,
+	NVS_ENTRY_BLOB,
+} nvs_entry_type_t;
+
+typedef struct {
+	bool used;
+	nvs_entry_type_t type;
+	char ns[NVS_KEY_NAME_MAX_SIZE];
+	char key[NVS_KEY_NAME_MAX_SIZE];
+	int32_t i32;
+	uint8_t data[NVS_DATA_MAX];
+	size_t len;
+} nvs_entry_t;
+
+static char nvs_namespaces[NVS_MAX_NAMESPACES][NVS_KEY_NAME_MAX_SIZE];
+static nvs_entry_t nvs_entries[NVS_MAX_ENTRIES];
+
+esp_err_t nvs_flash_init(void)
+{
+	return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+	memset(nvs_entries, 0, sizeof(nvs_entries));
+	return ESP_OK;
+}
+
+//句柄是命名空间表的下标加1，读写模式记录在最高位
+#define NVS_HANDLE_RW 0x80000000u
+
+static const char *nvs_namespace(nvs_handle handle)
+{
+	uint32_t index = (handle & ~NVS_HANDLE_RW) - 1;
+	return index < NVS_MAX_NAMESPACES && nvs_namespaces[index][0] ? nvs_namespaces[index] : NULL;
+}
+
+static nvs_entry_t *nvs_find(nvs_handle handle, const char *key, bool create)
+{
+	const char *ns = nvs_namespace(handle);
+	nvs_entry_t *free_entry = NULL;
+
+	for (int i = 0; i < NVS_MAX_ENTRIES; i++) {
+		nvs_entry_t *e = &nvs_entries[i];
+		if (!e->used) {
+			free_entry = free_entry ? free_entry : e;
+		} else if (strcmp(e->ns, ns) == 0 && strcmp(e->key, key) == 0) {
+			return e;
+		}
+	}
+	if (create && free_entry) {
+		memset(free_entry, 0, sizeof(*free_entry));
+		free_entry->used = true;
+		strcpy(free_entry->ns, ns);
+		strcpy(free_entry->key, key);
+		return free_entry;
+	}
+	return NULL;
+}
+
+static esp_err_t nvs_check(nvs_handle handle, const char *key, bool write)
+{
+	if (nvs_namespace(handle) == NULL) {
+		return ESP_ERR_NVS_INVALID_HANDLE;
+	}
+	if (write && !(handle & NVS_HANDLE_RW)) {
+		return ESP_ERR_NVS_READ_ONLY;
+	}
+	if (key != NULL && strlen(key) > NVS_KEY_NAME_MAX_SIZE - 1) {
+		return ESP_ERR_NVS_KEY_TOO_LONG;
+	}
+	return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode open_mode, nvs_handle *out_handle)
+{
+	if (strlen(name) > NVS_KEY_NAME_MAX_SIZE - 1) {
+		return ESP_ERR_NVS_INVALID_NAME;
+	}
+
+	for (int i = 0; i < NVS_MAX_NAMESPACES; i++) {
+		if (nvs_namespaces[i][0] == '\0' || strcmp(nvs_namespaces[i], name) == 0) {
+			//只读打开不存在的命名空间时返回NOT_FOUND，与SDK一致
+			if (nvs_namespaces[i][0] == '\0' && open_mode == NVS_READONLY) {
+				return ESP_ERR_NVS_NOT_FOUND;
+			}
+			strcpy(nvs_namespaces[i], name);
+			*out_handle = (i + 1) | (open_mode == NVS_READWRITE ? NVS_HANDLE_RW : 0);
+			return ESP_OK;
+		}
+	}
+	return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+}
+
+esp_err_t nvs_set_i32(nvs_handle handle, const char *key, int32_t value)
+{
+	esp_err_t ret = nvs_check(handle, key, true);
+	if (ret != ESP_OK) {
+		return ret;
+	}
+	nvs_entry_t *e = nvs_find(handle, key, true);
+	if (e == NULL) {
+		return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+	}
+	e->type = NVS_ENTRY_I32;
+	e->i32 = value;
+	return ESP_OK;
+}
+
+esp_err_t nvs_get_i32(nvs_handle handle, const char *key, int32_t *out_value)
+{
+	esp_err_t ret = nvs_check(handle, key, false);
+	if (ret != ESP_OK) {
+		return ret;
+	}
+	nvs_entry_t *e = nvs_find(handle, key, false);
+	if (e == NULL) {
+		return ESP_ERR_NVS_NOT_FOUND;
+	}
+	if (e->type != NVS_ENTRY_I32) {
+		return ESP_ERR_NVS_TYPE_MISMATCH;
+	}
+	*out_value = e->i32;
+	return ESP_OK;
+}
+
+static esp_err_t nvs_set_data(nvs_handle handle, const char *key, nvs_entry_type_t type, const void *value, size_t length)
+{
+	esp_err_t ret = nvs_check(handle, key, true);
+	if (ret != ESP_OK) {
+		return ret;
+	}
+	if (length > NVS_DATA_MAX) {
+		return ESP_ERR_NVS_INVALID_LENGTH;
+	}
+	nvs_entry_t *e = nvs_find(handle, key, true);
+	if (e == NULL) {
+		return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+	}
+	e->type = type;
+	memcpy(e->data, value, length);
+	e->len = length;
+	return ESP_OK;
+}
+
+//与SDK一致：out_value为NULL时只返回所需长度
+static esp_err_t nvs_get_data(nvs_handle handle, const char *key, nvs_entry_type_t type, void *out_value, size_t *length)
+{
+	esp_err_t ret = nvs_check(handle, key, false);
+	if (ret != ESP_OK) {
+		return ret;
+	}
+	nvs_entry_t *e = nvs_find(handle, key, false);
+	if (e == NULL) {
+		return ESP_ERR_NVS_NOT_FOUND;
+	}
+	if (e->type != type) {
+		return ESP_ERR_NVS_TYPE_MISMATCH;
+	}
+	if (out_value == NULL) {
+		*length = e->len;
+		return ESP_OK;
+	}
+	if (*length < e->len) {
+		return ESP_ERR_NVS_INVALID_LENGTH;
+	}
+	memcpy(out_value, e->data, e->len);
+	*length = e->len;
+	return ESP_OK;
+}
+
+esp_err_t nvs_set_str(nvs_handle handle, const char *key, const char *value)
+{
+	return nvs_set_data(handle, key, NVS_ENTRY_STR, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_get_str(nvs_handle handle, const char *key, char *out_value, size_t *length)
+{
+	return nvs_get_data(handle, key, NVS_ENTRY_STR, out_value, length);
+}
+
+esp_err_t nvs_set_blob(nvs_handle handle, const char *key, const void *value, size_t length)
+{
+	return nvs_set_data(handle, key, NVS_ENTRY_BLOB, value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle handle, const char *key, void *out_value, size_t *length)
+{
+	return nvs_get_data(handle, key, NVS_ENTRY_BLOB, out_value, length);
+}
+
+esp_err_t nvs_erase_key(nvs_handle handle, const char *key)
+{
+	esp_err_t ret = nvs_check(handle, key, true);
+	if (ret != ESP_OK) {
+		return ret;
+	}
+	nvs_entry_t *e = nvs_find(handle, key, false);
+	if (e == NULL) {
+		return ESP_ERR_NVS_NOT_FOUND;
+	}
+	e->used = false;
+	return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle handle)
+{
+	return nvs_check(handle, NULL, true);
+}
+
+void nvs_close(nvs_handle handle)
+{
+}
+
+//把整个键值表原样写入文件，只用于同一个主机程序的多次运行之间
+void host_nvs_load(const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	if (f == NULL) {
+		return;
+	}
+	if (fread(nvs_namespaces, sizeof(nvs_namespaces), 1, f) != 1 || fread(nvs_entries, sizeof(nvs_entries), 1, f) != 1) {
+		memset(nvs_namespaces, 0, sizeof(nvs_namespaces));
+		memset(nvs_entries, 0, sizeof(nvs_entries));
+	}
+	fclose(f);
+}
+
+void host_nvs_save(const char *path)
+{
+	FILE *f = fopen(path, "wb");
+	if (f == NULL) {
+		perror(path);
+		return;
+	}
+	fwrite(nvs_namespaces, sizeof(nvs_namespaces), 1, f);
+	fwrite(nvs_entries, sizeof(nvs_entries), 1, f);
+	fclose(f);
+}
+
+/* ---------- 分区 ---------- */
+
+static esp_partition_t samples_partition = {
+	.type = ESP_PARTITION_TYPE_DATA,
+	.subtype = 0x40,
+	.size = 0x40000,
+	.label = "samples",
+};
+static uint8_t *samples_flash;
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label)
+{
+	if (label == NULL || strcmp(label, samples_partition.label) != 0) {
+		return NULL;
+	}
+	if (samples_flash == NULL) {
+		samples_flash = malloc(samples_partition.size);
+		memset(samples_flash, 0xFF, samples_partition.size);
+	}
+	return &samples_partition;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+	if (src_offset + size > partition->size) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	memcpy(dst, samples_flash + src_offset, size);
+	return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+	const uint8_t *p = src;
+
+	if (dst_offset + size > partition->size) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	for (size_t i = 0; i < size; i++) {
+		samples_flash[dst_offset + i] &= p[i];
+	}
+	return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t start_addr, size_t size)
+{
+	if (start_addr % 4096 || size % 4096 || start_addr + size > partition->size) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	memset(samples_flash + start_addr, 0xFF, size);
+	return ESP_OK;
+}
+
+/* ---------- HTTP服务 ---------- */
+
+#define URI_HANDLER_MAX 8
+
+static httpd_uri_t uri_handlers[URI_HANDLER_MAX];
+static FILE *httpd_out;
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config)
+{
+	*handle = uri_handlers;
+	return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle)
+{
+	return ESP_OK;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler)
+{
+	for (int i = 0; i < URI_HANDLER_MAX; i++) {
+		if (uri_handlers[i].uri == NULL) {
+			uri_handlers[i] = *uri_handler;
+			return ESP_OK;
+		}
+	}
+	return ESP_ERR_NO_MEM;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status)
+{
+	strncpy(r->status, status, sizeof(r->status) - 1);
+	return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type)
+{
+	strncpy(r->content_type, type, sizeof(r->content_type) - 1);
+	return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+	fprintf(httpd_out, "HTTP/1.1 %s\r\nContent-Type: %s\r\n\r\n", r->status, r->content_type);
+	if (buf) {
+		fwrite(buf, 1, buf_len < 0 ? strlen(buf) : buf_len, httpd_out);
+	}
+	return ESP_OK;
+}
+
+/* 描述：模拟一次GET请求，响应写入out
+ * 返回值：找到处理函数返回0，否则返回-1 */
+int host_httpd_get(const char *uri, FILE *out)
+{
+	for (int i = 0; i < URI_HANDLER_MAX; i++) {
+		if (uri_handlers[i].uri && uri_handlers[i].method == HTTP_GET && strcmp(uri_handlers[i].uri, uri) == 0) {
+			httpd_req_t req = {.uri = uri, .user_ctx = uri_handlers[i].user_ctx, .status = "200 OK", .content_type = "text/html"};
+			httpd_out = out;
+			uri_handlers[i].handler(&req);
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/* ---------- SNTP与系统时间 ----------
+ * 与设备一样，开机时系统时间从0开始，sntp_init之后经过sntp_delay_ms才同步到主机的真实时间。
+ * 模拟时间即设备晶振的时间，按clock_drift_ppm比真实时间走得快，系统时间在两次同步之间随晶振走，
+ * 与lwIP SNTP默认的更新间隔一样每小时重新同步一次，被拉回真实时间 */
+
+#define SNTP_UPDATE_US (3600ULL * 1000000)
+
+static bool sntp_started;
+static uint64_t sntp_start_us;
+static int64_t epoch_offset_us;
+
+void sntp_setoperatingmode(int operating_mode)
+{
+}
+
+void sntp_setservername(int idx, const char *server)
+{
+}
+
+void sntp_init(void)
+{
+	struct timespec ts;
+
+	//gettimeofday已被替换为模拟时间，这里用clock_gettime取主机真实时间
+	clock_gettime(CLOCK_REALTIME, &ts);
+	epoch_offset_us = (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000 - host_now_us();
+	sntp_start_us = host_now_us();
+	sntp_started = true;
+}
+
+void sntp_stop(void)
+{
+	sntp_started = false;
+}
+
+//设备时间dev对应的真实时间，以sntp_init时为起点扣除晶振误差
+static int64_t sntp_true_us(uint64_t dev)
+{
+	int64_t elapsed = dev - sntp_start_us;
+	return dev + epoch_offset_us - elapsed * host_config.clock_drift_ppm / 1000000;
+}
+
+int __wrap_gettimeofday(struct timeval *tv, void *tz)
+{
+	int64_t now = host_now_us();
+	uint64_t first_sync_us = sntp_start_us + (uint64_t)host_config.sntp_delay_ms * 1000;
+
+	if (sntp_started && now >= first_sync_us) {
+		uint64_t last_sync_us = first_sync_us + (now - first_sync_us) / SNTP_UPDATE_US * SNTP_UPDATE_US;
+		now = sntp_true_us(last_sync_us) + (now - last_sync_us);
+	}
+	tv->tv_sec = now / 1000000;
+	tv->tv_usec = now % 1000000;
+	return 0;
+}
+
+time_t __wrap_time(time_t *t)
+{
+	struct timeval tv;
+
+	__wrap_gettimeofday(&tv, NULL);
+	if (t) {
+		*t = tv.tv_sec;
+	}
+	return tv.tv_sec;
+}
+
+/* ---------- 内存分配计数 ---------- */
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+	__atomic_add_fetch(&host_stats.allocations, 1, __ATOMIC_RELAXED);
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+	__atomic_add_fetch(&host_stats.allocations, 1, __ATOMIC_RELAXED);
+	return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	__atomic_add_fetch(&host_stats.allocations, 1, __ATOMIC_RELAXED);
+	return __real_realloc(ptr, size);
+}
+
+uint32_t bench_allocations(void)
+{
+	return __atomic_load_n(&host_stats.allocations, __ATOMIC_RELAXED);
+}
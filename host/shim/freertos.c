@@ -0,0 +1,436 @@
+/* FreeRTOS的pthread实现
+ * 每个任务对应一个线程，时间按host_config.time_scale倍速推进，tick为10ms模拟时间。
+ * 线程栈远大于任务申请的栈，任务开始时把入口以下的一段栈填充为固定值，与FreeRTOS一样，
+ * 从底部找到第一个被改写的字节即得到栈的最大用量，uxTaskGetStackHighWaterMark()按申请的栈大小换算剩余量 */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <freertos/event_groups.h>
+#include <freertos/queue.h>
+
+#include "host.h"
+
+#define HOST_TASK_STACK_SIZE (256 * 1024)
+#define HOST_STACK_PAINT_SIZE (64 * 1024)
+//填充区与入口之间留出的距离，避开填充函数自身的栈帧
+#define HOST_STACK_PAINT_GAP 512
+#define HOST_STACK_PATTERN 0xa5
+
+typedef struct host_task {
+	pthread_t thread;
+	TaskFunction_t code;
+	void *param;
+	char name[16];
+	uint32_t stack_depth;       //任务申请的栈大小(字节)
+	const uint8_t *stack_top;   //任务入口处的栈地址
+	const uint8_t *paint_low;   //填充区的最低地址
+	size_t stack_peak;          //任务结束时的栈最大用量
+	bool finished;
+	struct host_task *next;
+} host_task_t;
+
+struct host_semaphore {
+	pthread_mutex_t mutex;
+};
+
+struct host_event_group {
+	pthread_mutex_t mutex;
+	EventBits_t bits;
+};
+
+struct host_queue {
+	pthread_mutex_t mutex;
+	UBaseType_t length;
+	UBaseType_t item_size;
+	UBaseType_t head;
+	UBaseType_t count;
+	uint8_t items[];
+};
+
+static pthread_mutex_t critical_mutex;
+static pthread_once_t critical_once = PTHREAD_ONCE_INIT;
+static __thread host_task_t *current_task;
+//所有创建过的任务，用于在运行结束时输出各任务的栈用量
+static host_task_t *task_list;
+static pthread_mutex_t task_list_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t real_now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+//模拟时间，从第一次调用开始计时
+uint64_t host_now_us(void)
+{
+	static uint64_t start;
+	uint64_t now = real_now_us();
+
+	if (start == 0) {
+		start = now;
+	}
+	return (now - start) * host_config.time_scale;
+}
+
+void host_sleep_ms(uint32_t ms)
+{
+	uint64_t us = (uint64_t)ms * 1000 / host_config.time_scale;
+	struct timespec ts = {
+		.tv_sec = us / 1000000,
+		.tv_nsec = (us % 1000000) * 1000,
+	};
+
+	while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+	}
+}
+
+//从填充区底部找到第一个被改写的字节，得到从入口开始的栈最大用量
+static size_t stack_used(const host_task_t *task)
+{
+	if (task->finished) {
+		return task->stack_peak;
+	}
+
+	const uint8_t *p = task->paint_low;
+	while (p < task->stack_top - HOST_STACK_PAINT_GAP && *p == HOST_STACK_PATTERN) {
+		p++;
+	}
+	return task->stack_top - p;
+}
+
+//线程退出后栈会被释放，在此之前记录最大用量
+static void task_finish(host_task_t *task)
+{
+	pthread_mutex_lock(&task_list_mutex);
+	if (task->stack_top != NULL && !task->finished) {
+		task->stack_peak = stack_used(task);
+		task->finished = true;
+	}
+	pthread_mutex_unlock(&task_list_mutex);
+}
+
+static __attribute__((noinline)) void stack_paint(host_task_t *task, const uint8_t *top)
+{
+	uint8_t *low = (uint8_t *)top - HOST_STACK_PAINT_GAP - HOST_STACK_PAINT_SIZE;
+
+	memset(low, HOST_STACK_PATTERN, HOST_STACK_PAINT_SIZE);
+	task->paint_low = low;
+	task->stack_top = top;
+}
+
+static void *task_entry(void *arg)
+{
+	host_task_t *task = arg;
+
+	stack_paint(task, __builtin_frame_address(0));
+	current_task = task;
+	task->code(task->param);
+	task_finish(task);
+	return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pxTaskCode, const char *pcName, uint32_t usStackDepth, void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask)
+{
+	host_task_t *task = calloc(1, sizeof(*task));
+	if (task == NULL) {
+		return pdFAIL;
+	}
+
+	task->code = pxTaskCode;
+	task->param = pvParameters;
+	task->stack_depth = usStackDepth;
+	strncpy(task->name, pcName, sizeof(task->name) - 1);
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, HOST_TASK_STACK_SIZE);
+	int err = pthread_create(&task->thread, &attr, task_entry, task);
+	pthread_attr_destroy(&attr);
+	if (err != 0) {
+		free(task);
+		return pdFAIL;
+	}
+	pthread_detach(task->thread);
+
+	pthread_mutex_lock(&task_list_mutex);
+	task->next = task_list;
+	task_list = task;
+	pthread_mutex_unlock(&task_list_mutex);
+
+	if (pxCreatedTask) {
+		*pxCreatedTask = task;
+	}
+	return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete)
+{
+	host_task_t *task = xTaskToDelete ? xTaskToDelete : current_task;
+
+	if (task == NULL) {
+		pthread_exit(NULL);
+	}
+	task_finish(task);
+	if (task == current_task) {
+		pthread_exit(NULL);
+	}
+	pthread_cancel(task->thread);
+}
+
+void vTaskDelay(TickType_t xTicksToDelay)
+{
+	host_sleep_ms(xTicksToDelay * portTICK_PERIOD_MS);
+}
+
+void vTaskDelayUntil(TickType_t *pxPreviousWakeTime, TickType_t xTimeIncrement)
+{
+	TickType_t wake = *pxPreviousWakeTime + xTimeIncrement;
+	TickType_t now = xTaskGetTickCount();
+
+	if ((int32_t)(wake - now) > 0) {
+		vTaskDelay(wake - now);
+	}
+	*pxPreviousWakeTime = wake;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+	return host_now_us() / 1000 / portTICK_PERIOD_MS;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+	return current_task;
+}
+
+//返回值与SDK一致，单位为字节，栈的用量超过申请的大小时为0；主线程不是任务，返回0
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask)
+{
+	const host_task_t *task = xTask ? xTask : current_task;
+
+	if (task == NULL || task->stack_top == NULL) {
+		return 0;
+	}
+
+	size_t used = stack_used(task);
+	return used >= task->stack_depth ? 0 : task->stack_depth - used;
+}
+
+/* 描述：按任务名输出栈的最大用量和申请的大小，同名任务（如每次连接创建的任务）取最大值 */
+void host_print_task_stacks(FILE *out)
+{
+	pthread_mutex_lock(&task_list_mutex);
+	for (host_task_t *task = task_list; task != NULL; task = task->next) {
+		bool printed = false;
+		for (host_task_t *t = task_list; t != task; t = t->next) {
+			printed |= strcmp(t->name, task->name) == 0;
+		}
+		if (printed || task->stack_top == NULL) {
+			continue;
+		}
+
+		size_t peak = 0;
+		for (host_task_t *t = task; t != NULL; t = t->next) {
+			if (strcmp(t->name, task->name) == 0 && t->stack_top != NULL && stack_used(t) > peak) {
+				peak = stack_used(t);
+			}
+		}
+		fprintf(out, "  %-18s %5zu of %5u bytes\n", task->name, peak, (unsigned)task->stack_depth);
+	}
+	pthread_mutex_unlock(&task_list_mutex);
+}
+
+static void critical_init(void)
+{
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&critical_mutex, &attr);
+}
+
+void vPortEnterCritical(void)
+{
+	pthread_once(&critical_once, critical_init);
+	pthread_mutex_lock(&critical_mutex);
+}
+
+void vPortExitCritical(void)
+{
+	pthread_mutex_unlock(&critical_mutex);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+	SemaphoreHandle_t sem = calloc(1, sizeof(*sem));
+	if (sem) {
+		pthread_mutex_init(&sem->mutex, NULL);
+	}
+	return sem;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xBlockTime)
+{
+	if (xBlockTime == portMAX_DELAY) {
+		return pthread_mutex_lock(&xSemaphore->mutex) == 0 ? pdTRUE : pdFALSE;
+	}
+
+	TickType_t deadline = xTaskGetTickCount() + xBlockTime;
+	while (pthread_mutex_trylock(&xSemaphore->mutex) != 0) {
+		if ((int32_t)(deadline - xTaskGetTickCount()) <= 0) {
+			return pdFALSE;
+		}
+		vTaskDelay(1);
+	}
+	return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore)
+{
+	return pthread_mutex_unlock(&xSemaphore->mutex) == 0 ? pdTRUE : pdFALSE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t xSemaphore)
+{
+	pthread_mutex_destroy(&xSemaphore->mutex);
+	free(xSemaphore);
+}
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+	EventGroupHandle_t group = calloc(1, sizeof(*group));
+	if (group) {
+		pthread_mutex_init(&group->mutex, NULL);
+	}
+	return group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToSet)
+{
+	pthread_mutex_lock(&xEventGroup->mutex);
+	EventBits_t bits = xEventGroup->bits |= uxBitsToSet;
+	pthread_mutex_unlock(&xEventGroup->mutex);
+	return bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToClear)
+{
+	pthread_mutex_lock(&xEventGroup->mutex);
+	EventBits_t bits = xEventGroup->bits;
+	xEventGroup->bits &= ~uxBitsToClear;
+	pthread_mutex_unlock(&xEventGroup->mutex);
+	return bits;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t xEventGroup)
+{
+	pthread_mutex_lock(&xEventGroup->mutex);
+	EventBits_t bits = xEventGroup->bits;
+	pthread_mutex_unlock(&xEventGroup->mutex);
+	return bits;
+}
+
+//与设备一致：返回满足条件时或超时时的位，满足条件且xClearOnExit时清除等待的位
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToWaitFor, const BaseType_t xClearOnExit, const BaseType_t xWaitForAllBits, TickType_t xTicksToWait)
+{
+	TickType_t deadline = xTaskGetTickCount() + xTicksToWait;
+
+	while (true) {
+		pthread_mutex_lock(&xEventGroup->mutex);
+		EventBits_t bits = xEventGroup->bits;
+		EventBits_t match = bits & uxBitsToWaitFor;
+		if (xWaitForAllBits ? match == uxBitsToWaitFor : match != 0) {
+			if (xClearOnExit) {
+				xEventGroup->bits &= ~uxBitsToWaitFor;
+			}
+			pthread_mutex_unlock(&xEventGroup->mutex);
+			return bits;
+		}
+		pthread_mutex_unlock(&xEventGroup->mutex);
+
+		if (xTicksToWait != portMAX_DELAY && (int32_t)(deadline - xTaskGetTickCount()) <= 0) {
+			return bits;
+		}
+		vTaskDelay(1);
+	}
+}
+
+void vEventGroupDelete(EventGroupHandle_t xEventGroup)
+{
+	pthread_mutex_destroy(&xEventGroup->mutex);
+	free(xEventGroup);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize)
+{
+	QueueHandle_t queue = calloc(1, sizeof(*queue) + uxQueueLength * uxItemSize);
+	if (queue) {
+		pthread_mutex_init(&queue->mutex, NULL);
+		queue->length = uxQueueLength;
+		queue->item_size = uxItemSize;
+	}
+	return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait)
+{
+	TickType_t deadline = xTaskGetTickCount() + xTicksToWait;
+
+	while (true) {
+		pthread_mutex_lock(&xQueue->mutex);
+		if (xQueue->count < xQueue->length) {
+			UBaseType_t tail = (xQueue->head + xQueue->count) % xQueue->length;
+			memcpy(xQueue->items + tail * xQueue->item_size, pvItemToQueue, xQueue->item_size);
+			xQueue->count++;
+			pthread_mutex_unlock(&xQueue->mutex);
+			return pdTRUE;
+		}
+		pthread_mutex_unlock(&xQueue->mutex);
+
+		if (xTicksToWait != portMAX_DELAY && (int32_t)(deadline - xTaskGetTickCount()) <= 0) {
+			return pdFALSE;
+		}
+		vTaskDelay(1);
+	}
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait)
+{
+	TickType_t deadline = xTaskGetTickCount() + xTicksToWait;
+
+	while (true) {
+		pthread_mutex_lock(&xQueue->mutex);
+		if (xQueue->count > 0) {
+			memcpy(pvBuffer, xQueue->items + xQueue->head * xQueue->item_size, xQueue->item_size);
+			xQueue->head = (xQueue->head + 1) % xQueue->length;
+			xQueue->count--;
+			pthread_mutex_unlock(&xQueue->mutex);
+			return pdTRUE;
+		}
+		pthread_mutex_unlock(&xQueue->mutex);
+
+		if (xTicksToWait != portMAX_DELAY && (int32_t)(deadline - xTaskGetTickCount()) <= 0) {
+			return pdFALSE;
+		}
+		vTaskDelay(1);
+	}
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue)
+{
+	pthread_mutex_lock(&xQueue->mutex);
+	UBaseType_t count = xQueue->count;
+	pthread_mutex_unlock(&xQueue->mutex);
+	return count;
+}
+
+void vQueueDelete(QueueHandle_t xQueue)
+{
+	pthread_mutex_destroy(&xQueue->mutex);
+	free(xQueue);
+}
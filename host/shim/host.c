@@ -0,0 +1,23 @@
+/* 主机构建的运行参数、统计和随机数，模拟程序和host/test下的测试程序共用 */
+#include <pthread.h>
+
+#include "host.h"
+
+host_config_t host_config = {
+	.time_scale = 100,
+	.sntp_delay_ms = 2000,
+	.puback_ms = 40,
+	.seed = 1,
+};
+host_stats_t host_stats;
+
+static pthread_mutex_t rand_lock = PTHREAD_MUTEX_INITIALIZER;
+
+uint32_t host_rand(void)
+{
+	pthread_mutex_lock(&rand_lock);
+	host_config.seed = host_config.seed * 1103515245 + 12345;
+	uint32_t r = host_config.seed >> 1;
+	pthread_mutex_unlock(&rand_lock);
+	return r;
+}
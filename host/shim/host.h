@@ -0,0 +1,44 @@
+/* 主机构建内部接口：模拟时间、故障注入开关以及统计数据 */
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+//运行参数，由host_main.c根据命令行设置
+typedef struct {
+	uint32_t time_scale;        //模拟时间相对真实时间的倍速
+	uint32_t sntp_delay_ms;     //sntp_init之后多久完成时间同步
+	int32_t clock_drift_ppm;    //设备晶振比真实时间快多少(百万分之一)
+	uint32_t puback_ms;         //QoS 1消息的PUBACK往返时间
+	uint32_t i2c_crc_error_ppm; //I2C读数据CRC错误概率(百万分之一)
+	uint32_t i2c_nack_ppm;      //I2C无应答概率(百万分之一)
+	uint32_t seed;
+	bool ap_replaced;           //热点的BSSID、信道和网段与默认不同，模拟更换路由器
+	bool quiet;                 //不打印INFO及以下级别的日志
+	FILE *publish_out;          //记录所有发布的消息，NULL表示不记录
+} host_config_t;
+
+//运行统计
+typedef struct {
+	uint64_t allocations;
+	uint64_t i2c_transactions;
+	uint64_t i2c_errors;
+	uint64_t publishes;
+	uint64_t publish_bytes;
+} host_stats_t;
+
+extern host_config_t host_config;
+extern host_stats_t host_stats;
+
+uint64_t host_now_us(void);
+uint32_t host_rand(void);
+void host_sleep_ms(uint32_t ms);
+void host_print_task_stacks(FILE *out);
+
+void host_i2c_fault(const char *kind);
+void host_mqtt_inject(const char *topic, const char *data);
+void host_mqtt_set_online(bool online);
+void host_wifi_set_online(bool online);
+void host_nvs_load(const char *path);
+void host_nvs_save(const char *path);
+int host_httpd_get(const char *uri, FILE *out);
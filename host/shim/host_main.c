@@ -0,0 +1,246 @@
+/* 主机版固件入口
+ * 运行app_main，按模拟时间执行命令行指定的事件（下发命令、服务器上下线），结束时输出统计 */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "host.h"
+
+#define EVENT_MAX 64
+
+typedef enum {
+	EVENT_COMMAND,
+	EVENT_OFFLINE,
+	EVENT_ONLINE,
+	EVENT_WIFI_OFFLINE,
+	EVENT_WIFI_ONLINE,
+	EVENT_I2C_FAULT,
+} event_type_t;
+
+typedef struct {
+	uint64_t at_ms;
+	event_type_t type;
+	const char *data;
+	bool done;
+} host_event_t;
+
+static host_event_t events[EVENT_MAX];
+static int event_count;
+
+void app_main(void);
+size_t bench_run(const char *filter, uint32_t iterations);
+size_t host_sht3x_load_script(const char *path);
+
+static void add_event(uint64_t at_ms, event_type_t type, const char *data)
+{
+	if (event_count == EVENT_MAX) {
+		fprintf(stderr, "Too many events\n");
+		exit(1);
+	}
+	events[event_count++] = (host_event_t){.at_ms = at_ms, .type = type, .data = data};
+}
+
+static void run_events(void)
+{
+	uint64_t now_ms = host_now_us() / 1000;
+
+	for (int i = 0; i < event_count; i++) {
+		if (events[i].done || events[i].at_ms > now_ms) {
+			continue;
+		}
+		events[i].done = true;
+		switch (events[i].type) {
+			case EVENT_COMMAND:
+				host_mqtt_inject(NULL, events[i].data);
+				break;
+			case EVENT_OFFLINE:
+				host_mqtt_set_online(false);
+				break;
+			case EVENT_ONLINE:
+				host_mqtt_set_online(true);
+				break;
+			case EVENT_WIFI_OFFLINE:
+				host_wifi_set_online(false);
+				break;
+			case EVENT_WIFI_ONLINE:
+				host_wifi_set_online(true);
+				break;
+			case EVENT_I2C_FAULT:
+				host_i2c_fault(events[i].data);
+				break;
+		}
+	}
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+			"Usage: %s [options]\n"
+			"  -t SEC        simulated run time in seconds (default 60)\n"
+			"  -x SCALE      simulated time runs SCALE times faster than real time (default 100)\n"
+			"  -s MS         SNTP sync completes MS after sntp_init (default 2000)\n"
+			"  -D PPM        device clock runs PPM parts per million fast; SNTP resyncs hourly\n"
+			"  -c SEC:JSON   deliver JSON to /devices/<mac> at SEC\n"
+			"  -d SEC:SEC    broker is unreachable between the two times\n"
+			"  -R MS         PUBACK round-trip time for QoS 1 publishes (default 40)\n"
+			"  -w SEC:SEC    access point is out of range between the two times\n"
+			"  -A            access point replaced: different BSSID, channel and subnet\n"
+			"  -N FILE       load NVS from FILE at start and save it at exit, to simulate a reboot\n"
+			"  -e PPM        I2C CRC error rate in parts per million\n"
+			"  -n PPM        I2C NACK rate in parts per million\n"
+			"  -F SEC:KIND   inject an I2C fault at SEC: sda (slave holds SDA low), reset (sensor\n"
+			"                drops out of periodic mode), driver (controller hangs), dead (sensor gone),\n"
+			"                dead:ADDR / alive:ADDR (only the sensor at hex ADDR stops / resumes answering)\n"
+			"  -S FILE       sensor script, one \"temperature humidity\" pair in 0.01 units per line\n"
+			"  -o FILE       record every publish to FILE (- for stdout)\n"
+			"  -m            print /metrics at the end\n"
+			"  -r SEED       random seed for fault injection\n"
+			"  -q            only print warnings and errors\n"
+			"  -B CASE[:N]   run microbenchmarks whose name starts with CASE (all for every case)\n"
+			"                instead of the firmware, N iterations each; cycles are nanoseconds\n",
+			name);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t run_sec = 60;
+	bool print_metrics = false;
+	const char *bench = NULL;
+	uint32_t bench_iterations = 0;
+	const char *nvs_path = NULL;
+	int opt;
+
+	//glibc向无缓冲的流输出时在调用者栈上分配BUFSIZ字节的缓冲区，日志改为行缓冲，任务的栈用量才接近设备
+	setvbuf(stderr, NULL, _IOLBF, BUFSIZ);
+
+	while ((opt = getopt(argc, argv, "t:x:s:D:c:d:R:w:AN:e:n:F:S:o:mr:qB:")) != -1) {
+		char *sep;
+		switch (opt) {
+			case 't': run_sec = atoi(optarg); break;
+			case 'x': host_config.time_scale = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+			case 's': host_config.sntp_delay_ms = atoi(optarg); break;
+			case 'D': host_config.clock_drift_ppm = atoi(optarg); break;
+			case 'e': host_config.i2c_crc_error_ppm = atoi(optarg); break;
+			case 'n': host_config.i2c_nack_ppm = atoi(optarg); break;
+			case 'r': host_config.seed = atoi(optarg); break;
+			case 'q': host_config.quiet = true; break;
+			case 'm': print_metrics = true; break;
+			case 'B':
+				bench = optarg;
+				sep = strchr(optarg, ':');
+				if (sep != NULL) {
+					*sep = '\0';
+					bench_iterations = atoi(sep + 1);
+				}
+				break;
+			case 'c':
+				sep = strchr(optarg, ':');
+				if (sep == NULL) {
+					usage(argv[0]);
+				}
+				add_event(atof(optarg) * 1000, EVENT_COMMAND, sep + 1);
+				break;
+			case 'd':
+				sep = strchr(optarg, ':');
+				if (sep == NULL) {
+					usage(argv[0]);
+				}
+				add_event(atof(optarg) * 1000, EVENT_OFFLINE, NULL);
+				add_event(atof(sep + 1) * 1000, EVENT_ONLINE, NULL);
+				break;
+			case 'w':
+				sep = strchr(optarg, ':');
+				if (sep == NULL) {
+					usage(argv[0]);
+				}
+				add_event(atof(optarg) * 1000, EVENT_WIFI_OFFLINE, NULL);
+				add_event(atof(sep + 1) * 1000, EVENT_WIFI_ONLINE, NULL);
+				break;
+			case 'F':
+				sep = strchr(optarg, ':');
+				if (sep == NULL) {
+					usage(argv[0]);
+				}
+				add_event(atof(optarg) * 1000, EVENT_I2C_FAULT, sep + 1);
+				break;
+			case 'A': host_config.ap_replaced = true; break;
+			case 'R': host_config.puback_ms = atoi(optarg); break;
+			case 'N':
+				nvs_path = optarg;
+				host_nvs_load(nvs_path);
+				break;
+			case 'S':
+				if (host_sht3x_load_script(optarg) == 0) {
+					fprintf(stderr, "Empty sensor script %s\n", optarg);
+					exit(1);
+				}
+				break;
+			case 'o':
+				host_config.publish_out = strcmp(optarg, "-") ? fopen(optarg, "w") : stdout;
+				if (host_config.publish_out == NULL) {
+					perror(optarg);
+					exit(1);
+				}
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+
+	//基准测试不启动固件，在主线程中直接运行，便于perf record
+	if (bench != NULL) {
+		if (bench_run(bench, bench_iterations) == 0) {
+			fprintf(stderr, "No benchmark matches %s\n", bench);
+			exit(1);
+		}
+		fflush(NULL);
+		_exit(0);
+	}
+
+	host_now_us();
+	//0秒的事件在启动前生效，例如开机时就没有应答的传感器
+	run_events();
+	app_main();
+
+	while (host_now_us() / 1000000 < run_sec) {
+		run_events();
+		host_sleep_ms(100);
+	}
+
+	if (nvs_path) {
+		host_nvs_save(nvs_path);
+	}
+
+	if (print_metrics && host_httpd_get("/metrics", stdout) != 0) {
+		fprintf(stderr, "No /metrics handler registered\n");
+	}
+
+	struct timespec cpu;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+	double cpu_us = cpu.tv_sec * 1e6 + cpu.tv_nsec / 1e3;
+
+	fprintf(stderr,
+			"\n--- host run summary ---\n"
+			"simulated time     %u s\n"
+			"cpu time           %.0f us\n"
+			"i2c transactions   %llu (%llu failed)\n"
+			"publishes          %llu\n"
+			"bytes published    %llu (%.1f per publish)\n"
+			"cpu per publish    %.1f us\n"
+			"heap allocations   %llu\n",
+			run_sec, cpu_us,
+			(unsigned long long)host_stats.i2c_transactions, (unsigned long long)host_stats.i2c_errors,
+			(unsigned long long)host_stats.publishes,
+			(unsigned long long)host_stats.publish_bytes,
+			host_stats.publishes ? (double)host_stats.publish_bytes / host_stats.publishes : 0.0,
+			host_stats.publishes ? cpu_us / host_stats.publishes : 0.0,
+			(unsigned long long)host_stats.allocations);
+	fprintf(stderr, "task stack peak\n");
+	host_print_task_stacks(stderr);
+
+	fflush(NULL);
+	_exit(0);
+}
@@ -0,0 +1,381 @@
+/* I2C主机驱动的模拟实现，总线上挂着可编程的SHT3x传感器
+ * 支持单次测量、周期测量、读取序列号、软件复位等命令，回复数据带正确的CRC，
+ * 并可按概率注入无应答和CRC错误。测量值默认是缓慢变化的正弦曲线，也可以从脚本文件逐条读取。
+ * 还可以注入需要驱动恢复的故障（见host_i2c_fault），SDA/SCL引脚切换为GPIO时模拟从机对SCL时钟的响应 */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <driver/i2c.h>
+#include <driver/gpio.h>
+
+#include "host.h"
+
+#define OP_MAX 16
+#define SENSOR_MAX 2
+
+typedef enum {
+	OP_START,
+	OP_WRITE,
+	OP_READ,
+	OP_STOP,
+} op_type_t;
+
+typedef struct {
+	op_type_t type;
+	uint8_t byte;
+	uint8_t *data;
+	size_t len;
+} op_t;
+
+struct host_i2c_cmd {
+	op_t ops[OP_MAX];
+	int count;
+};
+
+typedef struct {
+	uint8_t addr;
+	uint32_t serial;
+	bool periodic;
+	uint32_t interval_ms;
+	uint64_t periodic_start_us;
+	uint64_t last_read_index;
+	uint8_t out[6];
+	size_t out_len;
+	uint32_t measure_count;
+	bool dead;          //只有这一个传感器不再应答
+} fake_sensor_t;
+
+static fake_sensor_t sensors[SENSOR_MAX] = {
+	{.addr = 0x44, .serial = 0x0A1B2C3D},
+	{.addr = 0x45, .serial = 0x4E5F6071},
+};
+static bool driver_installed;
+
+//需要驱动恢复的故障
+static int sda_stuck_clocks;    //从机拉低SDA，还需要多少个SCL时钟才会释放，期间所有事务失败
+static bool driver_hung;        //控制器卡死，所有事务超时，重新安装驱动后恢复
+static bool sensors_dead;       //传感器不再应答，无法恢复
+static int sda_pin = -1;
+static int scl_pin = -1;
+static uint32_t scl_level = 1;
+
+//脚本中的测量值，单位0.01
+static int32_t (*script)[2];
+static size_t script_len;
+
+static uint8_t crc8(const uint8_t *data, size_t len)
+{
+	uint8_t crc = 0xFF;
+
+	for (size_t i = 0; i < len; i++) {
+		crc ^= data[i];
+		for (int b = 0; b < 8; b++) {
+			crc = crc & 0x80 ? (crc << 1) ^ 0x31 : crc << 1;
+		}
+	}
+	return crc;
+}
+
+static bool inject(uint32_t ppm)
+{
+	return ppm && host_rand() % 1000000 < ppm;
+}
+
+//把两个16位数按SHT3x的格式（每个字后跟CRC）写入输出缓冲区
+static void sensor_put_words(fake_sensor_t *sensor, uint16_t a, uint16_t b)
+{
+	sensor->out[0] = a >> 8;
+	sensor->out[1] = a;
+	sensor->out[2] = crc8(&sensor->out[0], 2);
+	sensor->out[3] = b >> 8;
+	sensor->out[4] = b;
+	sensor->out[5] = crc8(&sensor->out[3], 2);
+	sensor->out_len = 6;
+
+	if (inject(host_config.i2c_crc_error_ppm)) {
+		sensor->out[5] ^= 0x5A;
+	}
+}
+
+//生成一次测量结果
+static void sensor_measure(fake_sensor_t *sensor)
+{
+	int32_t t, h;
+
+	if (script_len) {
+		t = script[sensor->measure_count % script_len][0];
+		h = script[sensor->measure_count % script_len][1];
+	} else {
+		double s = host_now_us() / 1e6;
+		t = 2500 + 300 * sin(s / 600.0) + sensor->addr - 0x44;
+		h = 5000 + 1000 * cos(s / 900.0);
+	}
+	sensor->measure_count++;
+
+	uint16_t raw_t = ((int64_t)t + 4500) * 65535 / 17500;
+	uint16_t raw_h = (int64_t)h * 65535 / 10000;
+	sensor_put_words(sensor, raw_t, raw_h);
+}
+
+static void sensor_command(fake_sensor_t *sensor, uint16_t cmd)
+{
+	static const struct {
+		uint8_t msb;
+		uint32_t interval_ms;
+	} periodic_modes[] = {
+		{0x20, 2000}, {0x21, 1000}, {0x22, 500}, {0x23, 250}, {0x27, 100},
+	};
+
+	sensor->out_len = 0;
+
+	switch (cmd) {
+		case 0x30A2:    //软件复位
+		case 0x3093:    //退出周期测量
+			sensor->periodic = false;
+			return;
+		case 0x3780:    //读取序列号
+			sensor_put_words(sensor, sensor->serial >> 16, sensor->serial);
+			return;
+		case 0xE000:    //读取周期测量结果，没有新结果时保持输出为空，读取会无应答
+			if (sensor->periodic) {
+				uint64_t index = (host_now_us() - sensor->periodic_start_us) / 1000 / sensor->interval_ms;
+				if (index > sensor->last_read_index) {
+					sensor->last_read_index = index;
+					sensor_measure(sensor);
+				}
+			}
+			return;
+	}
+
+	//单次测量
+	if ((cmd >> 8) == 0x2C || (cmd >> 8) == 0x24) {
+		sensor_measure(sensor);
+		return;
+	}
+
+	for (int i = 0; i < sizeof(periodic_modes) / sizeof(periodic_modes[0]); i++) {
+		if ((cmd >> 8) == periodic_modes[i].msb) {
+			sensor->periodic = true;
+			sensor->interval_ms = periodic_modes[i].interval_ms;
+			sensor->periodic_start_us = host_now_us();
+			sensor->last_read_index = 0;
+			return;
+		}
+	}
+}
+
+static fake_sensor_t *sensor_find(uint8_t addr)
+{
+	for (int i = 0; i < SENSOR_MAX; i++) {
+		if (sensors[i].addr == addr) {
+			return &sensors[i];
+		}
+	}
+	return NULL;
+}
+
+/* 描述：从文件加载测量值脚本，每行为以0.01为单位的温度和湿度，循环使用
+ * 返回值：成功加载的条数 */
+size_t host_sht3x_load_script(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	int32_t t, h;
+
+	if (f == NULL) {
+		return 0;
+	}
+	while (fscanf(f, "%d %d", &t, &h) == 2) {
+		script = realloc(script, (script_len + 1) * sizeof(*script));
+		script[script_len][0] = t;
+		script[script_len][1] = h;
+		script_len++;
+	}
+	fclose(f);
+	return script_len;
+}
+
+/* 描述：注入一个需要驱动恢复的故障
+ * 参数kind：sda表示从机停在读取中途拉低SDA；reset表示传感器掉电复位退出周期模式；
+ *           driver表示I2C控制器卡死；dead表示传感器永久失效；
+ *           dead:ADDR和alive:ADDR让十六进制地址为ADDR的一个传感器失效或重新应答 */
+void host_i2c_fault(const char *kind)
+{
+	if (strcmp(kind, "sda") == 0) {
+		sda_stuck_clocks = 1 + host_rand() % 9;
+	} else if (strcmp(kind, "reset") == 0) {
+		for (int i = 0; i < SENSOR_MAX; i++) {
+			sensors[i].periodic = false;
+			sensors[i].out_len = 0;
+		}
+	} else if (strcmp(kind, "driver") == 0) {
+		driver_hung = true;
+	} else if (strcmp(kind, "dead") == 0) {
+		sensors_dead = true;
+	} else if (strncmp(kind, "dead:", 5) == 0 || strncmp(kind, "alive:", 6) == 0) {
+		fake_sensor_t *sensor = sensor_find(strtoul(strchr(kind, ':') + 1, NULL, 16));
+		if (sensor == NULL) {
+			fprintf(stderr, "Unknown I2C address in %s\n", kind);
+			return;
+		}
+		sensor->dead = kind[0] == 'd';
+	} else {
+		fprintf(stderr, "Unknown I2C fault %s\n", kind);
+	}
+}
+
+esp_err_t gpio_config(const gpio_config_t *gpio_cfg)
+{
+	return ESP_OK;
+}
+
+//SCL的每个下降沿让卡住的从机移出一位
+esp_err_t gpio_set_level(int gpio_num, uint32_t level)
+{
+	if (gpio_num == scl_pin) {
+		if (scl_level && !level && sda_stuck_clocks > 0) {
+			sda_stuck_clocks--;
+		}
+		scl_level = level;
+	}
+	return ESP_OK;
+}
+
+int gpio_get_level(int gpio_num)
+{
+	if (gpio_num == sda_pin) {
+		return sda_stuck_clocks == 0;
+	}
+	return gpio_num == scl_pin ? scl_level : 1;
+}
+
+esp_err_t i2c_driver_install(i2c_port_t i2c_num, i2c_mode_t mode)
+{
+	if (driver_installed) {
+		return ESP_FAIL;
+	}
+	driver_installed = true;
+	return ESP_OK;
+}
+
+esp_err_t i2c_driver_delete(i2c_port_t i2c_num)
+{
+	driver_installed = false;
+	driver_hung = false;
+	return ESP_OK;
+}
+
+esp_err_t i2c_param_config(i2c_port_t i2c_num, const i2c_config_t *i2c_conf)
+{
+	sda_pin = i2c_conf->sda_io_num;
+	scl_pin = i2c_conf->scl_io_num;
+	return ESP_OK;
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create(void)
+{
+	return calloc(1, sizeof(struct host_i2c_cmd));
+}
+
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd_handle)
+{
+	free(cmd_handle);
+}
+
+static esp_err_t push_op(i2c_cmd_handle_t cmd, op_t op)
+{
+	if (cmd->count == OP_MAX) {
+		return ESP_ERR_NO_MEM;
+	}
+	cmd->ops[cmd->count++] = op;
+	return ESP_OK;
+}
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd_handle)
+{
+	return push_op(cmd_handle, (op_t){.type = OP_START});
+}
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd_handle)
+{
+	return push_op(cmd_handle, (op_t){.type = OP_STOP});
+}
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd_handle, uint8_t data, int ack_en)
+{
+	return push_op(cmd_handle, (op_t){.type = OP_WRITE, .byte = data});
+}
+
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd_handle, uint8_t *data, size_t data_len, int ack)
+{
+	return push_op(cmd_handle, (op_t){.type = OP_READ, .data = data, .len = data_len});
+}
+
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd_handle, uint8_t *data, int ack)
+{
+	return push_op(cmd_handle, (op_t){.type = OP_READ, .data = data, .len = 1});
+}
+
+/* 描述：执行一次I2C事务，只支持 START 地址 [写数据...|读数据...] STOP 的形式 */
+esp_err_t i2c_master_cmd_begin(i2c_port_t i2c_num, i2c_cmd_handle_t cmd_handle, TickType_t ticks_to_wait)
+{
+	const op_t *ops = cmd_handle->ops;
+	int count = cmd_handle->count;
+
+	host_stats.i2c_transactions++;
+
+	if (!driver_installed) {
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	if (count < 3 || ops[0].type != OP_START || ops[1].type != OP_WRITE || ops[count - 1].type != OP_STOP) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	if (driver_hung) {
+		host_stats.i2c_errors++;
+		return ESP_ERR_TIMEOUT;
+	}
+	if (sda_stuck_clocks > 0 || sensors_dead) {
+		host_stats.i2c_errors++;
+		return ESP_FAIL;
+	}
+
+	fake_sensor_t *sensor = sensor_find(ops[1].byte >> 1);
+	if (sensor == NULL || sensor->dead || inject(host_config.i2c_nack_ppm)) {
+		host_stats.i2c_errors++;
+		return ESP_FAIL;
+	}
+
+	//写命令
+	if ((ops[1].byte & 1) == 0) {
+		uint8_t buf[2];
+		int n = 0;
+		for (int i = 2; i < count - 1 && ops[i].type == OP_WRITE && n < 2; i++) {
+			buf[n++] = ops[i].byte;
+		}
+		if (n == 2) {
+			sensor_command(sensor, (buf[0] << 8) | buf[1]);
+		}
+		return ESP_OK;
+	}
+
+	//读数据，没有待读取的数据时传感器不应答
+	if (sensor->out_len == 0) {
+		host_stats.i2c_errors++;
+		return ESP_FAIL;
+	}
+
+	size_t pos = 0;
+	for (int i = 2; i < count - 1; i++) {
+		if (ops[i].type != OP_READ) {
+			continue;
+		}
+		for (size_t j = 0; j < ops[i].len; j++) {
+			ops[i].data[j] = pos < sensor->out_len ? sensor->out[pos] : 0xFF;
+			pos++;
+		}
+	}
+	sensor->out_len = 0;
+
+	return ESP_OK;
+}
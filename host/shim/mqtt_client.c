@@ -0,0 +1,236 @@
+/* MQTT客户端的主机实现
+ * 发布的消息只做统计并可记录到文件，不真正发送；连接状态和下行命令由host_main.c注入。
+ * QoS 1消息在host_config.puback_ms之后收到PUBACK，断线期间不确认，重连后视为重发并重新计时。
+ * 服务器离线时客户端保持启动状态，服务器上线后自动连接，与esp-mqtt的自动重连一致 */
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <mqtt_client.h>
+#include <esp_system.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "host.h"
+
+struct esp_mqtt_client {
+	esp_mqtt_client_config_t config;
+	esp_event_handler_t handler;
+	void *handler_arg;
+	bool started;
+	bool connected;
+	int next_msg_id;
+	char subscription[64];
+	pthread_mutex_t lock;
+};
+
+//主机上只有一个客户端实例
+static struct esp_mqtt_client *the_client;
+static bool broker_online = true;
+
+//与esp-mqtt默认的接收缓冲区大小相同，更长的消息分片交给事件处理函数
+#define RX_BUFFER_SIZE 1024
+
+//等待PUBACK的QoS 1消息
+#define PENDING_MAX 64
+
+static struct {
+	int msg_id;
+	uint64_t due_us;
+} pending[PENDING_MAX];
+
+char *platform_create_id_string(void)
+{
+	uint8_t mac[6];
+	char *id_string = calloc(1, 32);
+
+	esp_efuse_mac_get_default(mac);
+	sprintf(id_string, "ESP32_%02x%02X%02X", mac[3], mac[4], mac[5]);
+	return id_string;
+}
+
+static void dispatch(struct esp_mqtt_client *client, esp_mqtt_event_t *event)
+{
+	event->client = client;
+	event->user_context = client->handler_arg;
+	if (client->handler) {
+		client->handler(client->handler_arg, "MQTT_EVENTS", event->event_id, event);
+	}
+}
+
+static void update_connection(struct esp_mqtt_client *client)
+{
+	bool connected = client->started && broker_online;
+
+	if (connected == client->connected) {
+		return;
+	}
+	client->connected = connected;
+
+	//重连后重发所有未确认的消息
+	if (connected) {
+		pthread_mutex_lock(&client->lock);
+		for (int i = 0; i < PENDING_MAX; i++) {
+			pending[i].due_us = host_now_us() + (uint64_t)host_config.puback_ms * 1000;
+		}
+		pthread_mutex_unlock(&client->lock);
+	}
+
+	esp_mqtt_event_t event = {.event_id = connected ? MQTT_EVENT_CONNECTED : MQTT_EVENT_DISCONNECTED};
+	dispatch(client, &event);
+}
+
+static void ack_task(void *arg)
+{
+	struct esp_mqtt_client *client = arg;
+
+	while (true) {
+		vTaskDelay(1);
+
+		for (int i = 0; i < PENDING_MAX; i++) {
+			pthread_mutex_lock(&client->lock);
+			int msg_id = 0;
+			if (pending[i].msg_id != 0 && client->connected && host_now_us() >= pending[i].due_us) {
+				msg_id = pending[i].msg_id;
+				pending[i].msg_id = 0;
+			}
+			pthread_mutex_unlock(&client->lock);
+
+			if (msg_id != 0) {
+				esp_mqtt_event_t event = {.event_id = MQTT_EVENT_PUBLISHED, .msg_id = msg_id};
+				dispatch(client, &event);
+			}
+		}
+	}
+}
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config)
+{
+	struct esp_mqtt_client *client = calloc(1, sizeof(*client));
+
+	client->config = *config;
+	client->next_msg_id = 1;
+	pthread_mutex_init(&client->lock, NULL);
+	the_client = client;
+	xTaskCreate(ack_task, "mqtt_ack", 2048, client, 5, NULL);
+	return client;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client)
+{
+	client->started = true;
+	update_connection(client);
+
+	//与esp-mqtt一致，服务器不可用时连接失败也会收到断开事件
+	if (!client->connected) {
+		esp_mqtt_event_t event = {.event_id = MQTT_EVENT_DISCONNECTED};
+		dispatch(client, &event);
+	}
+	return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client)
+{
+	client->started = false;
+	update_connection(client);
+	return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event, esp_event_handler_t event_handler, void *event_handler_arg)
+{
+	client->handler = event_handler;
+	client->handler_arg = event_handler_arg;
+	return ESP_OK;
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos)
+{
+	strncpy(client->subscription, topic, sizeof(client->subscription) - 1);
+	return client->connected ? client->next_msg_id++ : -1;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain)
+{
+	if (len == 0 && data) {
+		len = strlen(data);
+	}
+
+	pthread_mutex_lock(&client->lock);
+	if (!client->connected) {
+		pthread_mutex_unlock(&client->lock);
+		return -1;
+	}
+
+	//与esp-mqtt一致，QoS 0消息的ID为0
+	int msg_id = qos > 0 ? client->next_msg_id++ : 0;
+	if (qos > 0) {
+		for (int i = 0; i < PENDING_MAX; i++) {
+			if (pending[i].msg_id == 0) {
+				pending[i].msg_id = msg_id;
+				pending[i].due_us = host_now_us() + (uint64_t)host_config.puback_ms * 1000;
+				break;
+			}
+		}
+	}
+	host_stats.publishes++;
+	host_stats.publish_bytes += len;
+
+	//每条消息记录为一行：时间(ms) 主题 长度 内容（二进制内容按十六进制输出）
+	if (host_config.publish_out) {
+		bool text = true;
+		for (int i = 0; i < len; i++) {
+			if ((unsigned char)data[i] < 0x20 || (unsigned char)data[i] > 0x7e) {
+				text = false;
+				break;
+			}
+		}
+		fprintf(host_config.publish_out, "%llu %s %d ", (unsigned long long)host_now_us() / 1000, topic, len);
+		for (int i = 0; i < len; i++) {
+			fprintf(host_config.publish_out, text ? "%c" : "%02x", (unsigned char)data[i]);
+		}
+		fputc('\n', host_config.publish_out);
+		fflush(host_config.publish_out);
+	}
+	pthread_mutex_unlock(&client->lock);
+
+	return msg_id;
+}
+
+/* 描述：模拟服务器上线或下线，客户端会收到对应的连接事件 */
+void host_mqtt_set_online(bool online)
+{
+	broker_online = online;
+	if (the_client) {
+		update_connection(the_client);
+	}
+}
+
+/* 描述：模拟服务器向设备下发一条消息，topic为NULL时使用设备订阅的主题 */
+void host_mqtt_inject(const char *topic, const char *data)
+{
+	if (the_client == NULL || !the_client->connected) {
+		return;
+	}
+
+	if (topic == NULL) {
+		topic = the_client->subscription;
+	}
+
+	//真实客户端不保证data以\0结尾，这里复制到堆上且不带结尾的\0，越界读取可以被ASan等工具发现
+	int len = strlen(data);
+	char *copy = malloc(len);
+	memcpy(copy, data, len);
+
+	for (int offset = 0; offset == 0 || offset < len; offset += RX_BUFFER_SIZE) {
+		esp_mqtt_event_t event = {
+			.event_id = MQTT_EVENT_DATA,
+			.topic = (char *)topic,
+			.topic_len = strlen(topic),
+			.data = copy + offset,
+			.data_len = len - offset < RX_BUFFER_SIZE ? len - offset : RX_BUFFER_SIZE,
+			.total_data_len = len,
+			.current_data_offset = offset,
+		};
+		dispatch(the_client, &event);
+	}
+	free(copy);
+}
@@ -0,0 +1,316 @@
+/* Wi-Fi和TCP/IP适配层的主机实现
+ * 模拟一个热点和它的DHCP服务器：不指定BSSID时扫描全部信道再关联，指定BSSID和信道时只探测该信道；
+ * DHCP客户端停止且配置了静态地址时，关联后直接投递获取IP事件，与SDK的默认事件处理一致；
+ * 已关联时启动DHCP客户端会重新获取租约，服务器总是分配同一个地址。
+ * 各步骤耗时取典型值，连接过程在独立任务中进行，结果通过事件通知 */
+#include <string.h>
+#include <esp_err.h>
+#include <esp_log.h>
+#include <esp_event.h>
+#include <esp_event_loop.h>
+#include <esp_wifi.h>
+#include <tcpip_adapter.h>
+#include <lwip/dhcp.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "host.h"
+
+#define WIFI_SCAN_ALL_MS 1500   //扫描全部13个信道
+#define WIFI_SCAN_ONE_MS 120    //只在指定信道探测
+#define WIFI_ASSOC_MS    250    //认证、关联和四次握手
+#define WIFI_DHCP_MS     1200   //DISCOVER/OFFER/REQUEST/ACK
+#define WIFI_DHCP_LEASE_S 7200  //家用路由器常见的租期
+
+typedef struct {
+	uint8_t bssid[6];
+	uint8_t channel;
+	uint8_t subnet;
+} host_ap_t;
+
+//第二个热点模拟更换路由器之后的情况（-A），BSSID、信道和网段都不同
+static const host_ap_t host_aps[2] = {
+	{{0x24, 0x0A, 0xC4, 0xAA, 0x00, 0x01}, 6, 4},
+	{{0x24, 0x0A, 0xC4, 0xAA, 0x00, 0x02}, 11, 5},
+};
+
+static bool wifi_inited;
+static bool wifi_started;
+static bool wifi_connecting;
+static bool wifi_connected;
+static bool ap_online = true;
+static wifi_config_t sta_config;
+static tcpip_adapter_dhcp_status_t dhcpc_status = TCPIP_ADAPTER_DHCP_INIT;
+static tcpip_adapter_ip_info_t sta_ip;
+static tcpip_adapter_dns_info_t sta_dns;
+static struct dhcp sta_dhcp;
+static struct netif sta_netif = {.dhcp = &sta_dhcp};
+
+static const host_ap_t *current_ap(void)
+{
+	return &host_aps[host_config.ap_replaced ? 1 : 0];
+}
+
+//按网络字节序构造地址
+static ip4_addr_t host_ip(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+{
+	const uint8_t bytes[4] = {a, b, c, d};
+	ip4_addr_t ip;
+	memcpy(&ip.addr, bytes, sizeof(ip.addr));
+	return ip;
+}
+
+static void post_disconnected(uint8_t reason)
+{
+	system_event_sta_disconnected_t event = {.reason = reason};
+	esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &event, sizeof(event), portMAX_DELAY);
+}
+
+static void post_got_ip(void)
+{
+	ip_event_got_ip_t event = {.ip_info = sta_ip};
+	esp_event_post(IP_EVENT, IP_EVENT_STA_GOT_IP, &event, sizeof(event), portMAX_DELAY);
+}
+
+//DHCP交换，服务器按热点所在网段分配固定的地址
+static void dhcp_exchange(const host_ap_t *ap)
+{
+	vTaskDelay(WIFI_DHCP_MS / portTICK_PERIOD_MS);
+	sta_ip.ip = host_ip(192, 168, ap->subnet, 100);
+	sta_ip.netmask = host_ip(255, 255, 255, 0);
+	sta_ip.gw = host_ip(192, 168, ap->subnet, 1);
+	sta_dns.ip = sta_ip.gw;
+	sta_dhcp.offered_t0_lease = WIFI_DHCP_LEASE_S;
+}
+
+static void wifi_connect_task(void *arg)
+{
+	const host_ap_t *ap = current_ap();
+	bool found;
+
+	if (sta_config.sta.bssid_set) {
+		vTaskDelay(WIFI_SCAN_ONE_MS / portTICK_PERIOD_MS);
+		found = memcmp(sta_config.sta.bssid, ap->bssid, sizeof(ap->bssid)) == 0 &&
+			(sta_config.sta.channel == 0 || sta_config.sta.channel == ap->channel);
+	} else {
+		vTaskDelay(WIFI_SCAN_ALL_MS / portTICK_PERIOD_MS);
+		found = strncmp((const char *)sta_config.sta.ssid, CONFIG_EXAMPLE_WIFI_SSID, sizeof(sta_config.sta.ssid)) == 0;
+	}
+
+	if (!found || !ap_online) {
+		wifi_connecting = false;
+		post_disconnected(WIFI_REASON_NO_AP_FOUND);
+		vTaskDelete(NULL);
+	}
+
+	vTaskDelay(WIFI_ASSOC_MS / portTICK_PERIOD_MS);
+	wifi_connecting = false;
+	wifi_connected = true;
+	esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, NULL, 0, portMAX_DELAY);
+
+	if (dhcpc_status != TCPIP_ADAPTER_DHCP_STOPPED) {
+		dhcpc_status = TCPIP_ADAPTER_DHCP_STARTED;
+		dhcp_exchange(ap);
+	} else if (sta_ip.ip.addr == 0) {
+		vTaskDelete(NULL);
+	}
+
+	//静态地址不会检查是否属于当前网段，与设备一致
+	post_got_ip();
+	vTaskDelete(NULL);
+}
+
+//已关联时启动DHCP客户端：重新获取租约，期间保留原地址
+static void dhcp_renew_task(void *arg)
+{
+	dhcp_exchange(current_ap());
+	if (wifi_connected && dhcpc_status == TCPIP_ADAPTER_DHCP_STARTED) {
+		post_got_ip();
+	}
+	vTaskDelete(NULL);
+}
+
+/* 描述：模拟热点离开或回到信号范围，离开时已连接的站点收到断开事件 */
+void host_wifi_set_online(bool online)
+{
+	ap_online = online;
+	if (!online && wifi_connected) {
+		wifi_connected = false;
+		post_disconnected(WIFI_REASON_BEACON_TIMEOUT);
+	}
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config)
+{
+	wifi_inited = true;
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_deinit(void)
+{
+	wifi_inited = false;
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_storage(wifi_storage_t storage)
+{
+	return wifi_inited ? ESP_OK : ESP_ERR_WIFI_NOT_INIT;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode)
+{
+	return wifi_inited ? ESP_OK : ESP_ERR_WIFI_NOT_INIT;
+}
+
+esp_err_t esp_wifi_set_protocol(esp_interface_t ifx, uint8_t protocol_bitmap)
+{
+	return wifi_inited ? ESP_OK : ESP_ERR_WIFI_NOT_INIT;
+}
+
+esp_err_t esp_wifi_set_config(esp_interface_t interface, wifi_config_t *conf)
+{
+	if (!wifi_inited) {
+		return ESP_ERR_WIFI_NOT_INIT;
+	}
+	sta_config = *conf;
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void)
+{
+	if (!wifi_inited) {
+		return ESP_ERR_WIFI_NOT_INIT;
+	}
+	wifi_started = true;
+	esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_START, NULL, 0, portMAX_DELAY);
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_stop(void)
+{
+	if (!wifi_inited) {
+		return ESP_ERR_WIFI_NOT_INIT;
+	}
+	wifi_started = false;
+	wifi_connected = false;
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_connect(void)
+{
+	if (!wifi_started) {
+		return ESP_ERR_WIFI_NOT_STARTED;
+	}
+
+	//已经在连接中时忽略，与设备一致
+	taskENTER_CRITICAL();
+	bool busy = wifi_connecting;
+	wifi_connecting = true;
+	taskEXIT_CRITICAL();
+	if (busy) {
+		return ESP_OK;
+	}
+
+	wifi_connected = false;
+	xTaskCreate(wifi_connect_task, "wifi_connect", 2048, NULL, 5, NULL);
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_disconnect(void)
+{
+	if (wifi_connected) {
+		wifi_connected = false;
+		post_disconnected(WIFI_REASON_ASSOC_FAIL);
+	}
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info)
+{
+	const host_ap_t *ap = current_ap();
+
+	if (!wifi_connected) {
+		return ESP_ERR_WIFI_NOT_CONNECT;
+	}
+
+	memset(ap_info, 0, sizeof(*ap_info));
+	memcpy(ap_info->bssid, ap->bssid, sizeof(ap->bssid));
+	strcpy((char *)ap_info->ssid, CONFIG_EXAMPLE_WIFI_SSID);
+	ap_info->primary = ap->channel;
+	ap_info->rssi = -50;
+	return ESP_OK;
+}
+
+/* ---------- TCP/IP适配层 ---------- */
+
+esp_err_t tcpip_adapter_dhcpc_start(tcpip_adapter_if_t tcpip_if)
+{
+	if (dhcpc_status == TCPIP_ADAPTER_DHCP_STARTED) {
+		return ESP_ERR_TCPIP_ADAPTER_DHCP_ALREADY_STARTED;
+	}
+	//接口未连接时只记录状态，关联后开始DHCP
+	if (!wifi_connected) {
+		dhcpc_status = TCPIP_ADAPTER_DHCP_INIT;
+		return ESP_OK;
+	}
+	dhcpc_status = TCPIP_ADAPTER_DHCP_STARTED;
+	xTaskCreate(dhcp_renew_task, "dhcpc", 2048, NULL, 5, NULL);
+	return ESP_OK;
+}
+
+esp_err_t tcpip_adapter_dhcpc_stop(tcpip_adapter_if_t tcpip_if)
+{
+	if (dhcpc_status == TCPIP_ADAPTER_DHCP_STOPPED) {
+		return ESP_ERR_TCPIP_ADAPTER_DHCP_ALREADY_STOPPED;
+	}
+	if (dhcpc_status == TCPIP_ADAPTER_DHCP_STARTED) {
+		memset(&sta_ip, 0, sizeof(sta_ip));
+	}
+	dhcpc_status = TCPIP_ADAPTER_DHCP_STOPPED;
+	return ESP_OK;
+}
+
+esp_err_t tcpip_adapter_dhcpc_get_status(tcpip_adapter_if_t tcpip_if, tcpip_adapter_dhcp_status_t *status)
+{
+	*status = dhcpc_status;
+	return ESP_OK;
+}
+
+esp_err_t tcpip_adapter_set_ip_info(tcpip_adapter_if_t tcpip_if, const tcpip_adapter_ip_info_t *ip_info)
+{
+	//与SDK一致：DHCP客户端运行时不能设置静态地址
+	if (dhcpc_status != TCPIP_ADAPTER_DHCP_STOPPED) {
+		return ESP_ERR_TCPIP_ADAPTER_INVALID_PARAMS;
+	}
+	sta_ip = *ip_info;
+	return ESP_OK;
+}
+
+esp_err_t tcpip_adapter_get_netif(tcpip_adapter_if_t tcpip_if, void **netif)
+{
+	*netif = &sta_netif;
+	return ESP_OK;
+}
+
+esp_err_t tcpip_adapter_get_ip_info(tcpip_adapter_if_t tcpip_if, tcpip_adapter_ip_info_t *ip_info)
+{
+	*ip_info = sta_ip;
+	return ESP_OK;
+}
+
+esp_err_t tcpip_adapter_set_dns_info(tcpip_adapter_if_t tcpip_if, tcpip_adapter_dns_type_t type, tcpip_adapter_dns_info_t *dns)
+{
+	if (type == TCPIP_ADAPTER_DNS_MAIN) {
+		sta_dns = *dns;
+	}
+	return ESP_OK;
+}
+
+esp_err_t tcpip_adapter_get_dns_info(tcpip_adapter_if_t tcpip_if, tcpip_adapter_dns_type_t type, tcpip_adapter_dns_info_t *dns)
+{
+	memset(dns, 0, sizeof(*dns));
+	if (type == TCPIP_ADAPTER_DNS_MAIN) {
+		*dns = sta_dns;
+	}
+	return ESP_OK;
+}
@@ -0,0 +1,201 @@
+/* cJSON生成部分的子集，见cJSON.h */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <float.h>
+
+#include "cJSON.h"
+
+typedef struct {
+	char *buf;
+	size_t len;
+	size_t size;
+} printbuffer;
+
+static cJSON *new_item(int type)
+{
+	cJSON *item = calloc(1, sizeof(cJSON));
+	item->type = type;
+	return item;
+}
+
+cJSON *cJSON_CreateObject(void)
+{
+	return new_item(cJSON_Object);
+}
+
+cJSON *cJSON_CreateArray(void)
+{
+	return new_item(cJSON_Array);
+}
+
+//与cJSON相同，valueint为饱和到int范围的整数部分
+cJSON *cJSON_CreateNumber(double num)
+{
+	cJSON *item = new_item(cJSON_Number);
+	item->valuedouble = num;
+	if (num >= INT_MAX) {
+		item->valueint = INT_MAX;
+	} else if (num <= (double)INT_MIN) {
+		item->valueint = INT_MIN;
+	} else {
+		item->valueint = (int)num;
+	}
+	return item;
+}
+
+cJSON *cJSON_CreateString(const char *string)
+{
+	cJSON *item = new_item(cJSON_String);
+	item->valuestring = strdup(string);
+	return item;
+}
+
+void cJSON_AddItemToArray(cJSON *array, cJSON *item)
+{
+	cJSON **p = &array->child;
+	while (*p) {
+		p = &(*p)->next;
+	}
+	*p = item;
+}
+
+void cJSON_AddItemToObject(cJSON *object, const char *string, cJSON *item)
+{
+	item->string = strdup(string);
+	cJSON_AddItemToArray(object, item);
+}
+
+cJSON *cJSON_AddNumberToObject(cJSON *object, const char *name, double number)
+{
+	cJSON *item = cJSON_CreateNumber(number);
+	cJSON_AddItemToObject(object, name, item);
+	return item;
+}
+
+cJSON *cJSON_AddStringToObject(cJSON *object, const char *name, const char *string)
+{
+	cJSON *item = cJSON_CreateString(string);
+	cJSON_AddItemToObject(object, name, item);
+	return item;
+}
+
+void cJSON_Delete(cJSON *item)
+{
+	while (item) {
+		cJSON *next = item->next;
+		cJSON_Delete(item->child);
+		free(item->valuestring);
+		free(item->string);
+		free(item);
+		item = next;
+	}
+}
+
+void cJSON_free(void *object)
+{
+	free(object);
+}
+
+static void put(printbuffer *p, const char *s, size_t n)
+{
+	if (p->len + n + 1 > p->size) {
+		p->size = (p->len + n + 1) * 2;
+		p->buf = realloc(p->buf, p->size);
+	}
+	memcpy(p->buf + p->len, s, n);
+	p->len += n;
+	p->buf[p->len] = '\0';
+}
+
+static int compare_double(double a, double b)
+{
+	double maxVal = fabs(a) > fabs(b) ? fabs(a) : fabs(b);
+	return fabs(a - b) <= maxVal * DBL_EPSILON;
+}
+
+//cJSON的print_number：整数值用%d，否则用%1.15g，不能精确还原时改用%1.17g
+static void print_number(const cJSON *item, printbuffer *p)
+{
+	char number_buffer[26];
+	double d = item->valuedouble;
+	double test = 0.0;
+	int length;
+
+	if (isnan(d) || isinf(d)) {
+		length = sprintf(number_buffer, "null");
+	} else if (d == (double)item->valueint) {
+		length = sprintf(number_buffer, "%d", item->valueint);
+	} else {
+		length = sprintf(number_buffer, "%1.15g", d);
+		if (sscanf(number_buffer, "%lg", &test) != 1 || !compare_double(test, d)) {
+			length = sprintf(number_buffer, "%1.17g", d);
+		}
+	}
+	put(p, number_buffer, length);
+}
+
+//cJSON的print_string_ptr：只转义引号、反斜杠和控制字符，其余字节原样输出
+static void print_string_ptr(const char *s, printbuffer *p)
+{
+	char escaped[8];
+
+	put(p, "\"", 1);
+	for (const unsigned char *c = (const unsigned char *)s; *c; c++) {
+		switch (*c) {
+			case '\"': put(p, "\\\"", 2); break;
+			case '\\': put(p, "\\\\", 2); break;
+			case '\b': put(p, "\\b", 2); break;
+			case '\f': put(p, "\\f", 2); break;
+			case '\n': put(p, "\\n", 2); break;
+			case '\r': put(p, "\\r", 2); break;
+			case '\t': put(p, "\\t", 2); break;
+			default:
+				if (*c < 32) {
+					put(p, escaped, sprintf(escaped, "\\u%04x", *c));
+				} else {
+					put(p, (const char *)c, 1);
+				}
+				break;
+		}
+	}
+	put(p, "\"", 1);
+}
+
+static void print_value(const cJSON *item, printbuffer *p)
+{
+	switch (item->type) {
+		case cJSON_Number:
+			print_number(item, p);
+			break;
+		case cJSON_String:
+			print_string_ptr(item->valuestring, p);
+			break;
+		case cJSON_Array:
+		case cJSON_Object:
+			put(p, item->type == cJSON_Array ? "[" : "{", 1);
+			for (const cJSON *child = item->child; child; child = child->next) {
+				if (item->type == cJSON_Object) {
+					print_string_ptr(child->string, p);
+					put(p, ":", 1);
+				}
+				print_value(child, p);
+				if (child->next) {
+					put(p, ",", 1);
+				}
+			}
+			put(p, item->type == cJSON_Array ? "]" : "}", 1);
+			break;
+	}
+}
+
+char *cJSON_PrintUnformatted(const cJSON *item)
+{
+	printbuffer p = {0};
+
+	put(&p, "", 0);
+	print_value(item, &p);
+	return p.buf;
+}
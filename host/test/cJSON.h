@@ -0,0 +1,31 @@
+/* cJSON生成部分的子集，供test_payload_json对照
+ * 接口与cJSON 1.7相同，数值和字符串的输出规则照搬cJSON的print_number和print_string_ptr，
+ * 可以直接换成上游的cJSON.h/cJSON.c，测试代码不需要修改 */
+#pragma once
+
+#define cJSON_Number 8
+#define cJSON_String 16
+#define cJSON_Array 32
+#define cJSON_Object 64
+
+typedef struct cJSON {
+	struct cJSON *next;
+	struct cJSON *child;
+	int type;
+	char *valuestring;
+	int valueint;
+	double valuedouble;
+	char *string;
+} cJSON;
+
+cJSON *cJSON_CreateObject(void);
+cJSON *cJSON_CreateArray(void);
+cJSON *cJSON_CreateNumber(double num);
+cJSON *cJSON_CreateString(const char *string);
+void cJSON_AddItemToArray(cJSON *array, cJSON *item);
+void cJSON_AddItemToObject(cJSON *object, const char *string, cJSON *item);
+cJSON *cJSON_AddNumberToObject(cJSON *object, const char *name, double number);
+cJSON *cJSON_AddStringToObject(cJSON *object, const char *name, const char *string);
+char *cJSON_PrintUnformatted(const cJSON *item);
+void cJSON_Delete(cJSON *item);
+void cJSON_free(void *object);
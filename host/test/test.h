@@ -0,0 +1,16 @@
+/* 主机测试的断言宏，失败时打印位置并计数，main结束时用TEST_RESULT返回退出码 */
+#pragma once
+#include <stdio.h>
+
+static int test_failures;
+
+#define TEST_CHECK(cond, ...) do { \
+		if (!(cond)) { \
+			test_failures++; \
+			fprintf(stderr, "%s:%d: check failed: %s: ", __FILE__, __LINE__, #cond); \
+			fprintf(stderr, __VA_ARGS__); \
+			fputc('\n', stderr); \
+		} \
+	} while (0)
+
+#define TEST_RESULT(name) (fprintf(stderr, "%s: %s\n", (name), test_failures ? "FAILED" : "ok"), test_failures ? 1 : 0)
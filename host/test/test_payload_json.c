@@ -0,0 +1,193 @@
+/* 上报报文：流式编码器的输出必须与用cJSON构造同样结构再cJSON_PrintUnformatted的结果逐字节一致，
+ * 覆盖单条、批量、负温度、需要转义的字符串和所有字段取最长值的情况 */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "payload.h"
+#include "cJSON.h"
+#include "test.h"
+
+#define MAC "24:0A:C4:00:00:01"
+//UTC 9999-12-31 23:59:59.999，15位十进制数
+#define TS_MAX 253402300799999LL
+
+static void add_time(cJSON *object, int64_t mono_ms, int64_t time_ms)
+{
+	cJSON_AddNumberToObject(object, "up", (uint32_t)mono_ms);
+	if (time_ms > 0) {
+		cJSON_AddNumberToObject(object, "ts", time_ms);
+	}
+}
+
+static void add_sample_data(cJSON *object, const payload_sample_t *sample)
+{
+	cJSON_AddNumberToObject(object, "temperature", sample->temperature);
+	cJSON_AddNumberToObject(object, "humiture", sample->humiture);
+	cJSON_AddNumberToObject(object, "count", sample->count);
+}
+
+static char *cjson_report(const payload_report_t *report)
+{
+	cJSON *message = cJSON_CreateObject();
+	cJSON_AddStringToObject(message, "type", report->count == 1 ? "report" : "batch");
+	cJSON_AddStringToObject(message, "mac", report->mac);
+	cJSON_AddNumberToObject(message, "sn", report->sn);
+
+	if (report->count == 1) {
+		add_time(message, report->samples[0].mono_ms, report->samples[0].time_ms);
+		cJSON *data = cJSON_CreateObject();
+		add_sample_data(data, &report->samples[0]);
+		cJSON_AddItemToObject(message, "data", data);
+	} else {
+		cJSON *samples = cJSON_CreateArray();
+		for (size_t i = 0; i < report->count; i++) {
+			cJSON *sample = cJSON_CreateObject();
+			add_time(sample, report->samples[i].mono_ms, report->samples[i].time_ms);
+			add_sample_data(sample, &report->samples[i]);
+			cJSON_AddItemToArray(samples, sample);
+		}
+		cJSON_AddItemToObject(message, "samples", samples);
+	}
+
+	char *out = cJSON_PrintUnformatted(message);
+	cJSON_Delete(message);
+	return out;
+}
+
+static void add_moments(cJSON *object, const char *name, const payload_moments_t *m)
+{
+	cJSON *moments = cJSON_CreateObject();
+	cJSON_AddNumberToObject(moments, "min", m->min);
+	cJSON_AddNumberToObject(moments, "max", m->max);
+	cJSON_AddNumberToObject(moments, "mean", m->mean);
+	cJSON_AddNumberToObject(moments, "stddev", m->stddev);
+	cJSON_AddItemToObject(object, name, moments);
+}
+
+static char *cjson_summary(const char *mac, uint32_t sn, const payload_summary_t *summary)
+{
+	cJSON *message = cJSON_CreateObject();
+	cJSON_AddStringToObject(message, "type", "summary");
+	cJSON_AddStringToObject(message, "mac", mac);
+	cJSON_AddNumberToObject(message, "sn", sn);
+	add_time(message, summary->mono_ms, summary->time_ms);
+	cJSON_AddNumberToObject(message, "window", summary->window_ms);
+	cJSON_AddNumberToObject(message, "count", summary->count);
+	add_moments(message, "temperature", &summary->temperature);
+	add_moments(message, "humiture", &summary->humiture);
+
+	char *out = cJSON_PrintUnformatted(message);
+	cJSON_Delete(message);
+	return out;
+}
+
+//按cJSON的结果编码一次，并检查缓冲区恰好够用和差一个字节时的行为
+static void check_report(const char *name, const payload_report_t *report)
+{
+	static char buf[PAYLOAD_JSON_LEN(CONFIG_REPORT_BATCH_MAX)];
+	char *expected = cjson_report(report);
+	size_t len = strlen(expected);
+
+	TEST_CHECK(len < PAYLOAD_JSON_LEN(report->count), "%s: %zu bytes exceed PAYLOAD_JSON_LEN(%zu)", name, len, report->count);
+
+	int n = payload_encode_json(buf, sizeof(buf), report);
+	TEST_CHECK(n == (int)len && strcmp(buf, expected) == 0, "%s:\n  cJSON  %s\n  stream %s", name, expected, buf);
+
+	if (len + 1 <= sizeof(buf)) {
+		TEST_CHECK(payload_encode_json(buf, len + 1, report) == (int)len, "%s: exact buffer rejected", name);
+		TEST_CHECK(payload_encode_json(buf, len, report) == -1, "%s: short buffer accepted", name);
+	}
+
+	cJSON_free(expected);
+}
+
+static void check_summary(const char *name, const char *mac, uint32_t sn, const payload_summary_t *summary)
+{
+	char buf[PAYLOAD_SUMMARY_JSON_LEN];
+	char *expected = cjson_summary(mac, sn, summary);
+
+	TEST_CHECK(strlen(expected) < sizeof(buf), "%s: %zu bytes exceed PAYLOAD_SUMMARY_JSON_LEN", name, strlen(expected));
+	int n = payload_encode_summary_json(buf, sizeof(buf), mac, sn, summary);
+	TEST_CHECK(n == (int)strlen(expected) && strcmp(buf, expected) == 0, "%s:\n  cJSON  %s\n  stream %s", name, expected, buf);
+
+	cJSON_free(expected);
+}
+
+int main(void)
+{
+	static const uint8_t mac_addr[6] = {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01};
+	payload_sample_t samples[CONFIG_REPORT_BATCH_MAX];
+	payload_report_t report = {.mac = MAC, .mac_addr = mac_addr, .sn = 0x0A1B2C3D, .samples = samples};
+
+	//单条，时间未同步时省略ts
+	samples[0] = (payload_sample_t){.mono_ms = 3282, .temperature = 2512, .humiture = 4987, .count = 1};
+	report.count = 1;
+	check_report("single", &report);
+
+	samples[0].time_ms = 1760000000000LL;
+	check_report("single with ts", &report);
+
+	//负温度，包括不到1度和传感器量程下限
+	static const int16_t negatives[] = {-1, -5, -99, -100, -4500, INT16_MIN};
+	for (size_t i = 0; i < sizeof(negatives) / sizeof(negatives[0]); i++) {
+		samples[0].temperature = negatives[i];
+		check_report("negative", &report);
+	}
+
+	//批量，混合有无ts、正负温度
+	for (int i = 0; i < CONFIG_REPORT_BATCH_MAX; i++) {
+		samples[i] = (payload_sample_t){
+			.mono_ms = 10000 * (i + 1),
+			.time_ms = i % 3 ? 1760000000000LL + 10000 * i : 0,
+			.temperature = 150 - 37 * i,
+			.humiture = 9000 + 61 * i,
+			.count = i + 1,
+		};
+	}
+	for (report.count = 2; report.count <= CONFIG_REPORT_BATCH_MAX; report.count++) {
+		check_report("batch", &report);
+	}
+
+	//所有字段取最长值，检查PAYLOAD_JSON_LEN足够
+	for (int i = 0; i < CONFIG_REPORT_BATCH_MAX; i++) {
+		samples[i] = (payload_sample_t){
+			.mono_ms = UINT32_MAX,
+			.time_ms = TS_MAX,
+			.temperature = INT16_MIN,
+			.humiture = UINT16_MAX,
+			.count = UINT16_MAX,
+		};
+	}
+	report.sn = UINT32_MAX;
+	report.count = 1;
+	check_report("max length single", &report);
+	report.count = CONFIG_REPORT_BATCH_MAX;
+	check_report("max length batch", &report);
+
+	//字符串转义
+	report.mac = "a\"b\\c\n\t\x01\x1f/\xc3\xa9";
+	report.count = 1;
+	check_report("escaped", &report);
+
+	payload_summary_t summary = {
+		.mono_ms = 300000,
+		.time_ms = 1760000000000LL,
+		.window_ms = 300000,
+		.count = 300,
+		.temperature = {.min = -105, .max = 2531, .mean = -3, .stddev = 9},
+		.humiture = {.min = 4950, .max = 5020, .mean = 4987, .stddev = 17},
+	};
+	check_summary("summary", MAC, 0x0A1B2C3D, &summary);
+	summary = (payload_summary_t){
+		.mono_ms = UINT32_MAX,
+		.time_ms = TS_MAX,
+		.window_ms = UINT32_MAX,
+		.count = UINT32_MAX,
+		.temperature = {.min = INT16_MIN, .max = INT16_MIN, .mean = INT16_MIN, .stddev = UINT16_MAX},
+		.humiture = {.min = INT16_MIN, .max = INT16_MIN, .mean = INT16_MIN, .stddev = UINT16_MAX},
+	};
+	check_summary("max length summary", MAC, UINT32_MAX, &summary);
+
+	return TEST_RESULT("payload_json");
+}
@@ -0,0 +1,19 @@
+/* 原始值换算：对全部65536个原始值，整数换算的结果必须等于浮点公式四舍五入的结果 */
+#include <math.h>
+#include <stdint.h>
+#include <sht3x.h>
+
+#include "test.h"
+
+int main(void)
+{
+	for (uint32_t raw = 0; raw <= UINT16_MAX; raw++) {
+		long t = lround(100.0 * (-45.0 + 175.0 * raw / 65535.0));
+		long h = lround(100.0 * (100.0 * raw / 65535.0));
+
+		TEST_CHECK(sht3x_raw_to_centi_celsius(raw) == t, "raw %u: %d != %ld", raw, sht3x_raw_to_centi_celsius(raw), t);
+		TEST_CHECK(sht3x_raw_to_centi_percent(raw) == h, "raw %u: %u != %ld", raw, sht3x_raw_to_centi_percent(raw), h);
+	}
+
+	return TEST_RESULT("sht3x_convert");
+}
@@ -0,0 +1,56 @@
+#include <stdint.h>
+
+#include "backoff.h"
+
+/* 描述：初始化退避状态
+ * 参数b：退避状态
+ * 参数base_ms：第一次重试的等待时间上限
+ * 参数cap_ms：等待时间上限的最大值
+ * 参数mac：设备MAC地址，作为抖动的随机数种子 */
+void backoff_init(backoff_t *b, uint32_t base_ms, uint32_t cap_ms, const uint8_t mac[6])
+{
+	//FNV-1a散列MAC地址，相邻地址的种子也相差很大
+	uint32_t seed = 2166136261u;
+	for (int i = 0; i < 6; i++) {
+		seed = (seed ^ mac[i]) * 16777619u;
+	}
+
+	b->base_ms = base_ms;
+	b->cap_ms = cap_ms < base_ms ? base_ms : cap_ms;
+	b->failures = 0;
+	//xorshift的状态不能为0
+	b->rng = seed ? seed : 1;
+}
+
+//xorshift32伪随机数
+static uint32_t backoff_random(backoff_t *b)
+{
+	uint32_t x = b->rng;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	b->rng = x;
+	return x;
+}
+
+/* 描述：记录一次失败并计算下一次尝试前的等待时间
+ * 参数b：退避状态
+ * 返回值：等待时间(ms) */
+uint32_t backoff_next(backoff_t *b)
+{
+	uint32_t limit = b->cap_ms;
+	if (b->failures < 32 && b->base_ms <= (b->cap_ms >> b->failures)) {
+		limit = b->base_ms << b->failures;
+	}
+	b->failures++;
+
+	//保留一半作为最小间隔，避免抖动到0时退化为立即重试
+	uint32_t half = limit / 2;
+	return half + backoff_random(b) % (limit - half + 1);
+}
+
+/* 描述：连接成功后清零失败次数，随机数状态保留 */
+void backoff_reset(backoff_t *b)
+{
+	b->failures = 0;
+}
@@ -0,0 +1,18 @@
+#ifndef __BACKOFF_H__
+#define __BACKOFF_H__
+#include <stdint.h>
+
+/* 重连退避，不依赖SDK，压测工具也使用同一实现
+ * 第n次连续失败后的等待时间上限为min(cap, base*2^n)，实际等待时间在[上限/2, 上限]之间均匀抖动，
+ * 随机数种子取自MAC地址，同一批设备在同一时刻断线后的重连时间会自然分散 */
+typedef struct {
+	uint32_t base_ms;
+	uint32_t cap_ms;
+	uint32_t failures;          //连续失败次数，成功后清零
+	uint32_t rng;
+} backoff_t;
+
+void backoff_init(backoff_t *b, uint32_t base_ms, uint32_t cap_ms, const uint8_t mac[6]);
+uint32_t backoff_next(backoff_t *b);
+void backoff_reset(backoff_t *b);
+#endif
@@ -0,0 +1,312 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <driver/soc.h>
+#include <esp_system.h>
+#include <sht3x.h>
+
+#include "bench.h"
+#include "mqtt.h"
+#include "payload.h"
+#include "sample_queue.h"
+#include "time.h"
+
+/* 微基准测试
+ * 覆盖每条采样都要经过的代码：CRC8校验、原始值换算、上报报文编码，以及对桩发布函数的完整mqtt_publish_data()。
+ * 每个用例是一个不内联的函数，perf可以按函数归因。计时使用CPU周期计数器，主机上按1GHz的名义主频计为纳秒；
+ * 堆分配次数在基准测试镜像中由本文件的malloc包装函数统计，主机上由模拟层统计。
+ * 每个用例输出一行 key=value，便于脚本比较两次运行的结果 */
+
+extern uint32_t sensor_sn[];
+extern size_t sensor_count;
+extern uint8_t mac_addr[6];
+extern char mac_string[20];
+
+//用例之间让出CPU，避免基准测试镜像触发任务看门狗
+#define BENCH_YIELD_MS 10
+//输入数据的个数，轮流使用，避免每次计算相同的数据
+#define BENCH_INPUTS 64
+//采样中的UTC时间，2025-10-09
+#define BENCH_EPOCH_MS 1760000000000LL
+
+typedef struct {
+	const char *name;
+	uint32_t iterations;    //默认迭代次数，按ESP8266上每个用例不超过约1秒选取
+	void (*run)(uint32_t iterations);
+} bench_case_t;
+
+static uint8_t words[BENCH_INPUTS][2];
+static uint8_t crc8_table[256];
+static payload_sample_t samples[CONFIG_REPORT_BATCH_MAX];
+static volatile uint32_t sink;          //保存计算结果，防止被编译器优化掉
+static uint32_t published_bytes;
+static int published_msg_id;
+
+//发布桩函数，只统计字节数，不经过网络
+static int bench_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain)
+{
+	published_bytes += len;
+	return ++published_msg_id;
+}
+
+//查表计算CRC8，作为逐位计算的对照
+static uint8_t crc8_table_word(const uint8_t *word)
+{
+	uint8_t crc = crc8_table[0xFF ^ word[0]];
+	return crc8_table[crc ^ word[1]];
+}
+
+static void bench_setup(void)
+{
+	for (int i = 0; i < 256; i++) {
+		uint8_t crc = i;
+		for (int b = 0; b < 8; b++) {
+			crc = crc & 0x80 ? (crc << 1) ^ 0x31 : crc << 1;
+		}
+		crc8_table[i] = crc;
+	}
+
+	for (int i = 0; i < BENCH_INPUTS; i++) {
+		words[i][0] = esp_random();
+		words[i][1] = esp_random();
+		if (crc8_table_word(words[i]) != sht3x_crc8(words[i])) {
+			printf("bench: CRC8 table mismatch\n");
+		}
+	}
+
+	//单调时间取当前时间，发布时统计的延迟接近0
+	int64_t now = time_mono_ms();
+	for (int i = 0; i < CONFIG_REPORT_BATCH_MAX; i++) {
+		samples[i] = (payload_sample_t){
+			.mono_ms = now,
+			.time_ms = BENCH_EPOCH_MS + 10000 * i,
+			.temperature = 2512 - 7 * i,
+			.humiture = 4987 + 13 * i,
+			.count = 10,
+		};
+	}
+
+	//不启动传感器和网络，使用一个虚构的传感器，报文内容与实际运行时相同
+	if (mac_string[0] == '\0') {
+		esp_efuse_mac_get_default(mac_addr);
+		sprintf(mac_string, "%02X:%02X:%02X:%02X:%02X:%02X", mac_addr[0], mac_addr[1], mac_addr[2], mac_addr[3], mac_addr[4], mac_addr[5]);
+	}
+	sensor_sn[0] = 0x0A1B2C3D;
+	sensor_count = 1;
+	mqtt_set_publish_fn(bench_publish);
+}
+
+static void __attribute__((noinline)) bench_crc8_bitwise(uint32_t iterations)
+{
+	uint32_t acc = 0;
+	for (uint32_t i = 0; i < iterations; i++) {
+		acc += sht3x_crc8(words[i % BENCH_INPUTS]);
+	}
+	sink = acc;
+}
+
+static void __attribute__((noinline)) bench_crc8_table(uint32_t iterations)
+{
+	uint32_t acc = 0;
+	for (uint32_t i = 0; i < iterations; i++) {
+		acc += crc8_table_word(words[i % BENCH_INPUTS]);
+	}
+	sink = acc;
+}
+
+static void __attribute__((noinline)) bench_raw_to_centi(uint32_t iterations)
+{
+	uint32_t acc = 0;
+	for (uint32_t i = 0; i < iterations; i++) {
+		const uint8_t *w = words[i % BENCH_INPUTS];
+		uint16_t raw = w[0] << 8 | w[1];
+		acc += sht3x_raw_to_centi_celsius(raw) + sht3x_raw_to_centi_percent(raw);
+	}
+	sink = acc;
+}
+
+static void bench_encode_json(uint32_t iterations, size_t count)
+{
+	static char out[PAYLOAD_JSON_LEN(CONFIG_REPORT_BATCH_MAX)];
+	payload_report_t report = {
+		.mac = mac_string,
+		.mac_addr = mac_addr,
+		.sn = sensor_sn[0],
+		.samples = samples,
+		.count = count,
+	};
+
+	uint32_t acc = 0;
+	for (uint32_t i = 0; i < iterations; i++) {
+		acc += payload_encode_json(out, sizeof(out), &report);
+	}
+	sink = acc;
+}
+
+static void bench_encode_binary(uint32_t iterations, size_t count)
+{
+	static uint8_t out[PAYLOAD_BINARY_LEN(CONFIG_REPORT_BATCH_MAX)];
+	payload_report_t report = {
+		.mac = mac_string,
+		.mac_addr = mac_addr,
+		.sn = sensor_sn[0],
+		.samples = samples,
+		.count = count,
+	};
+
+	uint32_t acc = 0;
+	for (uint32_t i = 0; i < iterations; i++) {
+		acc += payload_encode_binary(out, sizeof(out), &report);
+	}
+	sink = acc;
+}
+
+static void __attribute__((noinline)) bench_encode_json_1(uint32_t iterations)
+{
+	bench_encode_json(iterations, 1);
+}
+
+static void __attribute__((noinline)) bench_encode_json_batch(uint32_t iterations)
+{
+	bench_encode_json(iterations, CONFIG_REPORT_BATCH_MAX);
+}
+
+static void __attribute__((noinline)) bench_encode_binary_1(uint32_t iterations)
+{
+	bench_encode_binary(iterations, 1);
+}
+
+static void __attribute__((noinline)) bench_encode_binary_batch(uint32_t iterations)
+{
+	bench_encode_binary(iterations, CONFIG_REPORT_BATCH_MAX);
+}
+
+static void __attribute__((noinline)) bench_encode_summary(uint32_t iterations)
+{
+	static char out[PAYLOAD_SUMMARY_JSON_LEN];
+	payload_summary_t summary = {
+		.mono_ms = 300000,
+		.time_ms = BENCH_EPOCH_MS,
+		.window_ms = 300000,
+		.count = 300,
+		.temperature = {.min = 2490, .max = 2531, .mean = 2512, .stddev = 9},
+		.humiture = {.min = 4950, .max = 5020, .mean = 4987, .stddev = 17},
+	};
+
+	uint32_t acc = 0;
+	for (uint32_t i = 0; i < iterations; i++) {
+		acc += payload_encode_summary_json(out, sizeof(out), mac_string, sensor_sn[0], &summary);
+	}
+	sink = acc;
+}
+
+//入队count条采样并发布，包括补UTC时间、按传感器分组、编码和延迟统计
+static void bench_publish_data(uint32_t iterations, size_t count)
+{
+	for (uint32_t i = 0; i < iterations; i++) {
+		for (size_t j = 0; j < count; j++) {
+			sample_queue_push(&samples[j]);
+		}
+		mqtt_publish_data();
+	}
+}
+
+static void __attribute__((noinline)) bench_publish_data_1(uint32_t iterations)
+{
+	bench_publish_data(iterations, 1);
+}
+
+static void __attribute__((noinline)) bench_publish_data_batch(uint32_t iterations)
+{
+	bench_publish_data(iterations, CONFIG_REPORT_BATCH_MAX);
+}
+
+static const bench_case_t cases[] = {
+	{"crc8_bitwise",        20000, bench_crc8_bitwise},
+	{"crc8_table",          20000, bench_crc8_table},
+	{"raw_to_centi",        20000, bench_raw_to_centi},
+	{"encode_json_1",        2000, bench_encode_json_1},
+	{"encode_json_batch",     200, bench_encode_json_batch},
+	{"encode_binary_1",      5000, bench_encode_binary_1},
+	{"encode_binary_batch",  2000, bench_encode_binary_batch},
+	{"encode_summary",       2000, bench_encode_summary},
+	{"publish_data_1",       1000, bench_publish_data_1},
+	{"publish_data_batch",    100, bench_publish_data_batch},
+};
+
+/* 描述：运行名称以filter开头的用例，每个用例输出一行结果
+ * 参数filter：用例名称前缀，NULL或"all"表示全部
+ * 参数iterations：迭代次数，为0时使用各用例的默认值
+ * 返回值：运行的用例数 */
+size_t bench_run(const char *filter, uint32_t iterations)
+{
+	size_t ran = 0;
+
+	if (filter != NULL && strcmp(filter, "all") == 0) {
+		filter = NULL;
+	}
+
+	bench_setup();
+	printf("bench: %d cases, batch %d samples\n", (int)(sizeof(cases) / sizeof(cases[0])), CONFIG_REPORT_BATCH_MAX);
+
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		const bench_case_t *c = &cases[i];
+		if (filter != NULL && strncmp(c->name, filter, strlen(filter)) != 0) {
+			continue;
+		}
+
+		uint32_t n = iterations ? iterations : c->iterations;
+		published_bytes = 0;
+		vTaskDelay(BENCH_YIELD_MS / portTICK_PERIOD_MS);
+
+		uint32_t allocs = bench_allocations();
+		uint32_t start = soc_get_ccount();
+		c->run(n);
+		uint32_t cycles = soc_get_ccount() - start;
+		allocs = bench_allocations() - allocs;
+
+		//每次的周期数保留一位小数，周期计数器只有32位，单个用例不能超过一圈
+		uint32_t tenths = ((uint64_t)cycles * 10 + n / 2) / n;
+		printf("bench name=%s iterations=%u cycles_per_op=%u.%u allocs=%u bytes_per_op=%u\n",
+				c->name, n, tenths / 10, tenths % 10, allocs, published_bytes / n);
+		ran++;
+	}
+
+	return ran;
+}
+
+#ifdef CONFIG_BENCH_IMAGE
+/* 基准测试镜像链接时用--wrap包装malloc/calloc/realloc，统计堆分配次数，见component.mk */
+static volatile uint32_t allocations;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+	allocations++;
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+	allocations++;
+	return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	allocations++;
+	return __real_realloc(ptr, size);
+}
+
+/* 描述：获取开机后的堆分配次数 */
+uint32_t bench_allocations(void)
+{
+	return allocations;
+}
+#endif
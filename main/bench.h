@@ -0,0 +1,10 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+#include <stdint.h>
+#include <stddef.h>
+
+/* 每条采样热路径的微基准测试，主机版用-B运行，固件用CONFIG_BENCH_IMAGE编译为基准测试镜像 */
+
+size_t bench_run(const char *filter, uint32_t iterations);
+uint32_t bench_allocations(void);
+#endif
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/event_groups.h>
+#include <esp_system.h>
+#include <esp_log.h>
+
+#include "boot.h"
+
+extern uint32_t sensor_sn[];
+extern char mac_string[20];
+
+/* 开机时间线
+ * 传感器启动、Wi-Fi连接和SNTP同步并行进行，各阶段完成时调用boot_mark()记录开机后的时间(ms)并置位事件组，
+ * 依赖某个阶段的任务用boot_wait()等待，不再用固定延时串行等待。
+ * 阶段可能在不同任务和事件回调中到达，时间戳在临界区内写入 */
+
+static const char *TAG = "main.boot";
+
+static const char *phase_names[BOOT_PHASE_NUM] = {
+	[BOOT_PHASE_SYSTEM] = "system",
+	[BOOT_PHASE_SENSOR] = "sensor",
+	[BOOT_PHASE_NETWORK] = "network",
+	[BOOT_PHASE_MQTT] = "mqtt",
+	[BOOT_PHASE_TIME] = "time",
+	[BOOT_PHASE_FIRST_SAMPLE] = "first_sample",
+	[BOOT_PHASE_FIRST_REPORT] = "first_report",
+};
+
+static EventGroupHandle_t boot_events;
+static uint32_t phase_ms[BOOT_PHASE_NUM];
+static bool phase_reached[BOOT_PHASE_NUM];
+
+/* 描述：创建阶段事件组，必须在启动其他任务之前调用 */
+void boot_init(void)
+{
+	boot_events = xEventGroupCreate();
+}
+
+/* 描述：记录阶段到达的时间并唤醒等待该阶段的任务，重复调用时保留第一次的时间
+ * 参数phase：开机阶段 */
+void boot_mark(boot_phase_t phase)
+{
+	uint32_t now = esp_log_early_timestamp();
+	bool first = false;
+
+	taskENTER_CRITICAL();
+	if (!phase_reached[phase]) {
+		phase_reached[phase] = true;
+		phase_ms[phase] = now;
+		first = true;
+	}
+	taskEXIT_CRITICAL();
+
+	if (first) {
+		ESP_LOGI(TAG, "Boot phase %s reached at %u ms", phase_names[phase], now);
+		xEventGroupSetBits(boot_events, BIT(phase));
+	}
+}
+
+/* 描述：等待某个阶段完成
+ * 参数phase：开机阶段
+ * 参数timeout：最长等待的tick数
+ * 返回值：阶段已完成返回true，超时返回false */
+bool boot_wait(boot_phase_t phase, TickType_t timeout)
+{
+	EventBits_t bits = xEventGroupWaitBits(boot_events, BIT(phase), pdFALSE, pdTRUE, timeout);
+	return (bits & BIT(phase)) != 0;
+}
+
+/* 描述：编码开机时间线报文，尚未到达的阶段为null
+ * 参数buf：输出缓冲区，建议长度BOOT_JSON_LEN
+ * 参数size：缓冲区长度
+ * 返回值：报文长度，缓冲区不足返回-1 */
+int boot_encode_json(char *buf, size_t size)
+{
+	uint32_t ms[BOOT_PHASE_NUM];
+	bool reached[BOOT_PHASE_NUM];
+
+	taskENTER_CRITICAL();
+	for (int i = 0; i < BOOT_PHASE_NUM; i++) {
+		ms[i] = phase_ms[i];
+		reached[i] = phase_reached[i];
+	}
+	taskEXIT_CRITICAL();
+
+	int len = snprintf(buf, size, "{\"type\":\"boot\",\"mac\":\"%s\",\"sn\":%u,\"reset_reason\":%d,\"phases_ms\":{",
+			mac_string, sensor_sn[0], (int)esp_reset_reason());
+	for (int i = 0; i < BOOT_PHASE_NUM && len >= 0 && len < size; i++) {
+		int n = reached[i] ?
+			snprintf(buf + len, size - len, "%s\"%s\":%u", i == 0 ? "" : ",", phase_names[i], ms[i]) :
+			snprintf(buf + len, size - len, "%s\"%s\":null", i == 0 ? "" : ",", phase_names[i]);
+		len = n < 0 ? -1 : len + n;
+	}
+	if (len < 0 || len + 2 >= size) {
+		return -1;
+	}
+
+	buf[len++] = '}';
+	buf[len++] = '}';
+	buf[len] = '\0';
+	return len;
+}
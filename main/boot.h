@@ -0,0 +1,27 @@
+#ifndef __BOOT_H__
+#define __BOOT_H__
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <freertos/FreeRTOS.h>
+
+//开机阶段，每个阶段只记录第一次到达的时间，同时作为阶段之间的依赖条件
+typedef enum {
+	BOOT_PHASE_SYSTEM,          //NVS、网络栈、事件循环和上报模块初始化完成
+	BOOT_PHASE_SENSOR,          //传感器复位、读取序列号并进入周期测量
+	BOOT_PHASE_NETWORK,         //Wi-Fi连接并获取IP
+	BOOT_PHASE_MQTT,            //MQTT连接
+	BOOT_PHASE_TIME,            //SNTP时间同步
+	BOOT_PHASE_FIRST_SAMPLE,    //第一条有效采样
+	BOOT_PHASE_FIRST_REPORT,    //第一次上报成功
+	BOOT_PHASE_NUM,
+} boot_phase_t;
+
+//开机时间线报文的最大长度（含结尾的\0）
+#define BOOT_JSON_LEN 256
+
+void boot_init(void);
+void boot_mark(boot_phase_t phase);
+bool boot_wait(boot_phase_t phase, TickType_t timeout);
+int boot_encode_json(char *buf, size_t size);
+#endif
@@ -0,0 +1,365 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <esp_log.h>
+#include <nvs.h>
+
+#include "command.h"
+
+/* /devices/<mac>主题上的命令分发
+ * 命令消息为扁平的JSON对象，例如{"cmd":"set_period","value":10000,"id":7}，
+ * 在消息缓冲区内按data_len直接解析，不要求以\0结尾，不申请堆内存，不支持嵌套对象和数组。
+ * 命令由注册的命令表描述，分发器统一完成参数类型和范围检查，成功后按需写入NVS，开机时再从NVS恢复 */
+#define COMMAND_NVS_NAMESPACE "settings"
+
+static const char *TAG = "main.command";
+static const command_t *commands;
+static size_t command_count;
+
+//解析后的一条命令，字符串均指向原始消息内部
+typedef struct {
+	const char *cmd;
+	size_t cmd_len;
+	bool has_value;
+	command_arg_type_t value_type;
+	command_arg_t value;
+	bool has_id;
+	int32_t id;
+} command_request_t;
+
+static const char *skip_space(const char *p, const char *end)
+{
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+		p++;
+	}
+	return p;
+}
+
+//解析字符串，不支持转义字符，命令和参数中不会出现
+static const char *parse_string(const char *p, const char *end, const char **s, size_t *len)
+{
+	if (p == end || *p != '"') {
+		return NULL;
+	}
+	const char *start = ++p;
+	while (p < end && *p != '"') {
+		if (*p == '\\' || (unsigned char)*p < 0x20) {
+			return NULL;
+		}
+		p++;
+	}
+	if (p == end) {
+		return NULL;
+	}
+	*s = start;
+	*len = p - start;
+	return p + 1;
+}
+
+//解析32位有符号整数，不接受小数和指数
+static const char *parse_int(const char *p, const char *end, int32_t *out)
+{
+	bool negative = false;
+	int64_t v = 0;
+
+	if (p < end && *p == '-') {
+		negative = true;
+		p++;
+	}
+	if (p == end || *p < '0' || *p > '9') {
+		return NULL;
+	}
+	while (p < end && *p >= '0' && *p <= '9') {
+		v = v * 10 + (*p++ - '0');
+		if (v > (int64_t)INT32_MAX + 1) {
+			return NULL;
+		}
+	}
+	if (p < end && (*p == '.' || *p == 'e' || *p == 'E')) {
+		return NULL;
+	}
+	if (!negative && v > INT32_MAX) {
+		return NULL;
+	}
+	*out = negative ? (int32_t)-v : (int32_t)v;
+	return p;
+}
+
+//跳过true/false/null
+static const char *skip_literal(const char *p, const char *end)
+{
+	static const char *literals[] = {"true", "false", "null"};
+
+	for (int i = 0; i < sizeof(literals) / sizeof(literals[0]); i++) {
+		size_t n = strlen(literals[i]);
+		if (end - p >= n && memcmp(p, literals[i], n) == 0) {
+			return p + n;
+		}
+	}
+	return NULL;
+}
+
+static bool key_equals(const char *key, size_t len, const char *name)
+{
+	return strlen(name) == len && memcmp(key, name, len) == 0;
+}
+
+/* 描述：解析命令消息
+ * 返回值：成功返回true */
+static bool command_parse(const char *data, size_t len, command_request_t *req)
+{
+	const char *p = data;
+	const char *end = data + len;
+
+	memset(req, 0, sizeof(*req));
+
+	p = skip_space(p, end);
+	if (p == end || *p++ != '{') {
+		return false;
+	}
+
+	p = skip_space(p, end);
+	if (p < end && *p == '}') {
+		p++;
+	} else {
+		while (true) {
+			const char *key;
+			size_t key_len;
+
+			p = parse_string(skip_space(p, end), end, &key, &key_len);
+			if (p == NULL) {
+				return false;
+			}
+			p = skip_space(p, end);
+			if (p == end || *p++ != ':') {
+				return false;
+			}
+			p = skip_space(p, end);
+			if (p == end) {
+				return false;
+			}
+
+			if (*p == '"') {
+				const char *s;
+				size_t s_len;
+				p = parse_string(p, end, &s, &s_len);
+				if (p == NULL) {
+					return false;
+				}
+				if (key_equals(key, key_len, "cmd")) {
+					req->cmd = s;
+					req->cmd_len = s_len;
+				} else if (key_equals(key, key_len, "value")) {
+					req->has_value = true;
+					req->value_type = COMMAND_ARG_STRING;
+					req->value.string = s;
+					req->value.string_len = s_len;
+				}
+			} else if (*p == '-' || (*p >= '0' && *p <= '9')) {
+				int32_t v;
+				p = parse_int(p, end, &v);
+				if (p == NULL) {
+					return false;
+				}
+				if (key_equals(key, key_len, "value")) {
+					req->has_value = true;
+					req->value_type = COMMAND_ARG_INT;
+					req->value.number = v;
+				} else if (key_equals(key, key_len, "id")) {
+					req->has_id = true;
+					req->id = v;
+				}
+			} else {
+				p = skip_literal(p, end);
+				if (p == NULL) {
+					return false;
+				}
+			}
+
+			p = skip_space(p, end);
+			if (p == end) {
+				return false;
+			}
+			if (*p == '}') {
+				p++;
+				break;
+			}
+			if (*p++ != ',') {
+				return false;
+			}
+		}
+	}
+
+	//部分客户端会把结尾的\0一起发送
+	while (p < end && (*p == '\0' || *p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+		p++;
+	}
+	return p == end;
+}
+
+static const command_t *command_find(const char *name, size_t len)
+{
+	for (size_t i = 0; i < command_count; i++) {
+		if (key_equals(name, len, commands[i].name)) {
+			return &commands[i];
+		}
+	}
+	return NULL;
+}
+
+/* 描述：检查参数并执行命令
+ * 返回值：成功返回NULL，失败返回错误描述 */
+static const char *command_execute(const command_t *command, command_arg_type_t type, const command_arg_t *arg)
+{
+	if (type != command->type) {
+		return "invalid value";
+	}
+
+	if (type == COMMAND_ARG_INT && (arg->number < command->min || arg->number > command->max)) {
+		return "out of range";
+	}
+
+	if (type == COMMAND_ARG_STRING && arg->string_len >= COMMAND_STRING_MAX) {
+		return "value too long";
+	}
+
+	if (command->apply(arg) != ESP_OK) {
+		return "rejected";
+	}
+
+	return NULL;
+}
+
+//把参数写入NVS，开机时由command_restore()恢复
+static esp_err_t command_persist(const command_t *command, const command_arg_t *arg)
+{
+	nvs_handle handle;
+	esp_err_t ret = nvs_open(COMMAND_NVS_NAMESPACE, NVS_READWRITE, &handle);
+	if (ret != ESP_OK) {
+		return ret;
+	}
+
+	if (command->type == COMMAND_ARG_INT) {
+		ret = nvs_set_i32(handle, command->nvs_key, arg->number);
+	} else {
+		char value[COMMAND_STRING_MAX];
+		memcpy(value, arg->string, arg->string_len);
+		value[arg->string_len] = '\0';
+		ret = nvs_set_str(handle, command->nvs_key, value);
+	}
+
+	if (ret == ESP_OK) {
+		ret = nvs_commit(handle);
+	}
+	nvs_close(handle);
+	return ret;
+}
+
+/* 描述：注册命令表，命令表需要一直有效
+ * 参数table：命令表
+ * 参数count：命令数量 */
+void command_register(const command_t *table, size_t count)
+{
+	commands = table;
+	command_count = count;
+}
+
+/* 描述：从NVS恢复已持久化的命令参数，在注册命令表之后、开始上报之前调用 */
+void command_restore(void)
+{
+	nvs_handle handle;
+	if (nvs_open(COMMAND_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+		return;
+	}
+
+	for (size_t i = 0; i < command_count; i++) {
+		const command_t *command = &commands[i];
+		command_arg_t arg = {0};
+		char value[COMMAND_STRING_MAX];
+		esp_err_t ret;
+
+		if (command->nvs_key == NULL) {
+			continue;
+		}
+
+		if (command->type == COMMAND_ARG_INT) {
+			ret = nvs_get_i32(handle, command->nvs_key, &arg.number);
+		} else {
+			size_t len = sizeof(value);
+			ret = nvs_get_str(handle, command->nvs_key, value, &len);
+			arg.string = value;
+			arg.string_len = strnlen(value, sizeof(value));
+		}
+		if (ret != ESP_OK) {
+			continue;
+		}
+
+		const char *error = command_execute(command, command->type, &arg);
+		if (error != NULL) {
+			ESP_LOGE(TAG, "Fail to restore %s: %s", command->name, error);
+		} else {
+			ESP_LOGI(TAG, "Restored %s", command->name);
+		}
+	}
+
+	nvs_close(handle);
+}
+
+/* 描述：解析并执行一条命令消息，生成应答
+ * 参数data：消息内容，不要求以\0结尾
+ * 参数len：消息长度
+ * 参数reply：应答缓冲区，建议长度COMMAND_REPLY_LEN
+ * 参数reply_size：应答缓冲区长度
+ * 返回值：应答长度，缓冲区不足返回-1 */
+int command_dispatch(const char *data, size_t len, char *reply, size_t reply_size)
+{
+	command_request_t req = {0};
+	const command_t *command = NULL;
+	const char *error = NULL;
+
+	if (len > COMMAND_DATA_MAX) {
+		error = "message too long";
+	} else if (!command_parse(data, len, &req)) {
+		error = "invalid json";
+	} else if (req.cmd == NULL) {
+		error = "missing cmd";
+	} else if ((command = command_find(req.cmd, req.cmd_len)) == NULL) {
+		error = "unknown command";
+	} else if (!req.has_value) {
+		error = "missing value";
+	} else {
+		error = command_execute(command, req.value_type, &req.value);
+		if (error == NULL && command->nvs_key != NULL) {
+			esp_err_t ret = command_persist(command, &req.value);
+			if (ret != ESP_OK) {
+				ESP_LOGE(TAG, "Fail to persist %s: %s", command->name, esp_err_to_name(ret));
+				error = "applied but not persisted";
+			}
+		}
+	}
+
+	if (error != NULL) {
+		ESP_LOGE(TAG, "Command %.*s failed: %s", command ? (int)req.cmd_len : 0, command ? req.cmd : "", error);
+	} else {
+		ESP_LOGW(TAG, "Command %s applied", command->name);
+	}
+
+	//应答中的命令名取自命令表，不回显消息中的任意内容
+	int n = snprintf(reply, reply_size, "{\"cmd\":\"%s\",", command ? command->name : "");
+	if (n >= 0 && n < reply_size && req.has_id) {
+		n += snprintf(reply + n, reply_size - n, "\"id\":%d,", req.id);
+	}
+	if (n >= 0 && n < reply_size) {
+		if (error == NULL) {
+			n += snprintf(reply + n, reply_size - n, "\"result\":\"ok\"}");
+		} else {
+			n += snprintf(reply + n, reply_size - n, "\"result\":\"error\",\"error\":\"%s\"}", error);
+		}
+	}
+
+	if (n < 0 || n >= reply_size) {
+		return -1;
+	}
+	return n;
+}
@@ -0,0 +1,40 @@
+#ifndef __COMMAND_H__
+#define __COMMAND_H__
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_err.h>
+
+//单条命令消息的最大长度，超过时直接拒绝
+#define COMMAND_DATA_MAX 256
+//字符串参数的最大长度（含结尾的\0）
+#define COMMAND_STRING_MAX 32
+//应答消息的最大长度（含结尾的\0）
+#define COMMAND_REPLY_LEN 128
+
+//命令参数类型
+typedef enum {
+	COMMAND_ARG_INT = 0,
+	COMMAND_ARG_STRING,
+} command_arg_type_t;
+
+//命令参数，字符串指向原始消息内部，不以\0结尾
+typedef struct {
+	int32_t number;
+	const char *string;
+	size_t string_len;
+} command_arg_t;
+
+//命令表中的一项
+typedef struct {
+	const char *name;
+	command_arg_type_t type;
+	int32_t min;                //整数参数的取值范围
+	int32_t max;
+	const char *nvs_key;        //非NULL时参数持久化到NVS，最长15个字符
+	esp_err_t (*apply)(const command_arg_t *arg);
+} command_t;
+
+void command_register(const command_t *table, size_t count);
+void command_restore(void);
+int command_dispatch(const char *data, size_t len, char *reply, size_t reply_size);
+#endif
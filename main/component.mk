@@ -3,3 +3,8 @@
 #
 # (Uses default behaviour of compiling all source files in directory, adding 'include' to include path.)
 
+
+# 基准测试镜像统计堆分配次数，包装函数在bench.c中
+ifdef CONFIG_BENCH_IMAGE
+COMPONENT_ADD_LDFLAGS += -Wl,--wrap=malloc -Wl,--wrap=calloc -Wl,--wrap=realloc
+endif
@@ -0,0 +1,308 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_wifi.h>
+#include <protocol_examples_common.h>
+
+#include "conn.h"
+#include "backoff.h"
+#include "mqtt.h"
+
+/* 连接状态机
+ * Wi-Fi、IP和MQTT三层连接的建立和重试都在这里决定，事件回调只通过conn_notify()投递事件，
+ * 状态只在连接任务中修改。断开后不立即重连，而是按退避时间等待：每次连续失败等待时间翻倍，
+ * 抖动种子取自MAC地址，热点或服务器重启时整批设备的重连分散在一段时间内，而不是同时涌入。
+ * 每次尝试都有超时，事件丢失时也能回到重试流程。
+ * 统计数据还会被上报任务读取，在临界区内读写 */
+
+static const char *TAG = "main.conn";
+
+#define CONN_EVENT_QUEUE_LEN 8
+
+typedef struct {
+	backoff_t backoff;
+	int64_t down_since_ms;      //断开的时间，已连接或从未连接过时为-1
+	conn_stats_t stats;
+} conn_link_state_t;
+
+static const char *state_names[CONN_STATE_NUM] = {
+	[CONN_STATE_WIFI_DOWN] = "wifi_down",
+	[CONN_STATE_WIFI_CONNECTING] = "wifi_connecting",
+	[CONN_STATE_IP_WAIT] = "ip_wait",
+	[CONN_STATE_MQTT_DOWN] = "mqtt_down",
+	[CONN_STATE_MQTT_CONNECTING] = "mqtt_connecting",
+	[CONN_STATE_ONLINE] = "online",
+};
+
+static const char *link_names[CONN_LINK_NUM] = {
+	[CONN_LINK_WIFI] = "Wi-Fi",
+	[CONN_LINK_MQTT] = "MQTT",
+};
+
+static QueueHandle_t events;
+static conn_state_t state;
+static int64_t deadline_ms;     //退避状态下为下一次尝试的时间，连接中为超时时间，在线时无效
+static conn_link_state_t links[CONN_LINK_NUM];
+
+static int64_t conn_now_ms(void)
+{
+	return esp_timer_get_time() / 1000;
+}
+
+static void conn_set_state(conn_state_t next, int64_t deadline)
+{
+	ESP_LOGI(TAG, "State %s -> %s", state_names[state], state_names[next]);
+	state = next;
+	deadline_ms = deadline;
+}
+
+//开始一次连接尝试
+static void conn_link_attempt(conn_link_t id)
+{
+	taskENTER_CRITICAL();
+	links[id].stats.attempts++;
+	taskEXIT_CRITICAL();
+}
+
+//连接尝试失败或超时
+static void conn_link_failed(conn_link_t id)
+{
+	taskENTER_CRITICAL();
+	links[id].stats.failures++;
+	taskEXIT_CRITICAL();
+}
+
+//连接建立，结束正在统计的断开时长
+static void conn_link_up(conn_link_t id, int64_t now)
+{
+	conn_link_state_t *link = &links[id];
+
+	backoff_reset(&link->backoff);
+
+	taskENTER_CRITICAL();
+	if (link->down_since_ms >= 0) {
+		uint32_t ms = now - link->down_since_ms;
+		link->stats.outage_ms += ms;
+		if (ms > link->stats.outage_max_ms) {
+			link->stats.outage_max_ms = ms;
+		}
+		link->down_since_ms = -1;
+	}
+	link->stats.up = true;
+	taskEXIT_CRITICAL();
+}
+
+//已建立的连接断开，开始统计断开时长
+static void conn_link_lost(conn_link_t id, int64_t now)
+{
+	conn_link_state_t *link = &links[id];
+
+	taskENTER_CRITICAL();
+	link->stats.outages++;
+	link->stats.up = false;
+	link->down_since_ms = now;
+	taskEXIT_CRITICAL();
+
+	ESP_LOGW(TAG, "%s connection lost, outage %u", link_names[id], link->stats.outages);
+}
+
+//按该层的退避时间等待下一次尝试
+static void conn_backoff(conn_link_t id, conn_state_t next, int64_t now)
+{
+	conn_link_state_t *link = &links[id];
+	uint32_t delay = backoff_next(&link->backoff);
+
+	taskENTER_CRITICAL();
+	link->stats.backoff_ms = delay;
+	taskEXIT_CRITICAL();
+
+	ESP_LOGW(TAG, "%s retry %u in %u ms", link_names[id], link->backoff.failures, delay);
+	conn_set_state(next, now + delay);
+}
+
+static void conn_wifi_attempt(int64_t now)
+{
+	conn_link_attempt(CONN_LINK_WIFI);
+	conn_set_state(CONN_STATE_WIFI_CONNECTING, now + CONFIG_CONN_ATTEMPT_TIMEOUT_MS);
+
+	esp_err_t ret = example_reconnect();
+	if (ret != ESP_OK) {
+		ESP_LOGE(TAG, "Fail to reconnect Wi-Fi: %X", ret);
+		conn_link_failed(CONN_LINK_WIFI);
+		conn_backoff(CONN_LINK_WIFI, CONN_STATE_WIFI_DOWN, now);
+	}
+}
+
+static void conn_mqtt_attempt(int64_t now)
+{
+	conn_link_attempt(CONN_LINK_MQTT);
+	conn_set_state(CONN_STATE_MQTT_CONNECTING, now + CONFIG_CONN_ATTEMPT_TIMEOUT_MS);
+	mqtt_app_start();
+}
+
+static void conn_handle_event(conn_event_t event, int64_t now)
+{
+	switch (event) {
+		case CONN_EVENT_WIFI_UP:
+			if (state == CONN_STATE_WIFI_CONNECTING) {
+				conn_set_state(CONN_STATE_IP_WAIT, deadline_ms);
+			}
+			break;
+
+		case CONN_EVENT_WIFI_DOWN:
+			//退避期间的重复事件，例如尝试超时后主动断开
+			if (state == CONN_STATE_WIFI_DOWN) {
+				break;
+			}
+			if (state >= CONN_STATE_MQTT_CONNECTING) {
+				mqtt_app_stop();
+			}
+			if (state == CONN_STATE_ONLINE) {
+				conn_link_lost(CONN_LINK_MQTT, now);
+			}
+			if (state >= CONN_STATE_MQTT_DOWN) {
+				conn_link_lost(CONN_LINK_WIFI, now);
+			} else {
+				conn_link_failed(CONN_LINK_WIFI);
+			}
+			conn_backoff(CONN_LINK_WIFI, CONN_STATE_WIFI_DOWN, now);
+			break;
+
+		case CONN_EVENT_IP_UP:
+			//地址续租等重复事件
+			if (state > CONN_STATE_IP_WAIT) {
+				break;
+			}
+			//Wi-Fi的重连已经错开，MQTT在获取IP后直接连接，只有服务器拒绝时才退避
+			conn_link_up(CONN_LINK_WIFI, now);
+			conn_mqtt_attempt(now);
+			break;
+
+		case CONN_EVENT_MQTT_UP:
+			if (state != CONN_STATE_MQTT_CONNECTING) {
+				break;
+			}
+			conn_link_up(CONN_LINK_MQTT, now);
+			conn_set_state(CONN_STATE_ONLINE, 0);
+			break;
+
+		case CONN_EVENT_MQTT_DOWN:
+			if (state == CONN_STATE_ONLINE) {
+				conn_link_lost(CONN_LINK_MQTT, now);
+			} else if (state == CONN_STATE_MQTT_CONNECTING) {
+				conn_link_failed(CONN_LINK_MQTT);
+			} else {
+				//停止客户端时产生的事件
+				break;
+			}
+			//停止客户端自带的固定间隔重连，下一次尝试由退避决定
+			mqtt_app_stop();
+			conn_backoff(CONN_LINK_MQTT, CONN_STATE_MQTT_DOWN, now);
+			break;
+	}
+}
+
+static void conn_handle_deadline(int64_t now)
+{
+	switch (state) {
+		case CONN_STATE_WIFI_DOWN:
+			conn_wifi_attempt(now);
+			break;
+
+		case CONN_STATE_WIFI_CONNECTING:
+		case CONN_STATE_IP_WAIT:
+			ESP_LOGW(TAG, "Wi-Fi attempt timed out in %s", state_names[state]);
+			conn_link_failed(CONN_LINK_WIFI);
+			esp_wifi_disconnect();
+			conn_backoff(CONN_LINK_WIFI, CONN_STATE_WIFI_DOWN, now);
+			break;
+
+		case CONN_STATE_MQTT_DOWN:
+			conn_mqtt_attempt(now);
+			break;
+
+		case CONN_STATE_MQTT_CONNECTING:
+			ESP_LOGW(TAG, "MQTT attempt timed out");
+			conn_link_failed(CONN_LINK_MQTT);
+			mqtt_app_stop();
+			conn_backoff(CONN_LINK_MQTT, CONN_STATE_MQTT_DOWN, now);
+			break;
+
+		default:
+			break;
+	}
+}
+
+static void conn_task(void *arg)
+{
+	conn_event_t event;
+
+	while (true) {
+		//在线时只等待事件，其他状态最多等到退避结束或尝试超时
+		TickType_t wait = portMAX_DELAY;
+		if (state != CONN_STATE_ONLINE) {
+			int64_t left = deadline_ms - conn_now_ms();
+			wait = left > 0 ? left / portTICK_PERIOD_MS + 1 : 0;
+		}
+
+		if (xQueueReceive(events, &event, wait) == pdTRUE) {
+			conn_handle_event(event, conn_now_ms());
+		} else if (state != CONN_STATE_ONLINE && conn_now_ms() >= deadline_ms) {
+			conn_handle_deadline(conn_now_ms());
+		}
+	}
+}
+
+/* 描述：初始化状态机并接管Wi-Fi重连，必须在example_connect()之前调用，开机时的第一次连接仍由它发起
+ * 参数mac：设备MAC地址，作为退避抖动的随机数种子 */
+void conn_init(const uint8_t mac[6])
+{
+	for (int i = 0; i < CONN_LINK_NUM; i++) {
+		backoff_init(&links[i].backoff, CONFIG_CONN_BACKOFF_BASE_MS, CONFIG_CONN_BACKOFF_CAP_MS, mac);
+		links[i].down_since_ms = -1;
+	}
+
+	events = xQueueCreate(CONN_EVENT_QUEUE_LEN, sizeof(conn_event_t));
+	//example_connect()发起的第一次连接也计入尝试次数
+	links[CONN_LINK_WIFI].stats.attempts = 1;
+	state = CONN_STATE_WIFI_CONNECTING;
+	deadline_ms = conn_now_ms() + CONFIG_CONN_ATTEMPT_TIMEOUT_MS;
+
+	example_set_manual_reconnect(true);
+	xTaskCreate(conn_task, "conn_task", 2048, NULL, 5, NULL);
+}
+
+/* 描述：通知状态机一个连接事件，在事件循环和MQTT任务中调用，不阻塞
+ * 参数event：连接事件 */
+void conn_notify(conn_event_t event)
+{
+	//队列满时丢弃，状态机靠尝试超时恢复
+	if (xQueueSend(events, &event, 0) != pdTRUE) {
+		ESP_LOGE(TAG, "Event queue full, drop event %d", event);
+	}
+}
+
+/* 描述：获取某一层连接的统计，断开时长包括正在进行的这次
+ * 参数link：连接层
+ * 参数out：输出的统计数据 */
+void conn_get_stats(conn_link_t link, conn_stats_t *out)
+{
+	int64_t now = conn_now_ms();
+
+	taskENTER_CRITICAL();
+	*out = links[link].stats;
+	int64_t since = links[link].down_since_ms;
+	taskEXIT_CRITICAL();
+
+	if (since >= 0) {
+		uint32_t ms = now - since;
+		out->outage_ms += ms;
+		if (ms > out->outage_max_ms) {
+			out->outage_max_ms = ms;
+		}
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef __CONN_H__
+#define __CONN_H__
+#include <stdint.h>
+#include <stdbool.h>
+
+//连接状态，按顺序逐层建立，下层断开时上层一起回退
+typedef enum {
+	CONN_STATE_WIFI_DOWN,           //等待退避结束后重连Wi-Fi
+	CONN_STATE_WIFI_CONNECTING,     //扫描和关联中
+	CONN_STATE_IP_WAIT,             //已关联，等待DHCP或静态地址生效
+	CONN_STATE_MQTT_DOWN,           //网络可用，等待退避结束后连接MQTT服务器
+	CONN_STATE_MQTT_CONNECTING,
+	CONN_STATE_ONLINE,
+	CONN_STATE_NUM,
+} conn_state_t;
+
+//各事件回调通知状态机的事件
+typedef enum {
+	CONN_EVENT_WIFI_UP,             //WIFI_EVENT_STA_CONNECTED
+	CONN_EVENT_WIFI_DOWN,           //WIFI_EVENT_STA_DISCONNECTED
+	CONN_EVENT_IP_UP,               //IP_EVENT_STA_GOT_IP
+	CONN_EVENT_MQTT_UP,             //MQTT_EVENT_CONNECTED
+	CONN_EVENT_MQTT_DOWN,           //MQTT_EVENT_DISCONNECTED
+} conn_event_t;
+
+//分别统计的两层连接，IP获取失败计入Wi-Fi
+typedef enum {
+	CONN_LINK_WIFI,
+	CONN_LINK_MQTT,
+	CONN_LINK_NUM,
+} conn_link_t;
+
+typedef struct {
+	uint32_t attempts;          //连接尝试次数，包括开机时的第一次
+	uint32_t failures;          //失败或超时的尝试次数
+	uint32_t outages;           //从已连接变为断开的次数
+	uint32_t outage_ms;         //累计断开时长，包括正在进行的这次
+	uint32_t outage_max_ms;     //单次最长断开时长
+	uint32_t backoff_ms;        //最近一次的退避等待时间
+	bool up;
+} conn_stats_t;
+
+void conn_init(const uint8_t mac[6]);
+void conn_notify(conn_event_t event);
+void conn_get_stats(conn_link_t link, conn_stats_t *out);
+#endif
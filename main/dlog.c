@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_log.h>
+
+#include "dlog.h"
+
+/* 延迟日志后端
+ * 上报任务和MQTT任务每个周期都要输出若干条日志，完整的printf格式化和阻塞的串口输出都很耗时。
+ * dlog_write()只把格式ID和参数编码进内存环形缓冲区，日志任务以最低的优先级取出记录，
+ * 在本地格式化输出，或者打包后交给流式发送函数（MQTT），由主机上的tools/dlog解码。
+ * 缓冲区满时丢弃新记录并计数，不阻塞调用者。多个任务会写入，在临界区内读写 */
+
+static const char *TAG = "main.dlog";
+
+//缓冲区为空时日志任务的检查间隔
+#define DLOG_FLUSH_MS 100
+//流式发送时单条消息的最大长度
+#define DLOG_STREAM_MESSAGE_LEN 512
+//本地输出时单条日志文本的最大长度
+#define DLOG_TEXT_LEN 160
+//低于上报任务和MQTT任务
+#define DLOG_TASK_PRIORITY 1
+
+static uint8_t ring[CONFIG_DLOG_RING_SIZE];
+static size_t ring_head;            //最旧记录的位置
+static size_t ring_used;
+static uint32_t dropped;            //开机后累计丢弃的记录数
+static uint32_t dropped_unreported; //上次报告之后丢弃的记录数
+static dlog_stream_t stream;
+
+/* 描述：记录一条日志，一般通过DLOGx宏调用
+ * 参数level：日志级别
+ * 参数id：格式ID
+ * 参数...：格式串中各转换对应的参数 */
+void dlog_write(esp_log_level_t level, dlog_id_t id, ...)
+{
+	uint8_t record[DLOG_RECORD_MAX];
+	va_list args;
+
+	va_start(args, id);
+	int len = dlog_encode(record, sizeof(record), level, id, esp_log_early_timestamp(), args);
+	va_end(args);
+
+	taskENTER_CRITICAL();
+	if (len > 0 && ring_used + len <= CONFIG_DLOG_RING_SIZE) {
+		size_t tail = (ring_head + ring_used) % CONFIG_DLOG_RING_SIZE;
+		size_t first = CONFIG_DLOG_RING_SIZE - tail < len ? CONFIG_DLOG_RING_SIZE - tail : len;
+		memcpy(ring + tail, record, first);
+		memcpy(ring, record + first, len - first);
+		ring_used += len;
+	} else {
+		dropped++;
+		dropped_unreported++;
+	}
+	taskEXIT_CRITICAL();
+}
+
+//取出最旧的一条记录，缓冲区为空返回0
+static size_t dlog_pop(uint8_t *record)
+{
+	size_t len = 0;
+
+	taskENTER_CRITICAL();
+	if (ring_used > 0) {
+		len = DLOG_RECORD_HEADER_LEN + ring[(ring_head + 3) % CONFIG_DLOG_RING_SIZE];
+		for (size_t i = 0; i < len; i++) {
+			record[i] = ring[(ring_head + i) % CONFIG_DLOG_RING_SIZE];
+		}
+		ring_head = (ring_head + len) % CONFIG_DLOG_RING_SIZE;
+		ring_used -= len;
+	}
+	taskEXIT_CRITICAL();
+
+	return len;
+}
+
+static uint32_t dlog_take_dropped(void)
+{
+	taskENTER_CRITICAL();
+	uint32_t n = dropped_unreported;
+	dropped_unreported = 0;
+	taskEXIT_CRITICAL();
+	return n;
+}
+
+//在本地格式化输出连续的若干条记录，时间为记录时的开机时间
+static void dlog_print(const uint8_t *data, size_t len)
+{
+	char text[DLOG_TEXT_LEN];
+	dlog_record_t record;
+	int n;
+
+	while ((n = dlog_decode(data, len, &record)) > 0) {
+		if (dlog_format(text, sizeof(text), &record) < 0) {
+			snprintf(text, sizeof(text), "undecodable record, format %u", record.id);
+		}
+		ESP_LOG_LEVEL((esp_log_level_t)record.level, dlog_tag(record.id), "[%u] %s", record.timestamp, text);
+		data += n;
+		len -= n;
+	}
+}
+
+//补上消息头后发送，发送失败时改为本地输出
+static void dlog_send(uint8_t *message, size_t len, dlog_stream_t send)
+{
+	uint32_t lost = dlog_take_dropped();
+
+	message[0] = DLOG_STREAM_VERSION;
+	message[1] = 0;
+	message[2] = lost > UINT16_MAX ? 0xFF : lost;
+	message[3] = lost > UINT16_MAX ? 0xFF : lost >> 8;
+	if (send == NULL || !send(message, len)) {
+		if (lost) {
+			ESP_LOGW(TAG, "%u log records dropped", lost);
+		}
+		dlog_print(message + DLOG_STREAM_HEADER_LEN, len - DLOG_STREAM_HEADER_LEN);
+	}
+}
+
+static void dlog_task(void *arg)
+{
+	static uint8_t message[DLOG_STREAM_MESSAGE_LEN];
+	uint8_t record[DLOG_RECORD_MAX];
+	size_t len = DLOG_STREAM_HEADER_LEN;
+
+	while (true) {
+		size_t n = dlog_pop(record);
+		dlog_stream_t send = stream;
+
+		//缓冲区已空、消息放不下或流式发送已关闭时发出积累的记录
+		if (len > DLOG_STREAM_HEADER_LEN && (n == 0 || len + n > sizeof(message) || send == NULL)) {
+			dlog_send(message, len, send);
+			len = DLOG_STREAM_HEADER_LEN;
+		}
+
+		if (n == 0) {
+			uint32_t lost = send == NULL ? dlog_take_dropped() : 0;
+			if (lost) {
+				ESP_LOGW(TAG, "%u log records dropped", lost);
+			}
+			vTaskDelay(DLOG_FLUSH_MS / portTICK_PERIOD_MS);
+		} else if (send == NULL) {
+			dlog_print(record, n);
+		} else {
+			memcpy(message + len, record, n);
+			len += n;
+		}
+	}
+}
+
+/* 描述：启动日志任务，之前记录的日志保留在缓冲区中 */
+void dlog_init(void)
+{
+	xTaskCreate(dlog_task, "dlog_task", 2048, NULL, DLOG_TASK_PRIORITY, NULL);
+}
+
+/* 描述：设置流式发送函数，NULL表示在本地输出
+ * 参数send：发送函数，在日志任务中调用 */
+void dlog_set_stream(dlog_stream_t send)
+{
+	stream = send;
+}
+
+/* 描述：获取开机后因缓冲区满丢弃的记录数 */
+uint32_t dlog_dropped(void)
+{
+	taskENTER_CRITICAL();
+	uint32_t n = dropped;
+	taskEXIT_CRITICAL();
+	return n;
+}
@@ -0,0 +1,36 @@
+#ifndef __DLOG_H__
+#define __DLOG_H__
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <esp_log.h>
+
+#include "dlog_codec.h"
+
+/* 延迟日志：热路径上只记录格式ID和原始参数，格式化和串口输出在低优先级任务中进行
+ * 用法：DLOGI(REPORT_LOOP, min, max, p99, missed, cycles)，格式在dlog_formats.h中登记。
+ * 格式检查由编译器按DLOG_FMT_<名称>完成，与ESP_LOGx相同 */
+
+//流式发送函数，成功返回true，失败时记录改为在本地输出
+typedef bool (*dlog_stream_t)(const uint8_t *data, size_t len);
+
+static inline void __attribute__((format(printf, 1, 2))) dlog_check(const char *format, ...)
+{
+}
+
+#define DLOG_LEVEL(level, name, ...) do { \
+		if (0) { \
+			dlog_check(DLOG_FMT_##name, ##__VA_ARGS__); \
+		} \
+		dlog_write(level, DLOG_ID_##name, ##__VA_ARGS__); \
+	} while (0)
+
+#define DLOGE(name, ...) DLOG_LEVEL(ESP_LOG_ERROR, name, ##__VA_ARGS__)
+#define DLOGW(name, ...) DLOG_LEVEL(ESP_LOG_WARN, name, ##__VA_ARGS__)
+#define DLOGI(name, ...) DLOG_LEVEL(ESP_LOG_INFO, name, ##__VA_ARGS__)
+
+void dlog_init(void);
+void dlog_write(esp_log_level_t level, dlog_id_t id, ...);
+void dlog_set_stream(dlog_stream_t stream);
+uint32_t dlog_dropped(void);
+#endif
@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "dlog_codec.h"
+
+/* 延迟日志的编码和格式化，不依赖SDK，主机解码器也使用同一实现
+ * 编码时只按格式串取出参数，不做任何格式化；格式化时逐个转换调用snprintf */
+
+typedef struct {
+	const char *tag;
+	const char *format;
+} dlog_format_t;
+
+static const dlog_format_t formats[DLOG_ID_NUM] = {
+#define DLOG_ENTRY(name, tag) [DLOG_ID_##name] = {tag, DLOG_FMT_##name},
+	DLOG_FORMATS(DLOG_ENTRY)
+#undef DLOG_ENTRY
+};
+
+static void put_le16(uint8_t *p, uint16_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+//跳过'%'之后的标志、宽度、精度和h长度修饰，返回转换字符的位置
+static const char *spec_end(const char *p)
+{
+	while (*p && strchr("-+ #0", *p)) {
+		p++;
+	}
+	while (*p >= '0' && *p <= '9') {
+		p++;
+	}
+	if (*p == '.') {
+		p++;
+		while (*p >= '0' && *p <= '9') {
+			p++;
+		}
+	}
+	//short和char参数按int传递，与int相同处理
+	while (*p == 'h') {
+		p++;
+	}
+	return p;
+}
+
+/* 描述：按格式ID对应的格式串编码一条记录
+ * 参数buf：输出缓冲区，建议长度DLOG_RECORD_MAX
+ * 参数size：缓冲区长度
+ * 参数level：日志级别
+ * 参数id：格式ID
+ * 参数timestamp：开机时间(ms)
+ * 参数args：格式串中各转换对应的参数
+ * 返回值：记录长度，格式ID无效、格式不受支持或参数超长返回-1 */
+int dlog_encode(uint8_t *buf, size_t size, uint8_t level, uint16_t id, uint32_t timestamp, va_list args)
+{
+	size_t len = DLOG_RECORD_HEADER_LEN;
+
+	if (id >= DLOG_ID_NUM || size < DLOG_RECORD_HEADER_LEN) {
+		return -1;
+	}
+	if (size > DLOG_RECORD_MAX) {
+		size = DLOG_RECORD_MAX;
+	}
+
+	for (const char *p = formats[id].format; *p; p++) {
+		if (*p != '%') {
+			continue;
+		}
+		p = spec_end(p + 1);
+		switch (*p) {
+			case '%':
+				break;
+			case 'd':
+			case 'i':
+			case 'u':
+			case 'x':
+			case 'X':
+			case 'c':
+				if (len + 4 > size) {
+					return -1;
+				}
+				put_le32(buf + len, va_arg(args, unsigned int));
+				len += 4;
+				break;
+			case 's': {
+				const char *s = va_arg(args, const char *);
+				size_t n = strnlen(s, DLOG_STR_MAX);
+				if (len + 1 + n > size) {
+					return -1;
+				}
+				buf[len++] = n;
+				memcpy(buf + len, s, n);
+				len += n;
+				break;
+			}
+			default:
+				return -1;
+		}
+	}
+
+	put_le16(buf, id);
+	buf[2] = level;
+	buf[3] = len - DLOG_RECORD_HEADER_LEN;
+	put_le32(buf + 4, timestamp);
+	return len;
+}
+
+/* 描述：从缓冲区中解析一条记录，参数区指向缓冲区内部
+ * 参数buf：记录开始的位置
+ * 参数len：缓冲区剩余长度
+ * 参数record：输出的记录
+ * 返回值：记录长度，剩余数据不足一条记录返回0 */
+int dlog_decode(const uint8_t *buf, size_t len, dlog_record_t *record)
+{
+	if (len < DLOG_RECORD_HEADER_LEN || len < DLOG_RECORD_HEADER_LEN + buf[3]) {
+		return 0;
+	}
+
+	record->id = buf[0] | buf[1] << 8;
+	record->level = buf[2];
+	record->args_len = buf[3];
+	record->timestamp = get_le32(buf + 4);
+	record->args = buf + DLOG_RECORD_HEADER_LEN;
+	return DLOG_RECORD_HEADER_LEN + record->args_len;
+}
+
+/* 描述：把记录格式化为文本，不含级别、时间和标签，文本过长时截断
+ * 参数buf：输出缓冲区
+ * 参数size：缓冲区长度
+ * 参数record：记录
+ * 返回值：文本长度，格式ID未知或参数与格式不符返回-1 */
+int dlog_format(char *buf, size_t size, const dlog_record_t *record)
+{
+	const uint8_t *arg = record->args;
+	const uint8_t *end = record->args + record->args_len;
+	size_t len = 0;
+
+	if (record->id >= DLOG_ID_NUM || size == 0) {
+		return -1;
+	}
+
+	const char *p = formats[record->id].format;
+	while (*p && len + 1 < size) {
+		if (*p != '%') {
+			buf[len++] = *p++;
+			continue;
+		}
+
+		//取出单个转换说明，与对应的参数一起交给snprintf
+		const char *conv = spec_end(p + 1);
+		char spec[16];
+		size_t spec_len = conv - p + 1;
+		if (*conv == '\0' || spec_len >= sizeof(spec)) {
+			return -1;
+		}
+		memcpy(spec, p, spec_len);
+		spec[spec_len] = '\0';
+
+		int n;
+		switch (*conv) {
+			case '%':
+				n = snprintf(buf + len, size - len, "%%");
+				break;
+			case 'd':
+			case 'i':
+			case 'u':
+			case 'x':
+			case 'X':
+			case 'c':
+				if (end - arg < 4) {
+					return -1;
+				}
+				n = snprintf(buf + len, size - len, spec, get_le32(arg));
+				arg += 4;
+				break;
+			case 's': {
+				char s[DLOG_STR_MAX + 1];
+				if (end - arg < 1 || end - arg - 1 < arg[0] || arg[0] > DLOG_STR_MAX) {
+					return -1;
+				}
+				memcpy(s, arg + 1, arg[0]);
+				s[arg[0]] = '\0';
+				arg += 1 + arg[0];
+				n = snprintf(buf + len, size - len, spec, s);
+				break;
+			}
+			default:
+				return -1;
+		}
+		if (n < 0) {
+			return -1;
+		}
+
+		len += n;
+		if (len >= size) {
+			len = size - 1;
+		}
+		p = conv + 1;
+	}
+
+	buf[len] = '\0';
+	return len;
+}
+
+/* 描述：获取格式ID对应的日志标签，未知ID返回"dlog" */
+const char *dlog_tag(uint16_t id)
+{
+	return id < DLOG_ID_NUM ? formats[id].tag : "dlog";
+}
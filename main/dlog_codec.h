@@ -0,0 +1,48 @@
+#ifndef __DLOG_CODEC_H__
+#define __DLOG_CODEC_H__
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+
+#include "dlog_formats.h"
+
+/* 延迟日志记录格式（所有多字节字段均为小端序）
+ *   偏移 长度 字段
+ *   0    2    id        格式ID，即dlog_id_t
+ *   2    1    level     日志级别，与esp_log_level_t相同
+ *   3    1    args_len  参数区长度
+ *   4    4    timestamp 记录时的开机时间(ms)
+ *   8    n    args      按格式中转换的顺序：整数4字节；字符串1字节长度加内容，不含结尾的\0
+ *
+ * 通过MQTT发送时，一条消息包含一个4字节的消息头和若干条完整记录：
+ *   0    1    version   当前为1
+ *   1    1    reserved
+ *   2    2    dropped   上一条消息之后因缓冲区满丢弃的记录数，超过65535时为65535
+ */
+#define DLOG_RECORD_HEADER_LEN 8
+#define DLOG_ARGS_MAX 64
+#define DLOG_RECORD_MAX (DLOG_RECORD_HEADER_LEN + DLOG_ARGS_MAX)
+#define DLOG_STR_MAX 32
+#define DLOG_STREAM_VERSION 1
+#define DLOG_STREAM_HEADER_LEN 4
+
+typedef enum {
+#define DLOG_ID(name, tag) DLOG_ID_##name,
+	DLOG_FORMATS(DLOG_ID)
+#undef DLOG_ID
+	DLOG_ID_NUM,
+} dlog_id_t;
+
+typedef struct {
+	uint16_t id;
+	uint8_t level;
+	uint32_t timestamp;
+	const uint8_t *args;
+	size_t args_len;
+} dlog_record_t;
+
+int dlog_encode(uint8_t *buf, size_t size, uint8_t level, uint16_t id, uint32_t timestamp, va_list args);
+int dlog_decode(const uint8_t *buf, size_t len, dlog_record_t *record);
+int dlog_format(char *buf, size_t size, const dlog_record_t *record);
+const char *dlog_tag(uint16_t id);
+#endif
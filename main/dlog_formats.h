@@ -0,0 +1,35 @@
+#ifndef __DLOG_FORMATS_H__
+#define __DLOG_FORMATS_H__
+
+/* 延迟日志的格式表，固件和主机解码器(tools/dlog)共用
+ * 设备只记录格式ID和原始参数，按ID查表格式化。已部署设备的日志按ID解码，
+ * 新格式只能追加在DLOG_FORMATS的末尾，不能删除或重排；不再使用的格式保留原位。
+ * 参数只支持d/i/u/x/X/c/s转换（可带标志、宽度和精度），字符串最多保存DLOG_STR_MAX个字节 */
+
+//与SHT3X_CENTI_FMT相同，解码器不依赖驱动头文件
+#define DLOG_CENTI "%s%d.%02d"
+
+#define DLOG_FMT_SAMPLE_SUPPRESSED "sensor %d temperature:" DLOG_CENTI " °C, humidity:" DLOG_CENTI " %%, within deadband, %d suppressed"
+#define DLOG_FMT_SAMPLE_QUEUED     "sensor %d temperature:" DLOG_CENTI " °C, humidity:" DLOG_CENTI " %%, queued %d"
+#define DLOG_FMT_PUBLISH_JSON      "sent publish successful, msg_id=%d"
+#define DLOG_FMT_PUBLISH_BINARY    "sent binary publish successful, msg_id=%d"
+#define DLOG_FMT_WINDOW_FULL       "Publish window full, %d samples queued"
+#define DLOG_FMT_REPORT_LOOP       "MQTT report loop, lateness min=%d max=%d p99=%d ms, missed %d of %d"
+#define DLOG_FMT_OFFLINE           "MQTT offline, %d samples in flash, %d dropped from flash, %d dropped from RAM"
+#define DLOG_FMT_WIFI_RSSI         "WiFi connect to %s RSSI=%d"
+#define DLOG_FMT_PUBLISH_SUCCESS   "MQTT publish success"
+#define DLOG_FMT_PUBACK            "PUBACK msg_id=%d rtt=%u ms"
+
+//X(名称, 日志标签)，名称对应上面的DLOG_FMT_<名称>
+#define DLOG_FORMATS(X) \
+	X(SAMPLE_SUPPRESSED, "main.mqtt") \
+	X(SAMPLE_QUEUED,     "main.mqtt") \
+	X(PUBLISH_JSON,      "main.mqtt") \
+	X(PUBLISH_BINARY,    "main.mqtt") \
+	X(WINDOW_FULL,       "main.mqtt") \
+	X(REPORT_LOOP,       "main.mqtt") \
+	X(OFFLINE,           "main.mqtt") \
+	X(WIFI_RSSI,         "main.mqtt") \
+	X(PUBLISH_SUCCESS,   "main.mqtt") \
+	X(PUBACK,            "main.inflight")
+#endif
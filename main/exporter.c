@@ -0,0 +1,72 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_log.h>
+
+#include "exporter.h"
+
+/* 采样导出
+ * 上报任务采集到的每条采样经过这里分发给已注册的后端（MQTT、InfluxDB UDP、Prometheus）。
+ * 后端在初始化时注册，之后不再注销；注册和分发可能在不同的任务中，注册时在临界区内追加，
+ * 分发时先读取后端数，已注册的项不会再被修改 */
+
+static const char *TAG = "main.exporter";
+
+static const exporter_t *exporters[EXPORTER_MAX];
+static size_t exporter_count;
+
+static size_t exporter_snapshot(void)
+{
+	taskENTER_CRITICAL();
+	size_t count = exporter_count;
+	taskEXIT_CRITICAL();
+	return count;
+}
+
+/* 描述：注册导出后端，后端结构体需要一直有效
+ * 可能阻塞的后端应当最后注册，它的flush不会推迟其他后端的发送
+ * 参数exporter：导出后端
+ * 返回值：后端数已达EXPORTER_MAX时返回ESP_ERR_NO_MEM */
+esp_err_t exporter_register(const exporter_t *exporter)
+{
+	esp_err_t ret = ESP_OK;
+
+	taskENTER_CRITICAL();
+	if (exporter_count < EXPORTER_MAX) {
+		exporters[exporter_count++] = exporter;
+	} else {
+		ret = ESP_ERR_NO_MEM;
+	}
+	taskEXIT_CRITICAL();
+
+	if (ret == ESP_OK) {
+		ESP_LOGI(TAG, "Export samples to %s", exporter->name);
+	} else {
+		ESP_LOGE(TAG, "Too many exporters, %s not registered", exporter->name);
+	}
+	return ret;
+}
+
+/* 描述：把一条采样交给所有后端，在上报任务中调用
+ * 参数sample：采样，后端需要保留时自行复制 */
+void exporter_export(const payload_sample_t *sample)
+{
+	size_t count = exporter_snapshot();
+
+	for (size_t i = 0; i < count; i++) {
+		exporters[i]->export(sample);
+	}
+}
+
+/* 描述：每个上报周期结束时让各后端按自己的批量策略发送，在上报任务中调用 */
+void exporter_flush(void)
+{
+	size_t count = exporter_snapshot();
+
+	for (size_t i = 0; i < count; i++) {
+		if (exporters[i]->flush) {
+			exporters[i]->flush();
+		}
+	}
+}
@@ -0,0 +1,23 @@
+#ifndef __EXPORTER_H__
+#define __EXPORTER_H__
+#include <esp_err.h>
+#include "payload.h"
+
+//最多同时注册的导出后端数
+#define EXPORTER_MAX 4
+
+/* 导出后端
+ * 每条采样只采集一次，按注册顺序交给所有后端。后端各自缓存和批量发送，
+ * 某个后端离线或发送失败只影响它自己，不会阻止其他后端收到采样 */
+typedef struct {
+	const char *name;
+	//每条采样调用一次，只能缓存采样，不能阻塞
+	void (*export)(const payload_sample_t *sample);
+	//每个上报周期所有传感器采样之后调用一次，由后端决定是否发送，可以为NULL
+	void (*flush)(void);
+} exporter_t;
+
+esp_err_t exporter_register(const exporter_t *exporter);
+void exporter_export(const payload_sample_t *sample);
+void exporter_flush(void);
+#endif
@@ -0,0 +1,352 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <esp_log.h>
+#include <esp_partition.h>
+#include <esp_system.h>
+
+#include "flash_log.h"
+#include "time.h"
+
+/* 离线采样的Flash环形日志
+ *
+ * 使用分区表中名为samples的数据分区，按扇区循环写入，所有扇区被轮流擦写以均衡磨损。
+ * 每个扇区开头是扇区头，记录单调递增的扇区序号，启动时据此找到最新和最旧的扇区；
+ * 其后是定长的采样记录。记录的标记字只会从1变为0，不需要擦除即可把记录标记为已上报：
+ *   0xFFFFFFFF 空闲，RECORD_WRITTEN 待上报，RECORD_CONSUMED 已上报。
+ * 写满后覆盖最旧的扇区，被覆盖的待上报采样计入丢弃计数。只在上报任务中访问，不需要加锁。
+ * 记录中的单调时间只在同一次开机内有意义，写入时尚未同步的记录按开机标识判断能否在读取时换算为UTC时间 */
+#define FLASH_LOG_PARTITION "samples"
+#define SECTOR_SIZE 4096
+#define SECTOR_MAGIC 0x534D5034    /* "SMP4"，记录格式变化时更换，旧格式的扇区视为空闲 */
+#define RECORD_EMPTY 0xFFFFFFFF
+#define RECORD_WRITTEN 0x5AFE5AFE
+#define RECORD_CONSUMED 0x00000000
+#define RECORD_SIZE 32
+#define RECORDS_PER_SECTOR (SECTOR_SIZE / RECORD_SIZE - 1)    /* 第一个记录位置留给扇区头 */
+
+typedef struct {
+	uint32_t magic;
+	uint32_t seq;
+	uint32_t reserved[6];
+} sector_header_t;
+
+typedef struct {
+	uint32_t marker;
+	uint32_t boot;      //写入时的开机标识
+	int64_t mono_ms;
+	int64_t time_ms;    //写入时已知的UTC时间，未知时为0
+	int16_t temperature;
+	uint16_t humiture;
+	uint8_t sensor;
+	uint8_t count;      //原始采样数，超过255时记为255
+	uint16_t check;
+} record_t;
+
+_Static_assert(sizeof(sector_header_t) == RECORD_SIZE, "sector header size");
+_Static_assert(sizeof(record_t) == RECORD_SIZE, "record size");
+
+static const char *TAG = "main.flash_log";
+static const esp_partition_t *partition;
+static uint32_t sector_count;
+
+//写入位置
+static uint32_t write_sector;
+static uint32_t write_slot;
+static uint32_t write_seq;
+
+//读取位置，即最旧的一条待上报记录之前
+static uint32_t read_sector;
+static uint32_t read_slot;
+
+static uint32_t depth;
+static uint32_t dropped;
+static uint32_t boot_id;
+
+//最近一次peek返回的记录位置，consume时据此标记为已上报
+static uint32_t peek_sector[CONFIG_REPORT_BATCH_MAX];
+static uint32_t peek_slot[CONFIG_REPORT_BATCH_MAX];
+static size_t peek_count;
+
+static size_t record_offset(uint32_t sector, uint32_t slot)
+{
+	return sector * SECTOR_SIZE + (slot + 1) * RECORD_SIZE;
+}
+
+//记录校验值，用于识别写入过程中掉电造成的残缺记录
+static uint16_t record_check(const record_t *record)
+{
+	uint32_t h = 2166136261u;
+	const uint8_t *p = (const uint8_t *)&record->boot;
+
+	for (int i = 0; i < offsetof(record_t, check) - offsetof(record_t, boot); i++) {
+		h = (h ^ p[i]) * 16777619u;
+	}
+	return (uint16_t)(h ^ (h >> 16));
+}
+
+static esp_err_t read_header(uint32_t sector, sector_header_t *header)
+{
+	return esp_partition_read(partition, sector * SECTOR_SIZE, header, sizeof(*header));
+}
+
+//擦除并启用一个新扇区
+static esp_err_t open_sector(uint32_t sector)
+{
+	esp_err_t ret = esp_partition_erase_range(partition, sector * SECTOR_SIZE, SECTOR_SIZE);
+	if (ret != ESP_OK) {
+		return ret;
+	}
+
+	sector_header_t header = {
+		.magic = SECTOR_MAGIC,
+		.seq = ++write_seq,
+	};
+	memset(header.reserved, 0xFF, sizeof(header.reserved));
+	ret = esp_partition_write(partition, sector * SECTOR_SIZE, &header, sizeof(header));
+	if (ret != ESP_OK) {
+		return ret;
+	}
+
+	write_sector = sector;
+	write_slot = 0;
+	return ESP_OK;
+}
+
+/* 描述：把读取位置移到下一个扇区开头 */
+static void advance_read_sector(void)
+{
+	read_sector = (read_sector + 1) % sector_count;
+	read_slot = 0;
+}
+
+/* 描述：初始化Flash日志，扫描分区恢复读写位置和积压条数
+ * 返回值：成功返回ESP_OK，找不到分区返回ESP_ERR_NOT_FOUND */
+esp_err_t flash_log_init(void)
+{
+	//随机的开机标识，区分本次开机之前写入的记录
+	boot_id = esp_random();
+
+	partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, FLASH_LOG_PARTITION);
+	if (partition == NULL) {
+		ESP_LOGE(TAG, "Partition %s not found", FLASH_LOG_PARTITION);
+		return ESP_ERR_NOT_FOUND;
+	}
+
+	sector_count = partition->size / SECTOR_SIZE;
+	if (sector_count < 2) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+
+	//找出序号最大（最新）和最小（最旧）的扇区
+	bool found = false;
+	uint32_t oldest_seq = 0;
+	for (uint32_t i = 0; i < sector_count; i++) {
+		sector_header_t header;
+		if (read_header(i, &header) != ESP_OK || header.magic != SECTOR_MAGIC) {
+			continue;
+		}
+		if (!found || header.seq > write_seq) {
+			write_seq = header.seq;
+			write_sector = i;
+		}
+		if (!found || header.seq < oldest_seq) {
+			oldest_seq = header.seq;
+			read_sector = i;
+		}
+		found = true;
+	}
+
+	if (!found) {
+		ESP_LOGW(TAG, "Format %d sectors for sample log", sector_count);
+		write_seq = 0;
+		read_sector = 0;
+		read_slot = 0;
+		return open_sector(0);
+	}
+
+	//从最旧的扇区开始统计待上报的记录，并定位第一条待上报记录和写入位置
+	bool read_found = false;
+	uint32_t sector = read_sector;
+	read_slot = 0;
+	write_slot = RECORDS_PER_SECTOR;
+	while (true) {
+		for (uint32_t slot = 0; slot < RECORDS_PER_SECTOR; slot++) {
+			uint32_t marker;
+			if (esp_partition_read(partition, record_offset(sector, slot), &marker, sizeof(marker)) != ESP_OK) {
+				continue;
+			}
+			if (marker == RECORD_EMPTY) {
+				if (sector == write_sector && slot < write_slot) {
+					write_slot = slot;
+				}
+				continue;
+			}
+			if (marker == RECORD_WRITTEN) {
+				depth++;
+				if (!read_found) {
+					read_found = true;
+					read_sector = sector;
+					read_slot = slot;
+				}
+			}
+		}
+
+		if (sector == write_sector) {
+			break;
+		}
+		sector = (sector + 1) % sector_count;
+	}
+
+	if (!read_found) {
+		read_sector = write_sector;
+		read_slot = write_slot;
+	}
+
+	ESP_LOGI(TAG, "Sample log has %d pending samples, write at sector %d slot %d", depth, write_sector, write_slot);
+	return ESP_OK;
+}
+
+/* 描述：追加一条采样，日志写满时覆盖最旧的扇区
+ * 参数sample：采样
+ * 返回值：成功返回ESP_OK */
+esp_err_t flash_log_append(const payload_sample_t *sample)
+{
+	esp_err_t ret;
+
+	if (partition == NULL) {
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	if (write_slot == RECORDS_PER_SECTOR) {
+		uint32_t next = (write_sector + 1) % sector_count;
+
+		//下一个扇区还有待上报的记录，整个扇区丢弃
+		if (next == read_sector && depth > 0) {
+			for (uint32_t slot = read_slot; slot < RECORDS_PER_SECTOR; slot++) {
+				uint32_t marker;
+				if (esp_partition_read(partition, record_offset(next, slot), &marker, sizeof(marker)) == ESP_OK &&
+						marker == RECORD_WRITTEN) {
+					depth--;
+					dropped++;
+				}
+			}
+			advance_read_sector();
+			peek_count = 0;
+		}
+
+		ret = open_sector(next);
+		if (ret != ESP_OK) {
+			ESP_LOGE(TAG, "Fail to open sector %d: %s", next, esp_err_to_name(ret));
+			return ret;
+		}
+	}
+
+	record_t record = {
+		.marker = RECORD_WRITTEN,
+		.boot = boot_id,
+		.mono_ms = sample->mono_ms,
+		.time_ms = sample->time_ms,
+		.temperature = sample->temperature,
+		.humiture = sample->humiture,
+		.sensor = sample->sensor,
+		.count = sample->count > UINT8_MAX ? UINT8_MAX : sample->count,
+	};
+	record.check = record_check(&record);
+
+	ret = esp_partition_write(partition, record_offset(write_sector, write_slot), &record, sizeof(record));
+	write_slot++;
+	if (ret != ESP_OK) {
+		dropped++;
+		return ret;
+	}
+
+	depth++;
+	return ESP_OK;
+}
+
+/* 描述：按从旧到新的顺序读取若干条待上报采样，不会标记为已上报
+ * 参数samples：存储采样的数组
+ * 参数count：数组长度
+ * 返回值：实际读取的条数 */
+size_t flash_log_peek(payload_sample_t *samples, size_t count)
+{
+	uint32_t sector = read_sector;
+	uint32_t slot = read_slot;
+	size_t n = 0;
+
+	peek_count = 0;
+	if (partition == NULL || depth == 0) {
+		return 0;
+	}
+
+	while (n < count && peek_count < CONFIG_REPORT_BATCH_MAX) {
+		if (sector == write_sector && slot >= write_slot) {
+			break;
+		}
+		if (slot == RECORDS_PER_SECTOR) {
+			sector = (sector + 1) % sector_count;
+			slot = 0;
+			continue;
+		}
+
+		record_t record;
+		if (esp_partition_read(partition, record_offset(sector, slot), &record, sizeof(record)) == ESP_OK &&
+				record.marker == RECORD_WRITTEN) {
+			//残缺记录不上报，但仍随本批一起标记为已上报
+			if (record.check == record_check(&record)) {
+				samples[n].mono_ms = record.mono_ms;
+				samples[n].time_ms = record.time_ms;
+				//本次开机写入时尚未同步的采样，按当前的时间偏移换算
+				if (record.time_ms == 0 && record.boot == boot_id) {
+					samples[n].time_ms = time_epoch_ms(record.mono_ms);
+				}
+				samples[n].temperature = record.temperature;
+				samples[n].humiture = record.humiture;
+				samples[n].sensor = record.sensor;
+				samples[n].count = record.count;
+				n++;
+			} else {
+				ESP_LOGW(TAG, "Skip corrupted record at sector %d slot %d", sector, slot);
+			}
+			peek_sector[peek_count] = sector;
+			peek_slot[peek_count] = slot;
+			peek_count++;
+		}
+		slot++;
+	}
+
+	return n;
+}
+
+/* 描述：把最近一次flash_log_peek读取的采样标记为已上报
+ * 返回值：成功返回ESP_OK */
+esp_err_t flash_log_consume(void)
+{
+	static const uint32_t consumed = RECORD_CONSUMED;
+
+	for (size_t i = 0; i < peek_count; i++) {
+		esp_err_t ret = esp_partition_write(partition, record_offset(peek_sector[i], peek_slot[i]), &consumed, sizeof(consumed));
+		if (ret != ESP_OK) {
+			peek_count = 0;
+			return ret;
+		}
+		depth--;
+		read_sector = peek_sector[i];
+		read_slot = peek_slot[i] + 1;
+	}
+
+	peek_count = 0;
+	return ESP_OK;
+}
+
+uint32_t flash_log_depth(void)
+{
+	return depth;
+}
+
+uint32_t flash_log_dropped(void)
+{
+	return dropped;
+}
@@ -0,0 +1,14 @@
+#ifndef __FLASH_LOG_H__
+#define __FLASH_LOG_H__
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_err.h>
+#include "payload.h"
+
+esp_err_t flash_log_init(void);
+esp_err_t flash_log_append(const payload_sample_t *sample);
+size_t flash_log_peek(payload_sample_t *samples, size_t count);
+esp_err_t flash_log_consume(void);
+uint32_t flash_log_depth(void);
+uint32_t flash_log_dropped(void);
+#endif
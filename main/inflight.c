@@ -0,0 +1,209 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include "inflight.h"
+#include "dlog.h"
+
+/* QoS 1发布窗口
+ * 记录已交给MQTT客户端、尚未收到PUBACK的消息，窗口大小为CONFIG_REPORT_INFLIGHT_MAX。
+ * 上报任务在发布前检查空位，窗口满时不再发布，采样留在队列中；MQTT_EVENT_PUBLISHED在MQTT任务中移出消息，
+ * 两个任务都会访问，在临界区内读写。客户端在重连后会自动重发未确认的消息，
+ * 超过CONFIG_REPORT_ACK_TIMEOUT_MS仍未确认的消息只移出窗口并计数，不再等待。
+ * PUBACK可能在esp_mqtt_client_publish()返回之前就在MQTT任务中处理完，因此发布前先预留空位并记录发送时间，
+ * 拿到消息ID后再填入；预留期间收到的、不在窗口中的PUBACK暂存起来，填入消息ID时先检查是否已经确认 */
+
+static const char *TAG = "main.inflight";
+
+//预留但还没有消息ID的空位
+#define INFLIGHT_RESERVED -1
+//预留期间最多暂存的PUBACK数，只有同时有超时消息的迟到确认时才会超过1条
+#define INFLIGHT_EARLY_ACK_NUM 4
+
+typedef struct {
+	int msg_id;
+	int64_t sent_us;
+} inflight_entry_t;
+
+static const uint32_t rtt_buckets_ms[INFLIGHT_RTT_BUCKET_NUM] = INFLIGHT_RTT_BUCKETS_MS;
+static inflight_entry_t window[CONFIG_REPORT_INFLIGHT_MAX];
+static inflight_entry_t early_acks[INFLIGHT_EARLY_ACK_NUM];  //sent_us为收到PUBACK的时间
+static size_t early_ack_next;
+static size_t reserved;
+static inflight_stats_t stats;
+
+/* 描述：获取窗口中的空位数 */
+size_t inflight_free(void)
+{
+	taskENTER_CRITICAL();
+	size_t n = CONFIG_REPORT_INFLIGHT_MAX - stats.in_flight;
+	taskEXIT_CRITICAL();
+	return n;
+}
+
+//记录一条消息的确认和往返时间，在临界区内调用
+static uint32_t record_ack(int64_t sent_us, int64_t acked_us)
+{
+	uint32_t rtt_ms = (acked_us - sent_us) / 1000;
+	int b = 0;
+
+	stats.in_flight--;
+	stats.acked++;
+	while (rtt_ms > rtt_buckets_ms[b]) {
+		b++;
+	}
+	stats.rtt_hist[b]++;
+	if (rtt_ms > stats.rtt_max_ms) {
+		stats.rtt_max_ms = rtt_ms;
+	}
+	return rtt_ms;
+}
+
+/* 描述：在发布一条QoS 1消息之前预留窗口中的空位，调用前需确认有空位
+ * 返回值：空位序号，之后用inflight_commit()填入消息ID或用inflight_release()释放；没有空位返回-1 */
+int inflight_reserve(void)
+{
+	int64_t now = esp_timer_get_time();
+	int slot = -1;
+
+	taskENTER_CRITICAL();
+	for (int i = 0; i < CONFIG_REPORT_INFLIGHT_MAX; i++) {
+		if (window[i].msg_id == 0) {
+			window[i].msg_id = INFLIGHT_RESERVED;
+			window[i].sent_us = now;
+			stats.in_flight++;
+			reserved++;
+			slot = i;
+			break;
+		}
+	}
+	taskEXIT_CRITICAL();
+	return slot;
+}
+
+/* 描述：发布成功后填入消息ID，消息在此之前已经确认时直接移出窗口
+ * 参数slot：inflight_reserve()返回的空位序号
+ * 参数msg_id：esp_mqtt_client_publish()返回的消息ID */
+void inflight_commit(int slot, int msg_id)
+{
+	bool acked = false;
+	uint32_t rtt_ms = 0;
+
+	taskENTER_CRITICAL();
+	reserved--;
+	stats.sent++;
+	for (int i = 0; i < INFLIGHT_EARLY_ACK_NUM; i++) {
+		if (early_acks[i].msg_id == msg_id) {
+			rtt_ms = record_ack(window[slot].sent_us, early_acks[i].sent_us);
+			window[slot].msg_id = 0;
+			acked = true;
+			break;
+		}
+	}
+	if (!acked) {
+		window[slot].msg_id = msg_id;
+	}
+	//暂存的确认只可能属于这次预留，没有匹配的是已超时消息的迟到确认
+	if (reserved == 0) {
+		memset(early_acks, 0, sizeof(early_acks));
+	}
+	taskEXIT_CRITICAL();
+
+	if (acked) {
+		DLOGI(PUBACK, msg_id, rtt_ms);
+	}
+}
+
+/* 描述：发布失败时释放预留的空位
+ * 参数slot：inflight_reserve()返回的空位序号 */
+void inflight_release(int slot)
+{
+	taskENTER_CRITICAL();
+	window[slot].msg_id = 0;
+	stats.in_flight--;
+	reserved--;
+	if (reserved == 0) {
+		memset(early_acks, 0, sizeof(early_acks));
+	}
+	taskEXIT_CRITICAL();
+}
+
+/* 描述：收到PUBACK时移出消息并记录往返时间
+ * 参数msg_id：MQTT_EVENT_PUBLISHED中的消息ID
+ * 返回值：消息在窗口中返回true，已超时移出或不是QoS 1上报消息返回false */
+bool inflight_ack(int msg_id)
+{
+	int64_t now = esp_timer_get_time();
+	bool found = false;
+	uint32_t rtt_ms = 0;
+
+	if (msg_id <= 0) {
+		return false;
+	}
+
+	taskENTER_CRITICAL();
+	for (int i = 0; i < CONFIG_REPORT_INFLIGHT_MAX; i++) {
+		if (window[i].msg_id == msg_id) {
+			rtt_ms = record_ack(window[i].sent_us, now);
+			window[i].msg_id = 0;
+			found = true;
+			break;
+		}
+	}
+	//可能是正在发布的消息，交给inflight_commit()处理
+	if (!found && reserved > 0) {
+		early_acks[early_ack_next].msg_id = msg_id;
+		early_acks[early_ack_next].sent_us = now;
+		early_ack_next = (early_ack_next + 1) % INFLIGHT_EARLY_ACK_NUM;
+	}
+	taskEXIT_CRITICAL();
+
+	if (found) {
+		DLOGI(PUBACK, msg_id, rtt_ms);
+	}
+	return found;
+}
+
+/* 描述：把等待超过timeout_ms的消息移出窗口，避免服务器长期不确认时窗口永久占满
+ * 参数timeout_ms：超时时间 */
+void inflight_expire(uint32_t timeout_ms)
+{
+	int64_t now = esp_timer_get_time();
+	uint32_t expired = 0;
+
+	taskENTER_CRITICAL();
+	for (int i = 0; i < CONFIG_REPORT_INFLIGHT_MAX; i++) {
+		if (window[i].msg_id > 0 && now - window[i].sent_us >= (int64_t)timeout_ms * 1000) {
+			window[i].msg_id = 0;
+			stats.in_flight--;
+			stats.expired++;
+			expired++;
+		}
+	}
+	taskEXIT_CRITICAL();
+
+	if (expired > 0) {
+		ESP_LOGW(TAG, "%u publishes not acknowledged within %u ms", expired, timeout_ms);
+	}
+}
+
+/* 描述：记录一次因窗口已满推迟的发布 */
+void inflight_record_full(void)
+{
+	taskENTER_CRITICAL();
+	stats.window_full++;
+	taskEXIT_CRITICAL();
+}
+
+/* 描述：获取窗口统计
+ * 参数out：存储统计结果的指针 */
+void inflight_get_stats(inflight_stats_t *out)
+{
+	taskENTER_CRITICAL();
+	*out = stats;
+	taskEXIT_CRITICAL();
+}
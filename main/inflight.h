@@ -0,0 +1,29 @@
+#ifndef __INFLIGHT_H__
+#define __INFLIGHT_H__
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+//PUBACK往返时间直方图分桶上界(ms)，最后一个桶收集所有更大的值
+#define INFLIGHT_RTT_BUCKETS_MS {50, 100, 200, 500, 1000, 2000, 5000, UINT32_MAX}
+#define INFLIGHT_RTT_BUCKET_NUM 8
+
+typedef struct {
+	uint32_t in_flight;         //当前等待PUBACK的消息数
+	uint32_t sent;              //进入窗口的消息数
+	uint32_t acked;             //收到PUBACK的消息数
+	uint32_t expired;           //超时未确认，被移出窗口的消息数
+	uint32_t window_full;       //因窗口已满推迟发布的次数
+	uint32_t rtt_max_ms;
+	uint32_t rtt_hist[INFLIGHT_RTT_BUCKET_NUM];
+} inflight_stats_t;
+
+size_t inflight_free(void);
+int inflight_reserve(void);
+void inflight_commit(int slot, int msg_id);
+void inflight_release(int slot);
+bool inflight_ack(int msg_id);
+void inflight_expire(uint32_t timeout_ms);
+void inflight_record_full(void);
+void inflight_get_stats(inflight_stats_t *out);
+#endif
@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <lwip/sockets.h>
+#include <lwip/netdb.h>
+#include <esp_log.h>
+#include <sht3x.h>
+
+#include "influx.h"
+#include "exporter.h"
+#include "conn.h"
+#include "time.h"
+
+/* InfluxDB UDP导出后端
+ * 采样先缓存在后端自己的队列中，积累CONFIG_EXPORT_INFLUX_BATCH_COUNT条后，在上报周期末编码为line protocol，
+ * 按数据报长度分批用UDP发出。UDP不建立连接也不等待确认，服务器不可达时不会阻塞上报任务；
+ * 网络断开或发送失败时采样留在队列中，队列满时丢弃最旧的采样并计数。
+ * 发送时才编码，时间同步之前缓存的采样也能带上换算后的UTC时间。只在上报任务中调用，不需要加锁 */
+
+static influx_stats_t stats;
+
+#ifdef CONFIG_EXPORT_INFLUX
+extern uint32_t sensor_sn[];
+extern char mac_string[20];
+
+static const char *TAG = "main.influx";
+
+//低于以太网MTU，数据报不会被分片
+#define INFLUX_DATAGRAM_LEN 1024
+#define INFLUX_LINE_LEN 160
+#define INFLUX_QUEUE_LEN 32
+
+static payload_sample_t queue[INFLUX_QUEUE_LEN];
+static size_t queue_head;
+static size_t queue_count;
+
+static int sock = -1;
+static struct sockaddr_in server;
+static bool resolved;
+
+/* 描述：把一条采样编码为一行line protocol，以\n结尾
+ * 时间同步后附带采样时刻的UTC时间(ns)，否则由服务器按收到的时间记录
+ * 返回值：行长度，缓冲区不足返回-1 */
+static int influx_encode_line(char *buf, size_t size, const payload_sample_t *sample)
+{
+	int len = snprintf(buf, size, "%s,mac=%s,sn=%u temperature=" SHT3X_CENTI_FMT ",humidity=" SHT3X_CENTI_FMT ",count=%ui",
+			CONFIG_EXPORT_INFLUX_MEASUREMENT, mac_string, sensor_sn[sample->sensor],
+			SHT3X_CENTI_ARGS(sample->temperature), SHT3X_CENTI_ARGS(sample->humiture), sample->count);
+	if (len < 0 || len >= size) {
+		return -1;
+	}
+
+	int64_t ms = sample->time_ms ? sample->time_ms : time_epoch_ms(sample->mono_ms);
+	if (ms > 0) {
+		//不依赖printf的64位整数支持，秒和毫秒分开输出
+		int n = snprintf(buf + len, size - len, " %u%03u000000", (unsigned)(ms / 1000), (unsigned)(ms % 1000));
+		if (n < 0 || n >= size - len) {
+			return -1;
+		}
+		len += n;
+	}
+
+	if (len + 1 >= size) {
+		return -1;
+	}
+	buf[len++] = '\n';
+	buf[len] = '\0';
+	return len;
+}
+
+static void influx_export_sample(const payload_sample_t *sample)
+{
+	//服务器长时间不可达时丢弃最旧的采样，只保留最新的数据
+	if (queue_count == INFLUX_QUEUE_LEN) {
+		queue_head = (queue_head + 1) % INFLUX_QUEUE_LEN;
+		queue_count--;
+		stats.dropped++;
+	}
+
+	queue[(queue_head + queue_count) % INFLUX_QUEUE_LEN] = *sample;
+	queue_count++;
+}
+
+//解析服务器地址并创建套接字，IP地址直接转换，主机名通过DNS解析，失败时下个周期重试
+static esp_err_t influx_connect(void)
+{
+	if (!resolved) {
+		memset(&server, 0, sizeof(server));
+		server.sin_family = AF_INET;
+		server.sin_port = htons(CONFIG_EXPORT_INFLUX_PORT);
+		if (inet_aton(CONFIG_EXPORT_INFLUX_HOST, &server.sin_addr) == 0) {
+			struct addrinfo hints = {.ai_family = AF_INET, .ai_socktype = SOCK_DGRAM};
+			struct addrinfo *res;
+			if (getaddrinfo(CONFIG_EXPORT_INFLUX_HOST, NULL, &hints, &res) != 0 || res == NULL) {
+				ESP_LOGE(TAG, "Fail to resolve %s", CONFIG_EXPORT_INFLUX_HOST);
+				return ESP_FAIL;
+			}
+			server.sin_addr = ((struct sockaddr_in *)res->ai_addr)->sin_addr;
+			freeaddrinfo(res);
+		}
+		resolved = true;
+	}
+
+	if (sock < 0) {
+		sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+		if (sock < 0) {
+			ESP_LOGE(TAG, "Fail to create socket");
+			return ESP_FAIL;
+		}
+	}
+
+	return ESP_OK;
+}
+
+//从最旧的采样开始编码一个数据报，返回其中的采样条数
+static size_t influx_fill_datagram(char *datagram, size_t size, size_t *len)
+{
+	size_t n = 0;
+
+	*len = 0;
+	while (n < queue_count) {
+		char line[INFLUX_LINE_LEN];
+		int line_len = influx_encode_line(line, sizeof(line), &queue[(queue_head + n) % INFLUX_QUEUE_LEN]);
+		if (line_len < 0) {
+			//不会出现，编码失败的采样跳过
+			n++;
+			stats.dropped++;
+			continue;
+		}
+		if (*len + line_len > size) {
+			break;
+		}
+		memcpy(datagram + *len, line, line_len);
+		*len += line_len;
+		n++;
+	}
+
+	return n;
+}
+
+static void influx_flush(void)
+{
+	static char datagram[INFLUX_DATAGRAM_LEN];
+	conn_stats_t wifi;
+
+	if (queue_count == 0 || queue_count < CONFIG_EXPORT_INFLUX_BATCH_COUNT) {
+		return;
+	}
+
+	//没有IP时不尝试发送，采样留到网络恢复
+	conn_get_stats(CONN_LINK_WIFI, &wifi);
+	if (!wifi.up) {
+		return;
+	}
+
+	if (influx_connect() != ESP_OK) {
+		stats.errors++;
+		return;
+	}
+
+	while (queue_count > 0) {
+		size_t len;
+		size_t n = influx_fill_datagram(datagram, sizeof(datagram), &len);
+
+		if (len > 0 && sendto(sock, datagram, len, 0, (struct sockaddr *)&server, sizeof(server)) < 0) {
+			//套接字可能因为网络切换失效，下个周期重新创建
+			ESP_LOGW(TAG, "Send to %s:%d failed", CONFIG_EXPORT_INFLUX_HOST, CONFIG_EXPORT_INFLUX_PORT);
+			stats.errors++;
+			close(sock);
+			sock = -1;
+			return;
+		}
+
+		if (len > 0) {
+			stats.datagrams++;
+			stats.lines += n;
+		}
+		queue_head = (queue_head + n) % INFLUX_QUEUE_LEN;
+		queue_count -= n;
+	}
+}
+
+static const exporter_t influx_exporter = {
+	.name = "influxdb udp://" CONFIG_EXPORT_INFLUX_HOST,
+	.export = influx_export_sample,
+	.flush = influx_flush,
+};
+#endif
+
+/* 描述：注册InfluxDB UDP导出后端，未打开CONFIG_EXPORT_INFLUX时不做任何事
+ * 返回值：注册失败返回ESP_ERR_NO_MEM */
+esp_err_t influx_init(void)
+{
+#ifdef CONFIG_EXPORT_INFLUX
+	return exporter_register(&influx_exporter);
+#else
+	return ESP_OK;
+#endif
+}
+
+/* 描述：获取InfluxDB后端的发送统计 */
+void influx_get_stats(influx_stats_t *out)
+{
+	*out = stats;
+}
@@ -0,0 +1,15 @@
+#ifndef __INFLUX_H__
+#define __INFLUX_H__
+#include <stdint.h>
+#include <esp_err.h>
+
+typedef struct {
+	uint32_t lines;             //已发送的采样行数
+	uint32_t datagrams;         //已发送的数据报数
+	uint32_t errors;            //地址解析或发送失败的次数
+	uint32_t dropped;           //缓存队列已满时丢弃的采样数
+} influx_stats_t;
+
+esp_err_t influx_init(void);
+void influx_get_stats(influx_stats_t *out);
+#endif
@@ -11,19 +11,49 @@
 #include <sht3x.h>
 
 #include "mqtt.h"
+#include "metrics.h"
+#include "bench.h"
+#include "influx.h"
 #include "time.h"
+#include "boot.h"
+#include "conn.h"
+#include "dlog.h"
 
 //日志标签
 static const char *TAG="MAIN";
 
-uint32_t sht3x_sn;
+//设备上的传感器，序号即上报采样中的sensor字段
+static const uint8_t sensor_addrs[] = {
+	CONFIG_SHT3X_DEVICE_ADDR,
+#ifdef CONFIG_SHT3X_SECOND_SENSOR
+	CONFIG_SHT3X_SECOND_DEVICE_ADDR,
+#endif
+};
+_Static_assert(sizeof(sensor_addrs) <= CONFIG_SHT3X_MAX_SENSORS, "SHT3X_MAX_SENSORS too small");
+
+sht3x_handle_t sensors[CONFIG_SHT3X_MAX_SENSORS];
+uint32_t sensor_sn[CONFIG_SHT3X_MAX_SENSORS];
+//第一个传感器启动后等于配置的传感器数，尚未启动的传感器在sensors[]中为NULL
+size_t sensor_count;
+//配置的传感器数，启动完成之前sensor_count为0
+const size_t sensor_configured = sizeof(sensor_addrs);
+uint8_t mac_addr[6];
 char mac_string[20];
 
-static void on_wifi_disconnect(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+//传感器全部启动失败时的重试次数和间隔，每次重试前恢复I2C总线，用完才重启
+#define SENSOR_START_RETRIES 3
+#define SENSOR_RETRY_MS 100
+//部分传感器已经启动后，其余传感器的后台重试间隔
+#define SENSOR_BACKGROUND_RETRY_MS 10000
+
+//连接事件只转交给连接状态机，由它决定何时重连Wi-Fi和启停MQTT
+static void on_wifi_event(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
 {
 	ESP_LOGW(TAG, "Wi-Fi event %d", event_id);
-	if(event_id==WIFI_EVENT_STA_DISCONNECTED) {
-		mqtt_app_stop();
+	if (event_id==WIFI_EVENT_STA_CONNECTED) {
+		conn_notify(CONN_EVENT_WIFI_UP);
+	} else if(event_id==WIFI_EVENT_STA_DISCONNECTED) {
+		conn_notify(CONN_EVENT_WIFI_DOWN);
 	}
 }
 
@@ -31,56 +61,152 @@ static void on_got_ip(void *arg, esp_event_base_t event_base, int32_t event_id,
 {
 	ESP_LOGW(TAG, "IP event %d", event_id);
 	if (event_id==IP_EVENT_STA_GOT_IP) {
-		mqtt_app_start();
+		boot_mark(BOOT_PHASE_NETWORK);
+		conn_notify(CONN_EVENT_IP_UP);
 	}
 }
 
+/* 描述：启动一个传感器：初始化、读取序列号并进入周期测量模式，第一个启动的传感器同时启动周期模式
+ * 重试时跳过已经初始化的步骤，驱动不允许重复初始化同一地址
+ * 参数i：传感器序号
+ * 返回值：成功返回ESP_OK */
+static esp_err_t sensor_start_one(size_t i)
+{
+	static sht3x_handle_t handles[CONFIG_SHT3X_MAX_SENSORS];
+	static bool periodic;
+	esp_err_t ret;
+
+	//所有传感器共用I2C_NUM_0，复位等待在驱动中完成
+	if (handles[i] == NULL) {
+		sht3x_config_t config = {
+			.port = I2C_NUM_0,
+			.sda_pin = CONFIG_SHT3X_I2C_SDA_PIN_NUM,
+			.scl_pin = CONFIG_SHT3X_I2C_SCL_PIN_NUM,
+			.addr = sensor_addrs[i],
+		};
+		ret = sht3x_init(&config, &handles[i]);
+		if (ret != ESP_OK) {
+			ESP_LOGE(TAG, "Fail to init SHT3X at 0x%02x: %X", sensor_addrs[i], ret);
+			return ret;
+		}
+	}
+
+	ret = SHT3x_ReadSerialNumber(handles[i], &sensor_sn[i]);
+	if(ret != ESP_OK) {
+		ESP_LOGE(TAG,"Read SerialNumber of 0x%02x failed", sensor_addrs[i]);
+		return ret;
+	}
+	ESP_LOGI(TAG, "Sensor SHT3X at 0x%02x SN=0x%x", sensor_addrs[i], sensor_sn[i]);
+
+	//进入周期测量模式，由驱动在后台持续采集
+	if (periodic) {
+		ret = sht3x_periodic_add(handles[i]);
+	} else {
+		ret = sht3x_periodic_start(&handles[i], 1, CONFIG_SHT3X_PERIODIC_MPS, CONFIG_SHT3X_PERIODIC_REPEATABILITY);
+	}
+	if(ret != ESP_OK) {
+		ESP_LOGE(TAG,"Start periodic mode at 0x%02x failed", sensor_addrs[i]);
+		return ret;
+	}
+	periodic = true;
+
+	//进入周期模式后才对上报可见
+	sensors[i] = handles[i];
+	return ESP_OK;
+}
+
+/* 描述：启动所有尚未启动的传感器
+ * 返回值：已启动的传感器数 */
+static size_t sensor_start(void)
+{
+	size_t started = 0;
+
+	for (size_t i = 0; i < sizeof(sensor_addrs); i++) {
+		if (sensors[i] != NULL || sensor_start_one(i) == ESP_OK) {
+			started++;
+		}
+	}
+	return started;
+}
+
+/* 描述：传感器启动任务，不依赖NVS和网络，与Wi-Fi连接并行进行，任一传感器启动后上报任务即开始采样
+ * 一个传感器都没有启动才重启；没有响应的传感器在后台继续重试，启动后加入周期采集 */
+static void sensor_start_task(void *arg)
+{
+	size_t started;
+
+	for (int retry = 0; (started = sensor_start()) == 0; retry++) {
+		if (retry == SENSOR_START_RETRIES) {
+			ESP_LOGE(TAG, "Sensor bring-up failed after %d retries, restart", retry);
+			esp_restart();
+		}
+		vTaskDelay(SENSOR_RETRY_MS / portTICK_PERIOD_MS);
+		//总线尚未安装时返回ESP_ERR_INVALID_STATE，下次重试会重新安装
+		sht3x_recover(I2C_NUM_0);
+	}
+
+	sensor_count = sizeof(sensor_addrs);
+	boot_mark(BOOT_PHASE_SENSOR);
+
+	//周期采集已在运行，不能再恢复总线，只重新初始化没有响应的传感器
+	while (started < sizeof(sensor_addrs)) {
+		ESP_LOGW(TAG, "%d of %d sensors running, retry the rest in %d ms", (int)started, (int)sizeof(sensor_addrs), SENSOR_BACKGROUND_RETRY_MS);
+		vTaskDelay(SENSOR_BACKGROUND_RETRY_MS / portTICK_PERIOD_MS);
+		started = sensor_start();
+	}
+	vTaskDelete(NULL);
+}
 
 void app_main()
 {
 	//用户层初始化
 	esp_err_t ret;
 
+#ifdef CONFIG_BENCH_IMAGE
+	//基准测试镜像不启动传感器和网络，只在串口输出结果
+	bench_run(NULL, 0);
+	return;
+#endif
+
+	//阶段依赖通过事件组表达，必须最先创建
+	boot_init();
+	//热路径日志写入内存缓冲区，由低优先级任务输出
+	dlog_init();
+	xTaskCreate(sensor_start_task, "sensor_start_task", 2048, NULL, 5, NULL);
+
 	//系统层初始化，失败直接panic
     ESP_ERROR_CHECK(nvs_flash_init());
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
 
-	//芯片初始化
-	ret = sht3x_mode_init();
-	if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Fail to init SHT3X: %X", ret);
-		vTaskDelay(3000 / portTICK_PERIOD_MS);
-		esp_restart();
-	}
-
-	vTaskDelay(1000 / portTICK_PERIOD_MS);
-	//读取传感器序列号
-	ret = SHT3x_ReadSerialNumber(&sht3x_sn);
-	if(ret != ESP_OK) {
-		ESP_LOGE(TAG,"Read SerialNumber failed");
-		vTaskDelay(3000 / portTICK_PERIOD_MS);
-		esp_restart();
-	}
-
-	ESP_LOGI(TAG, "Sensor SHT3X SN=0x%x", sht3x_sn);
-
 	//读取MAC地址并转换成字符串
-	uint8_t mac_buffer[6];
-	esp_efuse_mac_get_default(mac_buffer);
-	sprintf(mac_string, "%02X:%02X:%02X:%02X:%02X:%02X", mac_buffer[0],mac_buffer[1],mac_buffer[2],mac_buffer[3],mac_buffer[4],mac_buffer[5]);
+	esp_efuse_mac_get_default(mac_addr);
+	sprintf(mac_string, "%02X:%02X:%02X:%02X:%02X:%02X", mac_addr[0],mac_addr[1],mac_addr[2],mac_addr[3],mac_addr[4],mac_addr[5]);
 	ESP_LOGI(TAG, "MAC address %s", mac_string);
 
-	ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &on_wifi_disconnect, NULL))
+	ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &on_wifi_event, NULL))
 	ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, ESP_EVENT_ANY_ID, &on_got_ip, NULL))
 
+	//Prometheus指标服务，抓取时只读取缓存，不影响上报
+	ret = metrics_server_start();
+	if (ret != ESP_OK) {
+		ESP_LOGE(TAG, "Fail to start metrics server: %X", ret);
+	}
+	influx_init();
+
+	//上报任务在传感器就绪之后才开始采样，MQTT后端最后注册
     mqtt_app_init();
+	boot_mark(BOOT_PHASE_SYSTEM);
+
+	//SNTP只依赖IP，与MQTT连接并行，同步完成前采样只记录单调时间，同步后换算为UTC时间
+	time_init();
 
-	//所有初始化完成方可联网
+	//接管重连，断线后按MAC错开的退避时间重试
+	conn_init(mac_addr);
+
+	//阻塞到获取IP，此时传感器仍在并行启动，MQTT由连接状态机在获取IP后启动
 	ret = example_connect();
 	if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Fail to connect WiFi: %X", ret);
 	}
-
-	wait_time_sync();
 }
@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_log.h>
+#include <esp_http_server.h>
+
+#include "metrics.h"
+#include "exporter.h"
+
+extern uint32_t sensor_sn[];
+extern char mac_string[20];
+
+static const char *TAG = "main.metrics";
+
+/* Prometheus指标缓存
+ * 每条新采样时在上报任务中渲染一次文本，抓取时直接发送缓存内容，不访问I2C、不格式化、不申请内存。
+ * 使用两块缓冲区：抓取方只读取当前生效的一块并持有引用计数，上报任务只渲染另一块，
+ * 渲染完成后再切换生效缓冲区；另一块仍被抓取方引用时本次渲染跳过，不会阻塞上报任务 */
+#define METRICS_TEXT_MAX 1536
+
+typedef struct {
+	char text[METRICS_TEXT_MAX];
+	int len;
+	int readers;
+} metrics_buf_t;
+
+static metrics_buf_t bufs[2];
+static int active = -1;
+static uint32_t render_skipped;
+
+//按序号排列的各传感器最新采样，只在上报任务中访问
+static payload_sample_t latest[CONFIG_SHT3X_MAX_SENSORS];
+static bool has_latest[CONFIG_SHT3X_MAX_SENSORS];
+
+//渲染一个指标族：HELP、TYPE和每个传感器一行
+static int metrics_render_family(char *text, size_t size, const char *name, const char *help, int field)
+{
+	int len = snprintf(text, size, "# HELP %s %s\n# TYPE %s gauge\n", name, help, name);
+
+	for (int i = 0; i < CONFIG_SHT3X_MAX_SENSORS && len >= 0 && len < size; i++) {
+		if (!has_latest[i]) {
+			continue;
+		}
+		int64_t value = field == 0 ? latest[i].temperature : field == 1 ? latest[i].humiture : latest[i].mono_ms;
+		int n;
+		if (value >= 1000) {
+			//开机时间超过int32范围，不依赖printf的64位整数支持，高位和低三位分开输出
+			n = snprintf(text + len, size - len, "%s{sn=\"%u\",mac=\"%s\"} %u%03u\n", name, sensor_sn[i], mac_string,
+					(unsigned)(value / 1000), (unsigned)(value % 1000));
+		} else {
+			n = snprintf(text + len, size - len, "%s{sn=\"%u\",mac=\"%s\"} %d\n", name, sensor_sn[i], mac_string, (int)value);
+		}
+		len = n < 0 ? -1 : len + n;
+	}
+
+	return len;
+}
+
+/* 描述：Prometheus后端收到采样，根据最新采样渲染指标文本，在上报任务中调用
+ * 参数sample：某个传感器的最新采样 */
+static void metrics_update(const payload_sample_t *sample)
+{
+	int target = active == 0 ? 1 : 0;
+
+	if (sample->sensor < CONFIG_SHT3X_MAX_SENSORS) {
+		latest[sample->sensor] = *sample;
+		has_latest[sample->sensor] = true;
+	}
+
+	taskENTER_CRITICAL();
+	bool busy = bufs[target].readers > 0;
+	taskEXIT_CRITICAL();
+
+	if (busy) {
+		render_skipped++;
+		return;
+	}
+
+	metrics_buf_t *buf = &bufs[target];
+	int len = 0;
+	const struct {
+		const char *name;
+		const char *help;
+	} families[] = {
+		{"sht3x_temperature", "Temperature in 0.01 degree Celsius"},
+		{"sht3x_humidity", "Relative humidity in 0.01 percent"},
+		{"sht3x_sample_uptime_ms", "Uptime in milliseconds when the sample was taken"},
+	};
+	for (int i = 0; i < sizeof(families) / sizeof(families[0]) && len >= 0 && len < sizeof(buf->text); i++) {
+		int n = metrics_render_family(buf->text + len, sizeof(buf->text) - len, families[i].name, families[i].help, i);
+		len = n < 0 ? -1 : len + n;
+	}
+	if (len >= 0 && len < sizeof(buf->text)) {
+		int n = snprintf(buf->text + len, sizeof(buf->text) - len,
+				"# HELP thermometer_metrics_render_skipped_total Renders skipped because both buffers were busy\n"
+				"# TYPE thermometer_metrics_render_skipped_total counter\n"
+				"thermometer_metrics_render_skipped_total %u\n",
+				render_skipped);
+		len = n < 0 ? -1 : len + n;
+	}
+	if (len < 0 || len >= sizeof(buf->text)) {
+		ESP_LOGE(TAG, "Metrics text too large");
+		return;
+	}
+	buf->len = len;
+
+	taskENTER_CRITICAL();
+	active = target;
+	taskEXIT_CRITICAL();
+}
+
+static esp_err_t metrics_get_handler(httpd_req_t *req)
+{
+	taskENTER_CRITICAL();
+	int i = active;
+	if (i >= 0) {
+		bufs[i].readers++;
+	}
+	taskEXIT_CRITICAL();
+
+	if (i < 0) {
+		httpd_resp_set_status(req, "503 Service Unavailable");
+		return httpd_resp_send(req, NULL, 0);
+	}
+
+	httpd_resp_set_type(req, "text/plain; version=0.0.4");
+	esp_err_t ret = httpd_resp_send(req, bufs[i].text, bufs[i].len);
+
+	taskENTER_CRITICAL();
+	bufs[i].readers--;
+	taskEXIT_CRITICAL();
+
+	return ret;
+}
+
+/* 描述：启动HTTP服务，在/metrics路径暴露Prometheus指标
+ * 返回值：成功返回ESP_OK */
+esp_err_t metrics_server_start(void)
+{
+	httpd_handle_t server = NULL;
+	httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+	config.server_port = CONFIG_METRICS_HTTP_PORT;
+
+	esp_err_t ret = httpd_start(&server, &config);
+	if (ret != ESP_OK) {
+		ESP_LOGE(TAG, "Fail to start HTTP server: %s", esp_err_to_name(ret));
+		return ret;
+	}
+
+	httpd_uri_t metrics_uri = {
+		.uri = "/metrics",
+		.method = HTTP_GET,
+		.handler = metrics_get_handler,
+		.user_ctx = NULL,
+	};
+
+	ESP_LOGI(TAG, "Serve metrics on port %d", config.server_port);
+	ret = httpd_register_uri_handler(server, &metrics_uri);
+	if (ret != ESP_OK) {
+		return ret;
+	}
+
+	//抓取时只读取缓存，不需要flush
+	static const exporter_t metrics_exporter = {
+		.name = "prometheus",
+		.export = metrics_update,
+	};
+	return exporter_register(&metrics_exporter);
+}
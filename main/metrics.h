@@ -0,0 +1,6 @@
+#ifndef __METRICS_H__
+#define __METRICS_H__
+#include <esp_err.h>
+
+esp_err_t metrics_server_start(void);
+#endif
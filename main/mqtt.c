@@ -1,7 +1,9 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include <stddef.h>
 #include <string.h>
+#include <sys/param.h>
 #include <esp_wifi.h>
 #include <esp_system.h>
 #include <nvs_flash.h>
@@ -15,88 +17,592 @@
 #include <lwip/sockets.h>
 #include <lwip/dns.h>
 #include <lwip/netdb.h>
-#include <cJSON.h>
 #include <esp_log.h>
 #include <protocol_examples_common.h>
 #include <sht3x.h>
 
 #include "mqtt_client.h"
+#include "mqtt.h"
+#include "payload.h"
+#include "sample_queue.h"
+#include "flash_log.h"
+#include "sched.h"
+#include "telemetry.h"
+#include "command.h"
+#include "boot.h"
+#include "inflight.h"
+#include "conn.h"
+#include "dlog.h"
+#include "exporter.h"
+#include "time.h"
+#include "summary.h"
 
 char *platform_create_id_string(void);
-extern uint32_t sht3x_sn;
+extern sht3x_handle_t sensors[];
+extern uint32_t sensor_sn[];
+extern size_t sensor_count;
+extern const size_t sensor_configured;
+extern uint8_t mac_addr[6];
 extern char mac_string[20];
 
 static const char *TAG = "main.mqtt";
+
+//第一个上报周期等待滤波结果可用的检查间隔
+#define FIRST_CYCLE_POLL_MS 100
 static esp_mqtt_client_handle_t client = NULL;
+//发布函数，基准测试替换为不经过网络的桩函数
+static mqtt_publish_fn_t publish = esp_mqtt_client_publish;
 
-//数据上报间隔，默认10s
+//数据采样间隔，默认10s
 static bool mqtt_client_connected;
 static uint32_t report_period_ms=10000;
 
-esp_err_t mqtt_message_handler(cJSON *message)
+//批量上报阈值：队列中积累batch_count条采样，或最旧的采样等待超过batch_age_ms，即发布一次
+static uint32_t batch_count=CONFIG_REPORT_BATCH_COUNT;
+static uint32_t batch_age_ms=CONFIG_REPORT_BATCH_AGE_MS;
+
+//死区上报：温度或湿度相对上次入队的采样变化超过死区，或距上次入队超过max_silence_ms时，采样才进入待上报队列
+//死区为0表示每条采样都上报，单位均为0.01
+static uint32_t deadband_temperature=CONFIG_REPORT_DEADBAND_TEMPERATURE;
+static uint32_t deadband_humiture=CONFIG_REPORT_DEADBAND_HUMITURE;
+static uint32_t max_silence_ms=CONFIG_REPORT_MAX_SILENCE_MS;
+static uint32_t deadband_suppressed;
+
+//统计窗口：不为0时每个窗口为每个传感器发布一条统计结果，不再发布逐条采样
+static uint32_t report_window_ms=CONFIG_REPORT_WINDOW_MS;
+
+//上报消息的QoS，为1时最多CONFIG_REPORT_INFLIGHT_MAX条消息等待PUBACK
+static uint32_t report_qos=CONFIG_REPORT_QOS;
+
+//上报格式，可通过set_format命令按设备修改
+static payload_format_t report_format=CONFIG_REPORT_FORMAT;
+
+//每批采样最多产生的消息数：每个传感器每种格式一条，QoS 1时必须能同时放进发布窗口
+#ifdef CONFIG_SHT3X_SECOND_SENSOR
+#define REPORT_SENSOR_NUM 2
+#else
+#define REPORT_SENSOR_NUM 1
+#endif
+#if CONFIG_REPORT_QOS == 1 && REPORT_SENSOR_NUM * (CONFIG_REPORT_FORMAT == 2 ? 2 : 1) > CONFIG_REPORT_INFLIGHT_MAX
+#error "REPORT_INFLIGHT_MAX must hold one QoS 1 message per sensor and report format"
+#endif
+
+static size_t mqtt_batch_messages(payload_format_t format)
+{
+	return sensor_configured * (format == PAYLOAD_FORMAT_BOTH ? 2 : 1);
+}
+
+static const char *report_format_names[] = {
+	[PAYLOAD_FORMAT_JSON] = "json",
+	[PAYLOAD_FORMAT_BINARY] = "binary",
+	[PAYLOAD_FORMAT_BOTH] = "both",
+};
+
+static esp_err_t mqtt_set_format(const command_arg_t *arg)
 {
-	cJSON *cmd = cJSON_GetObjectItemCaseSensitive(message, "cmd");
-	if (!cJSON_IsString(cmd) || cmd->valuestring == NULL) {
-		ESP_LOGE(TAG, "Message cmd is empty");
-		return ESP_ERR_INVALID_ARG;
+	for (int i = 0; i < sizeof(report_format_names) / sizeof(report_format_names[0]); i++) {
+		if (strlen(report_format_names[i]) == arg->string_len && memcmp(report_format_names[i], arg->string, arg->string_len) == 0) {
+			//QoS 1时一批采样的消息必须能同时放进发布窗口，否则永远无法发布
+			if (report_qos == 1 && mqtt_batch_messages(i) > CONFIG_REPORT_INFLIGHT_MAX) {
+				return ESP_ERR_INVALID_SIZE;
+			}
+			report_format = i;
+			return ESP_OK;
+		}
 	}
 
-	ESP_LOGE(TAG, "Get new cmd %s from MQTT", cmd->valuestring);
+	return ESP_ERR_INVALID_ARG;
+}
 
-	if (strcmp("set_period", cmd->valuestring)) {
-		ESP_LOGE(TAG, "Message type %s is not support", cmd->valuestring);
-		return ESP_ERR_INVALID_ARG;
+static esp_err_t mqtt_set_period(const command_arg_t *arg)
+{
+	report_period_ms = arg->number;
+	return ESP_OK;
+}
+
+static esp_err_t mqtt_set_qos(const command_arg_t *arg)
+{
+	if (arg->number == 1 && mqtt_batch_messages(report_format) > CONFIG_REPORT_INFLIGHT_MAX) {
+		return ESP_ERR_INVALID_SIZE;
 	}
+	report_qos = arg->number;
+	return ESP_OK;
+}
 
-	cJSON *value = cJSON_GetObjectItemCaseSensitive(message, "value");
-	if (!cJSON_IsNumber(value) || value->valueint == 0) {
-		ESP_LOGE(TAG, "Message value is empty");
-		return ESP_ERR_INVALID_ARG;
+static esp_err_t mqtt_set_batch_count(const command_arg_t *arg)
+{
+	batch_count = arg->number;
+	return ESP_OK;
+}
+
+static esp_err_t mqtt_set_batch_age(const command_arg_t *arg)
+{
+	batch_age_ms = arg->number;
+	return ESP_OK;
+}
+
+static esp_err_t mqtt_set_deadband_temperature(const command_arg_t *arg)
+{
+	deadband_temperature = arg->number;
+	return ESP_OK;
+}
+
+static esp_err_t mqtt_set_deadband_humiture(const command_arg_t *arg)
+{
+	deadband_humiture = arg->number;
+	return ESP_OK;
+}
+
+static esp_err_t mqtt_set_max_silence(const command_arg_t *arg)
+{
+	max_silence_ms = arg->number;
+	return ESP_OK;
+}
+
+static esp_err_t mqtt_set_window(const command_arg_t *arg)
+{
+	report_window_ms = arg->number;
+	return ESP_OK;
+}
+
+/* 描述：把一条延迟日志消息发布到/devices/<mac>/log，在日志任务中调用
+ * 返回值：未连接或发布失败返回false，日志改为在本地输出 */
+static bool mqtt_publish_log(const uint8_t *data, size_t len)
+{
+	char topic[50];
+
+	if (!mqtt_client_connected) {
+		return false;
 	}
 
-	ESP_LOGE(TAG, "Get new cmd %s with value %d from MQTT", cmd->valuestring, value->valueint);
+	sprintf(topic, "/devices/%s/log", mac_string);
+	return publish(client, topic, (const char *)data, len, 0, 0) >= 0;
+}
 
-	report_period_ms = value->valueint;
+static esp_err_t mqtt_set_log_stream(const command_arg_t *arg)
+{
+	dlog_set_stream(arg->number ? mqtt_publish_log : NULL);
+	return ESP_OK;
+}
+
+//设备支持的命令，参数范围由分发器统一检查，死区可以设为0关闭，其余参数必须为正数
+static const command_t mqtt_commands[] = {
+	{"set_period",               COMMAND_ARG_INT,    100, INT32_MAX,               "period",      mqtt_set_period},
+	{"set_format",               COMMAND_ARG_STRING, 0,   0,                       "format",      mqtt_set_format},
+	{"set_qos",                  COMMAND_ARG_INT,    0,   1,                       "qos",         mqtt_set_qos},
+	{"set_batch_count",          COMMAND_ARG_INT,    1,   CONFIG_REPORT_BATCH_MAX, "batch_count", mqtt_set_batch_count},
+	{"set_batch_age",            COMMAND_ARG_INT,    1,   INT32_MAX,               "batch_age",   mqtt_set_batch_age},
+	{"set_deadband_temperature", COMMAND_ARG_INT,    0,   16500,                   "db_temp",     mqtt_set_deadband_temperature},
+	{"set_deadband_humiture",    COMMAND_ARG_INT,    0,   10000,                   "db_humi",     mqtt_set_deadband_humiture},
+	{"set_max_silence",          COMMAND_ARG_INT,    1,   INT32_MAX,               "max_silence", mqtt_set_max_silence},
+	{"set_window",               COMMAND_ARG_INT,    0,   3600000,                 "window",      mqtt_set_window},
+	{"set_log_stream",           COMMAND_ARG_INT,    0,   1,                       NULL,          mqtt_set_log_stream},
+};
+
+/* 描述：判断采样是否需要上报
+ * 与上次入队的采样比较而不是与上一条采样比较，缓慢漂移累计超过死区后同样会上报
+ * 参数sample：最新采样 */
+static bool mqtt_sample_changed(const payload_sample_t *sample)
+{
+	static payload_sample_t last[CONFIG_SHT3X_MAX_SENSORS];
+	static bool has_last[CONFIG_SHT3X_MAX_SENSORS];
+	payload_sample_t *prev = &last[sample->sensor];
+
+	if (has_last[sample->sensor] && sample->mono_ms - prev->mono_ms < max_silence_ms &&
+			abs(sample->temperature - prev->temperature) < deadband_temperature &&
+			abs((int)sample->humiture - (int)prev->humiture) < deadband_humiture) {
+		deadband_suppressed++;
+		return false;
+	}
+
+	*prev = *sample;
+	has_last[sample->sensor] = true;
+	return true;
+}
+
+/* 描述：MQTT后端收到一条采样，超出死区时放入待上报队列
+ * 参数sample：最新采样 */
+static void mqtt_export_sample(const payload_sample_t *sample)
+{
+	//统计模式下只发布窗口统计结果，其他后端仍然收到每条采样
+	if (report_window_ms > 0) {
+		return;
+	}
+
+	if (!mqtt_sample_changed(sample)) {
+		DLOGI(SAMPLE_SUPPRESSED, sample->sensor, SHT3X_CENTI_ARGS(sample->temperature), SHT3X_CENTI_ARGS(sample->humiture), deadband_suppressed);
+		return;
+	}
+
+	sample_queue_push(sample);
+	DLOGI(SAMPLE_QUEUED, sample->sensor, SHT3X_CENTI_ARGS(sample->temperature), SHT3X_CENTI_ARGS(sample->humiture), (int)sample_queue_count());
+}
+
+/* 描述：从每个传感器采集一条最新数据，交给所有导出后端
+ * 尚未启动或已经失效的传感器跳过，由启动任务和驱动在后台继续重试，没有一个可用的传感器时才重启 */
+esp_err_t mqtt_sample_data(void)
+{
+	esp_err_t ret = ESP_OK;
+	size_t usable = 0;
+	//同步之前time_ms为0，上报或转存时再按单调时间换算
+	int64_t mono = time_mono_ms();
+	int64_t epoch = time_epoch_ms(mono);
+
+	for (int i = 0; i < sensor_count; i++) {
+		//温湿度均为0.01单位的整数，整个上报流程不使用浮点运算
+		payload_sample_t sample = {.mono_ms = mono, .time_ms = epoch, .sensor = i};
+		if (sensors[i] == NULL) {
+			continue;
+		}
+		//驱动已用完所有恢复手段，仍按周期尝试读取，读到数据后自动恢复
+		if (sht3x_is_failed(sensors[i])) {
+			ESP_LOGE(TAG, "Sensor %d unrecoverable, skipped", i);
+			ret = ESP_FAIL;
+			continue;
+		}
+		usable++;
+		if (sht3x_get_humiture_periodic(sensors[i], &sample.temperature, &sample.humiture, &sample.count) != 0) {
+			ESP_LOGE(TAG,"Fail to get Humiture of sensor %d", i);
+			ret = ESP_FAIL;
+			continue;
+		}
+
+		boot_mark(BOOT_PHASE_FIRST_SAMPLE);
+		exporter_export(&sample);
+	}
+
+	if (usable == 0) {
+		ESP_LOGE(TAG, "No usable sensor, restart");
+		esp_restart();
+	}
+
+	return ret;
+}
+
+/* 描述：判断队列中的采样是否达到批量上报阈值 */
+static bool mqtt_batch_ready(void)
+{
+	payload_sample_t oldest;
+
+	if (sample_queue_count() >= batch_count) {
+		return true;
+	}
+
+	if (sample_queue_peek(&oldest, 1) == 0) {
+		return false;
+	}
+
+	return time_mono_ms() - oldest.mono_ms >= batch_age_ms;
+}
+
+/* 描述：按当前的上报QoS发布一条上报消息，QoS 1时在发布前预留窗口中的空位，PUBACK早于返回也能对上
+ * 参数topic：主题
+ * 参数data：消息内容
+ * 参数len：消息长度
+ * 参数msg_id：存储消息ID的指针
+ * 返回值：QoS 1发布窗口没有空位时返回ESP_ERR_NO_MEM，不发布；发布失败返回ESP_FAIL */
+static esp_err_t mqtt_publish_qos(const char *topic, const char *data, int len, int *msg_id)
+{
+	int slot = -1;
+
+	if (report_qos == 1) {
+		slot = inflight_reserve();
+		if (slot < 0) {
+			inflight_record_full();
+			return ESP_ERR_NO_MEM;
+		}
+	}
+
+	*msg_id = publish(client, topic, data, len, report_qos, 0);
+	telemetry_record_publish(*msg_id >= 0);
+	if (slot >= 0) {
+		if (*msg_id < 0) {
+			inflight_release(slot);
+		} else {
+			inflight_commit(slot, *msg_id);
+		}
+	}
+	return *msg_id < 0 ? ESP_FAIL : ESP_OK;
+}
+
+/* 描述：把同一个传感器的若干条采样作为一条消息发布
+ * 参数sn：传感器序列号
+ * 参数samples：采样数组，按从旧到新排列
+ * 参数count：采样条数，不超过CONFIG_REPORT_BATCH_MAX */
+static esp_err_t mqtt_publish_report(uint32_t sn, const payload_sample_t *samples, size_t count)
+{
+	payload_report_t report = {
+		.mac = mac_string,
+		.mac_addr = mac_addr,
+		.sn = sn,
+		.samples = samples,
+		.count = count,
+	};
+
+	//直接编码到静态缓冲区，上报过程不申请堆内存
+	if (report_format != PAYLOAD_FORMAT_BINARY) {
+		static char out[PAYLOAD_JSON_LEN(CONFIG_REPORT_BATCH_MAX)];
+		int len = payload_encode_json(out, sizeof(out), &report);
+		if (len < 0) {
+			ESP_LOGE(TAG, "Report payload too large");
+			return ESP_ERR_INVALID_SIZE;
+		}
+
+		int msg_id;
+		esp_err_t ret = mqtt_publish_qos("/sensor/temperature", out, len, &msg_id);
+		if (ret != ESP_OK) {
+			return ret;
+		}
+		DLOGI(PUBLISH_JSON, msg_id);
+	}
+
+	if (report_format != PAYLOAD_FORMAT_JSON) {
+		static uint8_t bin[PAYLOAD_BINARY_LEN(CONFIG_REPORT_BATCH_MAX)];
+		int len = payload_encode_binary(bin, sizeof(bin), &report);
+		if (len < 0) {
+			ESP_LOGE(TAG, "Binary report payload too large");
+			return ESP_ERR_INVALID_SIZE;
+		}
+
+		int msg_id;
+		esp_err_t ret = mqtt_publish_qos("/sensor/temperature/bin", (const char *)bin, len, &msg_id);
+		if (ret != ESP_OK) {
+			return ret;
+		}
+		DLOGI(PUBLISH_BINARY, msg_id);
+	}
 
 	return ESP_OK;
 }
 
+/* 描述：QoS 1时检查发布窗口能否容纳一批采样产生的所有消息
+ * 窗口不足时整批推迟，不会只发布其中一部分；一批的消息数在配置和命令中限制为不超过窗口大小
+ * 参数samples：采样数组
+ * 参数count：采样条数 */
+static bool mqtt_window_ready(const payload_sample_t *samples, size_t count)
+{
+	size_t messages = 0;
+
+	if (report_qos == 0) {
+		return true;
+	}
+
+	inflight_expire(CONFIG_REPORT_ACK_TIMEOUT_MS);
+
+	for (size_t sensor = 0; sensor < sensor_count; sensor++) {
+		for (size_t i = 0; i < count; i++) {
+			if (samples[i].sensor == sensor) {
+				messages++;
+				break;
+			}
+		}
+	}
+	if (report_format == PAYLOAD_FORMAT_BOTH) {
+		messages *= 2;
+	}
+
+	if (inflight_free() >= messages) {
+		return true;
+	}
+
+	inflight_record_full();
+	DLOGW(WINDOW_FULL, (int)sample_queue_count());
+	return false;
+}
+
+/* 描述：把一批采样按传感器分组，每个传感器发布一条消息
+ * 某个传感器发布失败时整批保留，已发布的传感器在重试时会重复发布
+ * 参数samples：采样数组，按从旧到新排列
+ * 参数count：采样条数，不超过CONFIG_REPORT_BATCH_MAX
+ * 返回值：QoS 1发布窗口已满时返回ESP_ERR_NO_MEM，采样需要保留 */
+static esp_err_t mqtt_publish_samples(const payload_sample_t *samples, size_t count)
+{
+	static payload_sample_t group[CONFIG_REPORT_BATCH_MAX];
+
+	if (!mqtt_window_ready(samples, count)) {
+		return ESP_ERR_NO_MEM;
+	}
+
+	for (size_t sensor = 0; sensor < sensor_count; sensor++) {
+		size_t n = 0;
+		for (size_t i = 0; i < count; i++) {
+			if (samples[i].sensor == sensor) {
+				group[n++] = samples[i];
+			}
+		}
+
+		if (n > 0) {
+			esp_err_t ret = mqtt_publish_report(sensor_sn[sensor], group, n);
+			if (ret != ESP_OK) {
+				return ret;
+			}
+		}
+	}
+
+	return ESP_OK;
+}
+
+/* 描述：把队列中最旧的一批采样发布，发布成功后移出队列 */
 esp_err_t mqtt_publish_data(void)
 {
-	esp_err_t ret;
+	static payload_sample_t samples[CONFIG_REPORT_BATCH_MAX];
+	size_t count = sample_queue_peek(samples, CONFIG_REPORT_BATCH_MAX);
+	if (count == 0) {
+		return ESP_OK;
+	}
 
-	float temperature,humiture;
-	ret = sht3x_get_humiture_periodic(&temperature,&humiture);
+	//时间同步之前采集的采样在这里补上UTC时间
+	for (size_t i = 0; i < count; i++) {
+		if (samples[i].time_ms == 0) {
+			samples[i].time_ms = time_epoch_ms(samples[i].mono_ms);
+		}
+	}
+
+	esp_err_t ret = mqtt_publish_samples(samples, count);
 	if (ret != ESP_OK) {
-		ESP_LOGE(TAG,"Fail to get Humiture failed");
 		return ret;
 	}
 
-	ESP_LOGI(TAG,"temperature:%.2f °C, humidity:%.2f %%",temperature,humiture);
+	//Flash中补发的采样可能来自之前的开机周期，只统计实时队列的延迟
+	int64_t now = time_mono_ms();
+	for (size_t i = 0; i < count; i++) {
+		telemetry_record_latency(now - samples[i].mono_ms);
+	}
 
-	cJSON *data = cJSON_CreateObject();
-	cJSON_AddNumberToObject(data,"temperature",temperature);
-	cJSON_AddNumberToObject(data,"humiture",humiture);
+	sample_queue_pop(count);
+	return ESP_OK;
+}
 
-	cJSON *message = cJSON_CreateObject();   //创建根数据对象
-	cJSON_AddStringToObject(message, "type", "report");
-	cJSON_AddStringToObject(message, "mac", mac_string);
-	cJSON_AddNumberToObject(message, "sn", sht3x_sn);
-	cJSON_AddNumberToObject(message, "up", esp_log_early_timestamp());
-	cJSON_AddItemToObject(message, "data", data);
+/* 描述：发布队列中的窗口统计结果，每条一个消息，只有JSON格式
+ * 返回值：QoS 1发布窗口已满时返回ESP_ERR_NO_MEM，未发布的统计结果留在队列中 */
+static esp_err_t mqtt_publish_summaries(void)
+{
+	static char out[PAYLOAD_SUMMARY_JSON_LEN];
+	payload_summary_t summary;
+
+	while (summary_peek(&summary, 1)) {
+		if (report_qos == 1) {
+			inflight_expire(CONFIG_REPORT_ACK_TIMEOUT_MS);
+			if (inflight_free() == 0) {
+				inflight_record_full();
+				DLOGW(WINDOW_FULL, (int)summary_count());
+				return ESP_ERR_NO_MEM;
+			}
+		}
 
-	char *out = cJSON_Print(message);
+		//时间同步之前结束的窗口在这里补上UTC时间
+		if (summary.time_ms == 0) {
+			summary.time_ms = time_epoch_ms(summary.mono_ms);
+		}
 
-	int msg_id = esp_mqtt_client_publish(client, "/sensor/temperature", out, 0, 0, 0);
-	cJSON_free(out);
+		int len = payload_encode_summary_json(out, sizeof(out), mac_string, sensor_sn[summary.sensor], &summary);
+		if (len < 0) {
+			ESP_LOGE(TAG, "Summary payload too large");
+			summary_pop(1);
+			continue;
+		}
 
-	ESP_LOGI(TAG, "sent publish successful, msg_id=%d", msg_id);
+		int msg_id;
+		esp_err_t ret = mqtt_publish_qos("/sensor/temperature", out, len, &msg_id);
+		if (ret != ESP_OK) {
+			return ret;
+		}
+		DLOGI(PUBLISH_JSON, msg_id);
 
-	cJSON_Delete(message);
+		telemetry_record_latency(time_mono_ms() - summary.mono_ms);
+		summary_pop(1);
+	}
 
 	return ESP_OK;
 }
 
+/* 描述：离线时把内存队列中的采样转存到Flash日志，Flash不可用时采样继续留在内存队列 */
+static void mqtt_spill_to_flash(void)
+{
+	payload_sample_t sample;
+
+	while (sample_queue_peek(&sample, 1)) {
+		if (sample.time_ms == 0) {
+			sample.time_ms = time_epoch_ms(sample.mono_ms);
+		}
+		if (flash_log_append(&sample) != ESP_OK) {
+			break;
+		}
+		sample_queue_pop(1);
+	}
+}
+
+/* 描述：恢复连接后按从旧到新的顺序补发Flash日志中的采样
+ * 每个上报周期最多补发CONFIG_FLASH_LOG_DRAIN_BATCHES条消息，避免影响实时上报 */
+static void mqtt_drain_flash(void)
+{
+	static payload_sample_t samples[CONFIG_REPORT_BATCH_MAX];
+
+	for (int i = 0; i < CONFIG_FLASH_LOG_DRAIN_BATCHES && flash_log_depth() > 0; i++) {
+		size_t count = flash_log_peek(samples, CONFIG_FLASH_LOG_DRAIN_BATCH);
+		esp_err_t ret = count > 0 ? mqtt_publish_samples(samples, count) : ESP_OK;
+		if (ret != ESP_OK) {
+			//发布窗口已满时等下个周期再补发
+			if (ret != ESP_ERR_NO_MEM) {
+				ESP_LOGE(TAG, "Drain sample log failed");
+			}
+			return;
+		}
+
+		if (flash_log_consume() != ESP_OK) {
+			ESP_LOGE(TAG, "Fail to mark sample log consumed");
+			return;
+		}
+	}
+}
+
+/* 描述：第一次上报成功后发布一次开机时间线，用于统计开机到首次上报的时间，发布失败时下个周期重试 */
+static void mqtt_publish_boot(void)
+{
+	static bool published;
+	static char out[BOOT_JSON_LEN];
+
+	if (published) {
+		return;
+	}
+
+	boot_mark(BOOT_PHASE_FIRST_REPORT);
+	int len = boot_encode_json(out, sizeof(out));
+	if (len < 0) {
+		ESP_LOGE(TAG, "Boot trace payload too large");
+		published = true;
+		return;
+	}
+
+	int msg_id = publish(client, "/sensor/boot", out, len, 0, 0);
+	telemetry_record_publish(msg_id >= 0);
+	published = msg_id >= 0;
+}
+
+/* 描述：按CONFIG_TELEMETRY_PERIOD_MS周期发布设备自身运行指标，为0时不发布 */
+static void mqtt_publish_telemetry(void)
+{
+	static uint32_t last_ms;
+	static char out[TELEMETRY_JSON_LEN];
+
+	uint32_t now = esp_log_early_timestamp();
+	if (CONFIG_TELEMETRY_PERIOD_MS == 0 || (last_ms != 0 && now - last_ms < CONFIG_TELEMETRY_PERIOD_MS)) {
+		return;
+	}
+
+	int len = telemetry_encode_json(out, sizeof(out));
+	if (len < 0) {
+		ESP_LOGE(TAG, "Telemetry payload too large");
+		return;
+	}
+
+	int msg_id = publish(client, "/sensor/telemetry", out, len, 0, 0);
+	telemetry_record_publish(msg_id >= 0);
+	if (msg_id >= 0) {
+		last_ms = now;
+	}
+}
+
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
 {
 	char topic[50];
@@ -112,60 +618,158 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
 			ESP_LOGW(TAG, "MQTT connect, subscribe to %s, and enable report loop", topic);
 
 			mqtt_client_connected = true;
+			boot_mark(BOOT_PHASE_MQTT);
+			conn_notify(CONN_EVENT_MQTT_UP);
 			break;
 
 		case MQTT_EVENT_DISCONNECTED:
 			ESP_LOGW(TAG, "MQTT disconnect, disable report loop");
 			mqtt_client_connected = false;
+			conn_notify(CONN_EVENT_MQTT_DOWN);
 			break;
 
-		case MQTT_EVENT_DATA:
-			ESP_LOGI(TAG, "TOPIC=%.*s DATA=%.*s", event->topic_len, event->topic, event->data_len, event->data);
-			cJSON *message = cJSON_Parse(event->data);
-			if (message == NULL) {
-				ESP_LOGE("Invalid MQTT Message %s",cJSON_GetErrorPtr());
+		case MQTT_EVENT_PUBLISHED:
+			inflight_ack(event->msg_id);
+			break;
+
+		case MQTT_EVENT_DATA: {
+			static char reply[COMMAND_REPLY_LEN];
+
+			//超过MQTT接收缓冲区的消息会分片到达，命令不会这么长，整条丢弃，只在第一片时记录一次
+			if (event->data_len != event->total_data_len) {
+				if (event->current_data_offset == 0) {
+					ESP_LOGE(TAG, "Fragmented message of %d bytes on %.*s dropped", event->total_data_len, event->topic_len, event->topic);
+				}
 				break;
 			}
-			mqtt_message_handler(message);
+
+			ESP_LOGI(TAG, "TOPIC=%.*s DATA=%.*s", event->topic_len, event->topic, event->data_len, event->data);
+			int len = command_dispatch(event->data, event->data_len, reply, sizeof(reply));
+			if (len > 0) {
+				sprintf(topic, "/devices/%s/reply", mac_string);
+				publish(client, topic, reply, len, 0, 0);
+			}
 			break;
+		}
 		default:
 			ESP_LOGW(TAG, "MQTT event %d", event->event_id);
 			break;
 	}
 }
 
-void mqtt_report_task(void *arg)
+/* 描述：等待第一个上报周期，不等完整的上报周期
+ * 传感器就绪是必要条件；MQTT连接且所有已启动传感器的滤波结果可用后立即开始，最多再等待一个上报周期 */
+static void mqtt_wait_first_cycle(void)
 {
-	esp_err_t ret;
-	while(true) {
-		vTaskDelay(report_period_ms / portTICK_PERIOD_MS);
+	boot_wait(BOOT_PHASE_SENSOR, portMAX_DELAY);
 
-		ESP_LOGI(TAG, "MQTT report loop");
+	TickType_t start = xTaskGetTickCount();
+	TickType_t limit = report_period_ms / portTICK_PERIOD_MS;
+	boot_wait(BOOT_PHASE_MQTT, limit);
 
-		//打印Wi-Fi信息
-		wifi_ap_record_t ap_info;
-		ret = esp_wifi_sta_get_ap_info(&ap_info);
-		if (ret!=ESP_OK){
-			ESP_LOGE(TAG, "Get WiFi info failed %d", ret);
-			continue;
+	while (xTaskGetTickCount() - start < limit) {
+		bool ready = true;
+		for (int i = 0; i < sensor_count && ready; i++) {
+			ready = sensors[i] == NULL || sht3x_is_ready(sensors[i]);
 		}
-		ESP_LOGI(TAG, "WiFi connect to %s RSSI=%d", ap_info.ssid, ap_info.rssi);
+		if (ready) {
+			return;
+		}
+		vTaskDelay(FIRST_CYCLE_POLL_MS / portTICK_PERIOD_MS);
+	}
+}
 
-		if (!mqtt_client_connected) {
-			continue;
+/* 描述：MQTT后端的周期处理：离线时把待上报队列转存到Flash，在线时按批量阈值发布并补发Flash中的采样 */
+static void mqtt_export_flush(void)
+{
+	esp_err_t ret;
+
+	if (!mqtt_client_connected) {
+		mqtt_spill_to_flash();
+		DLOGW(OFFLINE, flash_log_depth(), flash_log_dropped(), sample_queue_dropped());
+		return;
+	}
+
+	//打印Wi-Fi信息
+	wifi_ap_record_t ap_info;
+	ret = esp_wifi_sta_get_ap_info(&ap_info);
+	if (ret==ESP_OK){
+		DLOGI(WIFI_RSSI, (const char *)ap_info.ssid, ap_info.rssi);
+	}
+
+	//统计结果不转存Flash，离线期间留在内存队列中
+	if (summary_count() > 0) {
+		ret = mqtt_publish_summaries();
+		if (ret == ESP_ERR_NO_MEM) {
+			return;
 		}
+		if (ret != ESP_OK) {
+			ESP_LOGE(TAG, "Publish summary failed %d", ret);
+			return;
+		}
+		mqtt_publish_boot();
+	}
 
+	if (mqtt_batch_ready()) {
 		ret = mqtt_publish_data();
+		if (ret == ESP_ERR_NO_MEM) {
+			//QoS 1发布窗口已满，采样留在队列中，等PUBACK腾出空位后再发布
+			return;
+		}
 		if (ret != ESP_OK) {
 			ESP_LOGE(TAG, "Publish failed %d", ret);
-			continue;
+			return;
 		}
+		DLOGI(PUBLISH_SUCCESS);
+		mqtt_publish_boot();
+	}
+
+	//实时数据发布之后再补发离线期间的数据
+	mqtt_drain_flash();
+}
 
-		ESP_LOGI(TAG, "MQTT publish success");
+//MQTT的flush可能因TCP发送缓冲区已满而阻塞，最后注册
+static const exporter_t mqtt_exporter = {
+	.name = "mqtt " CONFIG_MQTT_URI,
+	.export = mqtt_export_sample,
+	.flush = mqtt_export_flush,
+};
+
+void mqtt_report_task(void *arg)
+{
+	sched_stats_t stats;
+	bool first_cycle = true;
+	while(true) {
+		//第一个周期在依赖就绪后立即开始，之后按绝对时间点调度，时间同步后对齐到UTC时间的周期整数倍
+		if (first_cycle) {
+			mqtt_wait_first_cycle();
+			first_cycle = false;
+		} else {
+			sched_wait_next(report_period_ms);
+		}
+
+		sched_get_stats(&stats);
+		DLOGI(REPORT_LOOP, stats.lateness_min_ms, stats.lateness_max_ms, stats.lateness_p99_ms, stats.missed, stats.cycles);
+
+		//每条采样只采集一次，分发给各导出后端，由后端各自缓存和发送
+		mqtt_sample_data();
+		summary_collect(report_window_ms, report_period_ms);
+		exporter_flush();
+
+		if (mqtt_client_connected) {
+			mqtt_publish_telemetry();
+		}
 	}
 }
 
 
+/* 描述：替换发布函数，只用于基准测试，在上报任务之外测量完整的发布路径
+ * 参数fn：发布函数，参数和返回值与esp_mqtt_client_publish()相同 */
+void mqtt_set_publish_fn(mqtt_publish_fn_t fn)
+{
+	publish = fn;
+}
+
 void mqtt_app_init(void)
 {
 	esp_mqtt_client_config_t mqtt_cfg = {
@@ -177,9 +781,25 @@ void mqtt_app_init(void)
 
 	ESP_LOGI(TAG, "Start mqtt app on %s with %s(%s)", mqtt_cfg.uri, mqtt_cfg.username, mqtt_cfg.password);
 	client = esp_mqtt_client_init(&mqtt_cfg);
+
+	//Flash日志不可用时离线采样只保留在内存队列中
+	if (flash_log_init() != ESP_OK) {
+		ESP_LOGE(TAG, "Sample log unavailable, offline samples kept in RAM only");
+	}
 	esp_mqtt_client_register_event(client, MQTT_EVENT_ANY, mqtt_event_handler, client);
 
-	xTaskCreate(mqtt_report_task, "mqtt_report_task", 2048, NULL, 5, NULL);
+#ifdef CONFIG_DLOG_STREAM
+	dlog_set_stream(mqtt_publish_log);
+#endif
+
+	//Prometheus和InfluxDB后端在各自的初始化中注册，MQTT在它们之后
+	exporter_register(&mqtt_exporter);
+
+	//恢复之前通过命令修改并持久化的设置
+	command_register(mqtt_commands, sizeof(mqtt_commands) / sizeof(mqtt_commands[0]));
+	command_restore();
+
+	xTaskCreate(mqtt_report_task, "mqtt_report_task", CONFIG_REPORT_TASK_STACK_SIZE, NULL, 5, NULL);
 }
 
 void mqtt_app_start(void)
@@ -1,7 +1,14 @@
 #ifndef __MQTT_H__
 #define __MQTT_H__
 #include <esp_err.h>
+#include <mqtt_client.h>
+
+//发布函数，与esp_mqtt_client_publish()相同
+typedef int (*mqtt_publish_fn_t)(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain);
+
 void mqtt_app_init(void);
 void mqtt_app_start(void);
 void mqtt_app_stop(void);
+esp_err_t mqtt_publish_data(void);
+void mqtt_set_publish_fn(mqtt_publish_fn_t fn);
 #endif
@@ -0,0 +1,341 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "payload.h"
+
+/* 直接写入调用方缓冲区的流式编码器，不分配任何堆内存
+ * 输出与cJSON_PrintUnformatted生成的紧凑JSON逐字节一致 */
+typedef struct {
+	char *buf;
+	size_t size;
+	size_t len;
+	bool overflow;
+} payload_writer_t;
+
+static void put_char(payload_writer_t *w, char c)
+{
+	if (w->len + 1 >= w->size) {
+		w->overflow = true;
+		return;
+	}
+	w->buf[w->len++] = c;
+}
+
+static void put_raw(payload_writer_t *w, const char *s)
+{
+	while (*s) {
+		put_char(w, *s++);
+	}
+}
+
+static void put_uint(payload_writer_t *w, uint32_t v)
+{
+	char digits[10];
+	int n = 0;
+
+	do {
+		digits[n++] = '0' + v % 10;
+		v /= 10;
+	} while (v);
+
+	while (n) {
+		put_char(w, digits[--n]);
+	}
+}
+
+//UTC毫秒数超出32位，只有时间戳使用64位除法
+static void put_uint64(payload_writer_t *w, uint64_t v)
+{
+	char digits[20];
+	int n = 0;
+
+	do {
+		digits[n++] = '0' + v % 10;
+		v /= 10;
+	} while (v);
+
+	while (n) {
+		put_char(w, digits[--n]);
+	}
+}
+
+static void put_int(payload_writer_t *w, int32_t v)
+{
+	if (v < 0) {
+		put_char(w, '-');
+		put_uint(w, -(uint32_t)v);
+		return;
+	}
+	put_uint(w, v);
+}
+
+//按JSON规则转义字符串，与cJSON的转义方式一致
+static void put_string(payload_writer_t *w, const char *s)
+{
+	static const char hex[] = "0123456789abcdef";
+
+	put_char(w, '"');
+	for (; *s; s++) {
+		unsigned char c = *s;
+		switch (c) {
+			case '"':  put_raw(w, "\\\""); break;
+			case '\\': put_raw(w, "\\\\"); break;
+			case '\b': put_raw(w, "\\b"); break;
+			case '\f': put_raw(w, "\\f"); break;
+			case '\n': put_raw(w, "\\n"); break;
+			case '\r': put_raw(w, "\\r"); break;
+			case '\t': put_raw(w, "\\t"); break;
+			default:
+				if (c < 0x20) {
+					put_raw(w, "\\u00");
+					put_char(w, hex[c >> 4]);
+					put_char(w, hex[c & 0xF]);
+				} else {
+					put_char(w, c);
+				}
+				break;
+		}
+	}
+	put_char(w, '"');
+}
+
+//写入 "key": ，first为false时先写分隔符
+static void put_key(payload_writer_t *w, const char *key, bool first)
+{
+	if (!first) {
+		put_char(w, ',');
+	}
+	put_string(w, key);
+	put_char(w, ':');
+}
+
+//写入一条采样的温湿度字段
+static void put_sample_data(payload_writer_t *w, const payload_sample_t *sample)
+{
+	put_key(w, "temperature", true);
+	put_int(w, sample->temperature);
+	put_key(w, "humiture", false);
+	put_uint(w, sample->humiture);
+	put_key(w, "count", false);
+	put_uint(w, sample->count);
+}
+
+//开机后毫秒数，UTC时间已知时随后附带ts
+static void put_time(payload_writer_t *w, int64_t mono_ms, int64_t time_ms, bool first)
+{
+	put_key(w, "up", first);
+	put_uint(w, (uint32_t)mono_ms);
+	if (time_ms > 0) {
+		put_key(w, "ts", false);
+		put_uint64(w, time_ms);
+	}
+}
+
+static void put_sample_time(payload_writer_t *w, const payload_sample_t *sample, bool first)
+{
+	put_time(w, sample->mono_ms, sample->time_ms, first);
+}
+
+//写入 "key":{"min":..,"max":..,"mean":..,"stddev":..}
+static void put_moments(payload_writer_t *w, const char *key, const payload_moments_t *m)
+{
+	put_key(w, key, false);
+	put_char(w, '{');
+	put_key(w, "min", true);
+	put_int(w, m->min);
+	put_key(w, "max", false);
+	put_int(w, m->max);
+	put_key(w, "mean", false);
+	put_int(w, m->mean);
+	put_key(w, "stddev", false);
+	put_uint(w, m->stddev);
+	put_char(w, '}');
+}
+
+/* 描述：把一次上报编码为紧凑JSON，ts为UTC毫秒数，时间未同步且无法换算时省略
+ * 单条采样：{"type":"report","mac":"..","sn":..,"up":..,"ts":..,"data":{"temperature":..,"humiture":..,"count":..}}
+ * 多条采样：{"type":"batch","mac":"..","sn":..,"samples":[{"up":..,"ts":..,"temperature":..,"humiture":..,"count":..},...]}
+ * 参数buf：输出缓冲区，结果以\0结尾
+ * 参数size：缓冲区长度
+ * 参数report：上报内容
+ * 返回值：成功返回报文长度（不含\0），缓冲区不足返回-1 */
+int payload_encode_json(char *buf, size_t size, const payload_report_t *report)
+{
+	payload_writer_t w = {.buf = buf, .size = size};
+
+	if (size == 0 || report->count == 0) {
+		return -1;
+	}
+
+	put_char(&w, '{');
+	put_key(&w, "type", true);
+	put_string(&w, report->count == 1 ? "report" : "batch");
+	put_key(&w, "mac", false);
+	put_string(&w, report->mac);
+	put_key(&w, "sn", false);
+	put_uint(&w, report->sn);
+
+	if (report->count == 1) {
+		put_sample_time(&w, &report->samples[0], false);
+		put_key(&w, "data", false);
+		put_char(&w, '{');
+		put_sample_data(&w, &report->samples[0]);
+		put_char(&w, '}');
+	} else {
+		put_key(&w, "samples", false);
+		put_char(&w, '[');
+		for (size_t i = 0; i < report->count; i++) {
+			if (i) {
+				put_char(&w, ',');
+			}
+			put_char(&w, '{');
+			put_sample_time(&w, &report->samples[i], true);
+			put_char(&w, ',');
+			put_sample_data(&w, &report->samples[i]);
+			put_char(&w, '}');
+		}
+		put_char(&w, ']');
+	}
+
+	put_char(&w, '}');
+
+	buf[w.len] = '\0';
+	return w.overflow ? -1 : (int)w.len;
+}
+
+/* 描述：把一个统计窗口的结果编码为紧凑JSON，up和ts为窗口结束的时间，window为窗口长度(ms)
+ * {"type":"summary","mac":"..","sn":..,"up":..,"ts":..,"window":..,"count":..,
+ *  "temperature":{"min":..,"max":..,"mean":..,"stddev":..},"humiture":{"min":..,"max":..,"mean":..,"stddev":..}}
+ * 参数buf：输出缓冲区，结果以\0结尾，建议长度PAYLOAD_SUMMARY_JSON_LEN
+ * 参数size：缓冲区长度
+ * 参数mac：MAC地址字符串
+ * 参数sn：传感器序列号
+ * 参数summary：统计结果
+ * 返回值：成功返回报文长度（不含\0），缓冲区不足返回-1 */
+int payload_encode_summary_json(char *buf, size_t size, const char *mac, uint32_t sn, const payload_summary_t *summary)
+{
+	payload_writer_t w = {.buf = buf, .size = size};
+
+	if (size == 0) {
+		return -1;
+	}
+
+	put_char(&w, '{');
+	put_key(&w, "type", true);
+	put_string(&w, "summary");
+	put_key(&w, "mac", false);
+	put_string(&w, mac);
+	put_key(&w, "sn", false);
+	put_uint(&w, sn);
+	put_time(&w, summary->mono_ms, summary->time_ms, false);
+	put_key(&w, "window", false);
+	put_uint(&w, summary->window_ms);
+	put_key(&w, "count", false);
+	put_uint(&w, summary->count);
+	put_moments(&w, "temperature", &summary->temperature);
+	put_moments(&w, "humiture", &summary->humiture);
+	put_char(&w, '}');
+
+	buf[w.len] = '\0';
+	return w.overflow ? -1 : (int)w.len;
+}
+
+static void put_le16(uint8_t *p, uint16_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static void put_le64(uint8_t *p, uint64_t v)
+{
+	put_le32(&p[0], (uint32_t)v);
+	put_le32(&p[4], (uint32_t)(v >> 32));
+}
+
+static uint16_t get_le16(const uint8_t *p)
+{
+	return p[0] | ((uint16_t)p[1] << 8);
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+	return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t get_le64(const uint8_t *p)
+{
+	return get_le32(&p[0]) | ((uint64_t)get_le32(&p[4]) << 32);
+}
+
+/* 描述：把一次上报编码为二进制报文，格式见payload.h
+ * 参数buf：输出缓冲区
+ * 参数size：缓冲区长度
+ * 参数report：上报内容
+ * 返回值：成功返回报文长度，缓冲区不足或采样条数超出范围返回-1 */
+int payload_encode_binary(uint8_t *buf, size_t size, const payload_report_t *report)
+{
+	if (report->count == 0 || report->count > UINT8_MAX || size < PAYLOAD_BINARY_LEN(report->count)) {
+		return -1;
+	}
+
+	buf[0] = PAYLOAD_BINARY_VERSION;
+	buf[1] = report->count;
+	memcpy(&buf[2], report->mac_addr, 6);
+	put_le32(&buf[8], report->sn);
+
+	for (size_t i = 0; i < report->count; i++) {
+		uint8_t *p = &buf[PAYLOAD_BINARY_LEN(i)];
+		put_le32(&p[0], (uint32_t)report->samples[i].mono_ms);
+		put_le64(&p[4], report->samples[i].time_ms);
+		put_le16(&p[12], (uint16_t)report->samples[i].temperature);
+		put_le16(&p[14], report->samples[i].humiture);
+		put_le16(&p[16], report->samples[i].count);
+	}
+
+	return PAYLOAD_BINARY_LEN(report->count);
+}
+
+/* 描述：解码二进制报文，供后端和主机工具使用
+ * 参数buf：报文
+ * 参数len：报文长度
+ * 参数header：存储报文头的指针
+ * 参数samples：存储采样的数组
+ * 参数max_samples：数组长度
+ * 返回值：成功返回解码出的采样条数，报文格式错误返回-1 */
+int payload_decode_binary(const uint8_t *buf, size_t len, payload_binary_header_t *header, payload_sample_t *samples, size_t max_samples)
+{
+	if (len < PAYLOAD_BINARY_HEADER_LEN || buf[0] != PAYLOAD_BINARY_VERSION) {
+		return -1;
+	}
+
+	header->version = buf[0];
+	header->count = buf[1];
+	memcpy(header->mac, &buf[2], 6);
+	header->sn = get_le32(&buf[8]);
+
+	if (len != PAYLOAD_BINARY_LEN(header->count) || header->count > max_samples) {
+		return -1;
+	}
+
+	for (size_t i = 0; i < header->count; i++) {
+		const uint8_t *p = &buf[PAYLOAD_BINARY_LEN(i)];
+		samples[i].mono_ms = get_le32(&p[0]);
+		samples[i].time_ms = (int64_t)get_le64(&p[4]);
+		samples[i].temperature = (int16_t)get_le16(&p[12]);
+		samples[i].humiture = get_le16(&p[14]);
+		samples[i].count = get_le16(&p[16]);
+		samples[i].sensor = 0;
+	}
+
+	return header->count;
+}
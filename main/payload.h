@@ -0,0 +1,84 @@
+#ifndef __PAYLOAD_H__
+#define __PAYLOAD_H__
+#include <stdint.h>
+#include <stddef.h>
+
+//包含count条采样的JSON上报报文的最大长度（含结尾的\0）
+#define PAYLOAD_JSON_LEN(count) (128 + 96 * (size_t)(count))
+
+//统计报文的最大长度（含结尾的\0）
+#define PAYLOAD_SUMMARY_JSON_LEN 320
+
+/* 二进制上报报文格式（版本1，所有多字节字段均为小端序）
+ *   偏移 长度 字段
+ *   0    1    version  格式版本，当前为1
+ *   1    1    count    报文中的采样条数
+ *   2    6    mac      MAC地址原始字节
+ *   8    4    sn       SHT3x序列号
+ *   12   18*n samples  每条采样：up(4字节，开机后毫秒数) ts(8字节有符号，UTC毫秒数，未知时为0)
+ *                      temperature(2字节有符号，0.01°C) humiture(2字节无符号，0.01%)
+ *                      count(2字节无符号，滤波时使用的原始采样数)
+ */
+#define PAYLOAD_BINARY_VERSION 1
+#define PAYLOAD_BINARY_HEADER_LEN 12
+#define PAYLOAD_BINARY_SAMPLE_LEN 18
+#define PAYLOAD_BINARY_LEN(count) (PAYLOAD_BINARY_HEADER_LEN + PAYLOAD_BINARY_SAMPLE_LEN * (size_t)(count))
+
+//上报格式
+typedef enum {
+	PAYLOAD_FORMAT_JSON = 0,
+	PAYLOAD_FORMAT_BINARY,
+	PAYLOAD_FORMAT_BOTH,
+} payload_format_t;
+
+//一条采样，温湿度均为0.01单位的整数
+typedef struct {
+	int64_t mono_ms;    //采样时的单调时间，即本次开机后的毫秒数
+	int64_t time_ms;    //采样时的UTC时间(ms)，未知时为0，同步之后由单调时间换算
+	int16_t temperature;
+	uint16_t humiture;
+	uint16_t count;     //滤波时使用的原始采样数
+	uint8_t sensor;     //设备上的传感器序号，不写入报文，上报时按序号分组并使用各自的序列号
+} payload_sample_t;
+
+//统计窗口内一个量的统计结果，0.01单位的整数
+typedef struct {
+	int16_t min;
+	int16_t max;
+	int16_t mean;
+	uint16_t stddev;    //样本标准差
+} payload_moments_t;
+
+//一个传感器在一个统计窗口内的统计结果
+typedef struct {
+	int64_t mono_ms;    //窗口结束时的单调时间
+	int64_t time_ms;    //窗口结束时的UTC时间(ms)，未知时为0
+	uint32_t window_ms; //窗口的实际长度
+	uint32_t count;     //窗口内的原始采样数
+	payload_moments_t temperature;
+	payload_moments_t humiture;
+	uint8_t sensor;
+} payload_summary_t;
+
+//一次上报的内容，可以包含同一个传感器的多条采样
+typedef struct {
+	const char *mac;
+	const uint8_t *mac_addr;
+	uint32_t sn;
+	const payload_sample_t *samples;
+	size_t count;
+} payload_report_t;
+
+//二进制报文头
+typedef struct {
+	uint8_t version;
+	uint8_t mac[6];
+	uint32_t sn;
+	uint8_t count;
+} payload_binary_header_t;
+
+int payload_encode_json(char *buf, size_t size, const payload_report_t *report);
+int payload_encode_summary_json(char *buf, size_t size, const char *mac, uint32_t sn, const payload_summary_t *summary);
+int payload_encode_binary(uint8_t *buf, size_t size, const payload_report_t *report);
+int payload_decode_binary(const uint8_t *buf, size_t len, payload_binary_header_t *header, payload_sample_t *samples, size_t max_samples);
+#endif
@@ -0,0 +1,62 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/param.h>
+
+#include "sample_queue.h"
+
+/* 待上报采样队列
+ * 有界环形队列，满时丢弃最旧的采样。只在上报任务中访问，不需要加锁 */
+#define SAMPLE_QUEUE_LEN CONFIG_REPORT_QUEUE_LEN
+
+static payload_sample_t queue[SAMPLE_QUEUE_LEN];
+static size_t queue_head;   //最旧采样的位置
+static size_t queue_count;
+static uint32_t queue_dropped;
+
+/* 描述：追加一条采样，队列满时丢弃最旧的一条
+ * 参数sample：采样 */
+void sample_queue_push(const payload_sample_t *sample)
+{
+	if (queue_count == SAMPLE_QUEUE_LEN) {
+		queue_head = (queue_head + 1) % SAMPLE_QUEUE_LEN;
+		queue_count--;
+		queue_dropped++;
+	}
+
+	queue[(queue_head + queue_count) % SAMPLE_QUEUE_LEN] = *sample;
+	queue_count++;
+}
+
+/* 描述：按从旧到新的顺序拷贝若干条采样，不移出队列
+ * 参数samples：存储采样的数组
+ * 参数count：数组长度
+ * 返回值：实际拷贝的条数 */
+size_t sample_queue_peek(payload_sample_t *samples, size_t count)
+{
+	size_t n = MIN(count, queue_count);
+
+	for (size_t i = 0; i < n; i++) {
+		samples[i] = queue[(queue_head + i) % SAMPLE_QUEUE_LEN];
+	}
+
+	return n;
+}
+
+/* 描述：移出最旧的若干条采样，一般在上报成功后调用
+ * 参数count：移出的条数 */
+void sample_queue_pop(size_t count)
+{
+	count = MIN(count, queue_count);
+	queue_head = (queue_head + count) % SAMPLE_QUEUE_LEN;
+	queue_count -= count;
+}
+
+size_t sample_queue_count(void)
+{
+	return queue_count;
+}
+
+uint32_t sample_queue_dropped(void)
+{
+	return queue_dropped;
+}
@@ -0,0 +1,12 @@
+#ifndef __SAMPLE_QUEUE_H__
+#define __SAMPLE_QUEUE_H__
+#include <stdint.h>
+#include <stddef.h>
+#include "payload.h"
+
+void sample_queue_push(const payload_sample_t *sample);
+size_t sample_queue_peek(payload_sample_t *samples, size_t count);
+void sample_queue_pop(size_t count);
+size_t sample_queue_count(void);
+uint32_t sample_queue_dropped(void);
+#endif
@@ -0,0 +1,112 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/time.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_log.h>
+
+#include "sched.h"
+#include "time.h"
+
+/* 按绝对时间点调度的采样周期
+ * 时间同步前以开机时间为基准，每个周期的计划时间点在上一个计划时间点上累加，处理耗时不会造成漂移；
+ * 时间同步后计划时间点对齐到UTC时间的周期整数倍，不同设备的采样时刻因此一致。
+ * 只在上报任务中调用，不需要加锁 */
+
+//延迟直方图分桶上界(ms)，最后一个桶收集所有更大的值
+static const int32_t lateness_buckets[] = {0, 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, INT32_MAX};
+#define LATENESS_BUCKET_NUM (sizeof(lateness_buckets) / sizeof(lateness_buckets[0]))
+
+static uint32_t lateness_hist[LATENESS_BUCKET_NUM];
+static sched_stats_t stats = {.lateness_min_ms = INT32_MAX, .lateness_max_ms = INT32_MIN};
+
+static int64_t next_deadline_ms;
+static uint32_t current_period_ms;
+static bool aligned;
+
+//当前时间(ms)，已同步时为UTC时间，否则为开机时间
+static int64_t sched_now_ms(bool synced)
+{
+	if (synced) {
+		struct timeval tv;
+		gettimeofday(&tv, NULL);
+		return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+	}
+	return (int64_t)xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+//计算now之后的下一个计划时间点
+static int64_t sched_next_slot(int64_t now, uint32_t period_ms, bool synced)
+{
+	if (synced) {
+		return (now / period_ms + 1) * period_ms;
+	}
+	return now + period_ms;
+}
+
+static void sched_record(int32_t lateness_ms)
+{
+	int i = 0;
+	while (lateness_ms > lateness_buckets[i]) {
+		i++;
+	}
+	lateness_hist[i]++;
+
+	stats.cycles++;
+	if (lateness_ms < stats.lateness_min_ms) {
+		stats.lateness_min_ms = lateness_ms;
+	}
+	if (lateness_ms > stats.lateness_max_ms) {
+		stats.lateness_max_ms = lateness_ms;
+	}
+}
+
+/* 描述：阻塞到下一个采样时间点
+ * 参数period_ms：采样周期，修改后从下一个周期开始生效 */
+void sched_wait_next(uint32_t period_ms)
+{
+	bool synced = time_is_synced();
+	int64_t now = sched_now_ms(synced);
+
+	//首次调用、周期修改、刚完成时间同步或时钟被向后校准时，重新计算计划时间点
+	if (next_deadline_ms == 0 || period_ms != current_period_ms || synced != aligned ||
+			next_deadline_ms - now > period_ms) {
+		current_period_ms = period_ms;
+		aligned = synced;
+		next_deadline_ms = sched_next_slot(now, period_ms, synced);
+	}
+
+	//向上取整到tick，保证不会早于计划时间点唤醒
+	if (next_deadline_ms > now) {
+		vTaskDelay((next_deadline_ms - now + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS);
+	}
+
+	now = sched_now_ms(synced);
+	sched_record(now - next_deadline_ms);
+
+	//滞后超过一个周期时跳过错过的时间点，而不是连续补跑
+	next_deadline_ms += period_ms;
+	if (next_deadline_ms <= now) {
+		stats.missed += (now - next_deadline_ms) / period_ms + 1;
+		next_deadline_ms = sched_next_slot(now, period_ms, synced);
+	}
+}
+
+/* 描述：获取调度质量统计
+ * 参数out：存储统计结果的指针 */
+void sched_get_stats(sched_stats_t *out)
+{
+	*out = stats;
+
+	//p99取累计计数达到99%的分桶上界
+	uint32_t target = stats.cycles - stats.cycles / 100;
+	uint32_t sum = 0;
+	out->lateness_p99_ms = 0;
+	for (int i = 0; i < LATENESS_BUCKET_NUM && stats.cycles > 0; i++) {
+		sum += lateness_hist[i];
+		if (sum >= target) {
+			out->lateness_p99_ms = lateness_buckets[i] == INT32_MAX ? stats.lateness_max_ms : lateness_buckets[i];
+			break;
+		}
+	}
+}
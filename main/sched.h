@@ -0,0 +1,16 @@
+#ifndef __SCHED_H__
+#define __SCHED_H__
+#include <stdint.h>
+
+//调度质量统计，延迟指实际唤醒时间相对于计划时间点的滞后
+typedef struct {
+	uint32_t cycles;            //已调度的周期数
+	uint32_t missed;            //因严重滞后而跳过的周期数
+	int32_t lateness_min_ms;
+	int32_t lateness_max_ms;
+	int32_t lateness_p99_ms;    //按直方图分桶上界估算
+} sched_stats_t;
+
+void sched_wait_next(uint32_t period_ms);
+void sched_get_stats(sched_stats_t *out);
+#endif
@@ -0,0 +1,123 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/param.h>
+#include <esp_log.h>
+#include <sht3x.h>
+
+#include "summary.h"
+#include "time.h"
+
+extern sht3x_handle_t sensors[];
+extern size_t sensor_count;
+
+/* 窗口统计上报
+ * 驱动在采集任务中按周期测量的频率累加每个传感器的统计量，这里在上报周期的边界取出，
+ * 窗口结束时每个传感器生成一条统计结果，放入有界队列等待发布，队列满时丢弃最旧的结果。
+ * 窗口以上报周期为粒度，只在上报任务中访问，不需要加锁 */
+#define SUMMARY_QUEUE_LEN 16
+
+static const char *TAG = "main.summary";
+
+static payload_summary_t queue[SUMMARY_QUEUE_LEN];
+static size_t queue_head;
+static size_t queue_count;
+static uint32_t queue_dropped;
+
+static int64_t window_start_ms;
+
+static void summary_push(const payload_summary_t *summary)
+{
+	if (queue_count == SUMMARY_QUEUE_LEN) {
+		queue_head = (queue_head + 1) % SUMMARY_QUEUE_LEN;
+		queue_count--;
+		queue_dropped++;
+	}
+
+	queue[(queue_head + queue_count) % SUMMARY_QUEUE_LEN] = *summary;
+	queue_count++;
+}
+
+static void summary_copy_moments(payload_moments_t *out, const sht3x_moments_t *m)
+{
+	out->min = m->min;
+	out->max = m->max;
+	out->mean = m->mean;
+	out->stddev = m->stddev;
+}
+
+/* 描述：每个上报周期调用一次，窗口到期时为每个传感器生成一条统计结果
+ * 窗口长度为0时只清空驱动中的统计量，开启后第一个窗口从上一个周期开始
+ * 参数window_ms：窗口长度，0表示关闭
+ * 参数period_ms：上报周期，剩余时间不足半个周期时提前结束窗口，避免周期的抖动让窗口多出一个周期 */
+void summary_collect(uint32_t window_ms, uint32_t period_ms)
+{
+	int64_t now = time_mono_ms();
+	sht3x_window_t window;
+
+	if (window_ms > 0 && now - window_start_ms + period_ms / 2 < window_ms) {
+		return;
+	}
+
+	for (size_t i = 0; i < sensor_count; i++) {
+		//尚未启动的传感器没有窗口
+		if (sensors[i] == NULL) {
+			continue;
+		}
+		sht3x_take_window(sensors[i], &window);
+		if (window_ms == 0) {
+			continue;
+		}
+		if (window.count == 0) {
+			ESP_LOGE(TAG, "No sample from sensor %d in window", (int)i);
+			continue;
+		}
+
+		//同步之前time_ms为0，发布时再按单调时间换算
+		payload_summary_t summary = {
+			.mono_ms = now,
+			.time_ms = time_epoch_ms(now),
+			.window_ms = now - window_start_ms,
+			.count = window.count,
+			.sensor = i,
+		};
+		summary_copy_moments(&summary.temperature, &window.temperature);
+		summary_copy_moments(&summary.humiture, &window.humidity);
+		summary_push(&summary);
+	}
+
+	window_start_ms = now;
+}
+
+/* 描述：按从旧到新的顺序拷贝若干条统计结果，不移出队列
+ * 参数summaries：存储统计结果的数组
+ * 参数count：数组长度
+ * 返回值：实际拷贝的条数 */
+size_t summary_peek(payload_summary_t *summaries, size_t count)
+{
+	size_t n = MIN(count, queue_count);
+
+	for (size_t i = 0; i < n; i++) {
+		summaries[i] = queue[(queue_head + i) % SUMMARY_QUEUE_LEN];
+	}
+
+	return n;
+}
+
+/* 描述：移出最旧的若干条统计结果，一般在发布成功后调用
+ * 参数count：移出的条数 */
+void summary_pop(size_t count)
+{
+	count = MIN(count, queue_count);
+	queue_head = (queue_head + count) % SUMMARY_QUEUE_LEN;
+	queue_count -= count;
+}
+
+size_t summary_count(void)
+{
+	return queue_count;
+}
+
+uint32_t summary_dropped(void)
+{
+	return queue_dropped;
+}
@@ -0,0 +1,12 @@
+#ifndef __SUMMARY_H__
+#define __SUMMARY_H__
+#include <stdint.h>
+#include <stddef.h>
+#include "payload.h"
+
+void summary_collect(uint32_t window_ms, uint32_t period_ms);
+size_t summary_peek(payload_summary_t *summaries, size_t count);
+void summary_pop(size_t count);
+size_t summary_count(void);
+uint32_t summary_dropped(void);
+#endif
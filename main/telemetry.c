@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_system.h>
+#include <esp_log.h>
+#include <sht3x.h>
+
+#include "telemetry.h"
+#include "sched.h"
+#include "inflight.h"
+#include "conn.h"
+#include "dlog.h"
+#include "influx.h"
+#include "time.h"
+#include "summary.h"
+
+extern sht3x_handle_t sensors[];
+extern uint32_t sensor_sn[];
+extern const size_t sensor_configured;
+extern char mac_string[20];
+
+/* 设备自身运行指标
+ * 记录时只递增计数器，编码和发布由上报任务按CONFIG_TELEMETRY_PERIOD_MS周期进行，
+ * 所有计数均为开机后的累计值，由后端计算增量。只在上报任务中调用，不需要加锁 */
+
+static const uint32_t latency_buckets_ms[TELEMETRY_LATENCY_BUCKET_NUM] = TELEMETRY_LATENCY_BUCKETS_MS;
+static uint32_t latency_hist[TELEMETRY_LATENCY_BUCKET_NUM];
+static uint32_t latency_max_ms;
+static uint32_t publish_ok;
+static uint32_t publish_failed;
+
+/* 描述：记录一次MQTT发布的结果
+ * 参数ok：esp_mqtt_client_publish()是否成功 */
+void telemetry_record_publish(bool ok)
+{
+	if (ok) {
+		publish_ok++;
+	} else {
+		publish_failed++;
+	}
+}
+
+/* 描述：记录一条采样从采集到发布的延迟
+ * 参数latency_ms：延迟 */
+void telemetry_record_latency(uint32_t latency_ms)
+{
+	int i = 0;
+	while (latency_ms > latency_buckets_ms[i]) {
+		i++;
+	}
+	latency_hist[i]++;
+
+	if (latency_ms > latency_max_ms) {
+		latency_max_ms = latency_ms;
+	}
+}
+
+//以JSON数组输出直方图计数
+static int put_hist(char *buf, size_t size, const uint32_t *hist, int num)
+{
+	int len = 0;
+	for (int i = 0; i < num; i++) {
+		int n = snprintf(buf + len, size - len, "%s%u", i == 0 ? "[" : ",", hist[i]);
+		if (n < 0 || n >= size - len) {
+			return -1;
+		}
+		len += n;
+	}
+	if (len + 1 >= size) {
+		return -1;
+	}
+	buf[len++] = ']';
+	buf[len] = '\0';
+	return len;
+}
+
+/* 描述：编码自身运行指标报文，需在上报任务中调用，栈余量取的是调用者所在任务
+ * 参数buf：输出缓冲区，建议长度TELEMETRY_JSON_LEN
+ * 参数size：缓冲区长度
+ * 返回值：报文长度，缓冲区不足返回-1 */
+int telemetry_encode_json(char *buf, size_t size)
+{
+	sht3x_stats_t i2c;
+	sched_stats_t sched;
+	inflight_stats_t qos;
+	conn_stats_t wifi;
+	conn_stats_t mqtt;
+	influx_stats_t influx;
+	time_stats_t time;
+	char i2c_hist[80];
+	char latency_hist_text[80];
+	char rtt_hist[80];
+	uint32_t sensors_failed = 0;
+
+	//尚未启动或已经失效的传感器按序号置位
+	for (size_t i = 0; i < sensor_configured; i++) {
+		if (sensors[i] == NULL || sht3x_is_failed(sensors[i])) {
+			sensors_failed |= 1u << i;
+		}
+	}
+
+	sht3x_get_stats(&i2c);
+	sched_get_stats(&sched);
+	inflight_get_stats(&qos);
+	conn_get_stats(CONN_LINK_WIFI, &wifi);
+	conn_get_stats(CONN_LINK_MQTT, &mqtt);
+	influx_get_stats(&influx);
+	time_get_stats(&time);
+
+	if (put_hist(i2c_hist, sizeof(i2c_hist), i2c.i2c_time_hist, SHT3X_I2C_TIME_BUCKET_NUM) < 0 ||
+			put_hist(latency_hist_text, sizeof(latency_hist_text), latency_hist, TELEMETRY_LATENCY_BUCKET_NUM) < 0 ||
+			put_hist(rtt_hist, sizeof(rtt_hist), qos.rtt_hist, INFLIGHT_RTT_BUCKET_NUM) < 0) {
+		return -1;
+	}
+
+	int len = snprintf(buf, size,
+			"{\"type\":\"telemetry\",\"mac\":\"%s\",\"sn\":%u,\"up\":%u,"
+			"\"heap_free\":%u,\"heap_min_free\":%u,\"stack_free\":%u,\"sensors_failed\":%u,"
+			"\"i2c\":{\"count\":%u,\"errors\":%u,\"crc_errors\":%u,\"max_us\":%u,\"hist_us\":%s,"
+			"\"bus_clears\":%u,\"reinits\":%u,\"recoveries\":%u},"
+			"\"publish\":{\"ok\":%u,\"failed\":%u,\"latency_max_ms\":%u,\"latency_hist_ms\":%s},"
+			"\"qos1\":{\"in_flight\":%u,\"sent\":%u,\"acked\":%u,\"expired\":%u,\"window_full\":%u,\"rtt_max_ms\":%u,\"rtt_hist_ms\":%s},"
+			"\"conn\":{\"wifi\":{\"attempts\":%u,\"failures\":%u,\"outages\":%u,\"outage_ms\":%u,\"outage_max_ms\":%u},"
+			"\"mqtt\":{\"attempts\":%u,\"failures\":%u,\"outages\":%u,\"outage_ms\":%u,\"outage_max_ms\":%u}},"
+			"\"influx\":{\"lines\":%u,\"datagrams\":%u,\"errors\":%u,\"dropped\":%u},"
+			"\"time\":{\"synced\":%s,\"syncs\":%u,\"last_step_ms\":%d,\"drift_ppb\":%d},"
+			"\"sched\":{\"cycles\":%u,\"missed\":%u,\"lateness_p99_ms\":%d},\"log_dropped\":%u,\"summary_dropped\":%u}",
+			mac_string, sensor_sn[0], esp_log_early_timestamp(),
+			esp_get_free_heap_size(), esp_get_minimum_free_heap_size(), (unsigned)uxTaskGetStackHighWaterMark(NULL), sensors_failed,
+			i2c.i2c_transactions, i2c.i2c_errors, i2c.crc_errors, i2c.i2c_time_max_us, i2c_hist,
+			i2c.bus_clears, i2c.reinits, i2c.recoveries,
+			publish_ok, publish_failed, latency_max_ms, latency_hist_text,
+			qos.in_flight, qos.sent, qos.acked, qos.expired, qos.window_full, qos.rtt_max_ms, rtt_hist,
+			wifi.attempts, wifi.failures, wifi.outages, wifi.outage_ms, wifi.outage_max_ms,
+			mqtt.attempts, mqtt.failures, mqtt.outages, mqtt.outage_ms, mqtt.outage_max_ms,
+			influx.lines, influx.datagrams, influx.errors, influx.dropped,
+			time.synced ? "true" : "false", time.syncs, time.last_step_ms, time.drift_ppb,
+			sched.cycles, sched.missed, sched.lateness_p99_ms, dlog_dropped(), summary_dropped());
+	if (len < 0 || len >= size) {
+		return -1;
+	}
+
+	return len;
+}
@@ -0,0 +1,17 @@
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+//采样到发布延迟直方图分桶上界(ms)，最后一个桶收集所有更大的值
+#define TELEMETRY_LATENCY_BUCKETS_MS {100, 1000, 5000, 10000, 30000, 60000, 300000, UINT32_MAX}
+#define TELEMETRY_LATENCY_BUCKET_NUM 8
+
+//自身运行指标报文的最大长度（含结尾的\0）
+#define TELEMETRY_JSON_LEN 1024
+
+void telemetry_record_publish(bool ok);
+void telemetry_record_latency(uint32_t latency_ms);
+int telemetry_encode_json(char *buf, size_t size);
+#endif
@@ -1,6 +1,21 @@
 #include <string.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "lwip/apps/sntp.h"
+#include "time.h"
+#include "boot.h"
+
+/* 时间服务
+ * 采样只记录64位单调时间（开机后的毫秒数，不受校时影响），需要UTC时间时按SNTP得到的偏移换算。
+ * 时间任务定期比较系统时间和单调时间：两者之差即偏移，差值突变说明SNTP校准了系统时间；
+ * 相邻两次校时之间偏移的变化量除以间隔即本机时钟的频率偏差，之后按偏移加偏差的线性模型换算，
+ * 系统时间在两次校时之间随本机时钟漂移，换算结果不受影响。
+ * 同步之前的采样在同步之后同样可以换算，因此离线缓存、批量上报的采样都带有准确的时间。
+ * 模型由时间任务更新，上报任务读取，在临界区内访问 */
 
 static const char *TAG = "main.sntp";
 static void initialize_sntp(void)
@@ -11,32 +26,167 @@ static void initialize_sntp(void)
     sntp_init();
 }
 
-#define SECONDS_OF_ONE_YEAR 365*24*60*50
-void wait_time_sync(void)
+//早于2020-01-01的系统时间视为尚未同步
+#define TIME_VALID_AFTER_MS 1577836800000LL
+
+//同步前的检查间隔，只影响记录同步完成时间的精度，SNTP请求由lwIP自行重发
+#define TIME_SYNC_POLL_MS 100
+#define TIME_SYNC_LOG_MS 3000
+//同步后偏移的检查间隔，决定识别校时的延迟
+#define TIME_POLL_MS 1000
+//读取系统时间前后单调时间的最大差值
+#define TIME_READ_MAX_MS 1
+//偏移突变超过该值才视为校时，需大于单次读数的误差
+#define TIME_STEP_MIN_MS 5
+//两次校时间隔太短时偏移的变化主要是读数误差，不更新频率偏差
+#define TIME_DRIFT_MIN_INTERVAL_MS 60000
+//超过晶振的误差范围，视为手动修改时间而不是频率偏差
+#define TIME_DRIFT_MAX_PPB 1000000
+
+static bool synced;
+static int64_t base_mono_ms;    //最近一次校时的单调时间
+static int64_t base_offset_ms;  //最近一次校时后UTC时间与单调时间之差
+static int64_t slope_ppb;       //偏移随单调时间的变化率，本机偏快时为负
+static int64_t last_offset_ms;  //上次检查时的偏移
+static time_stats_t stats;
+
+/* 描述：获取单调时间，开机后的毫秒数 */
+int64_t time_mono_ms(void)
+{
+	return esp_timer_get_time() / 1000;
+}
+
+/* 描述：判断系统时间是否已经通过SNTP同步 */
+bool time_is_synced(void)
+{
+	taskENTER_CRITICAL();
+	bool ret = synced;
+	taskEXIT_CRITICAL();
+	return ret;
+}
+
+/* 描述：把单调时间换算为UTC时间，同步之前和之后的单调时间都可以换算
+ * 参数mono_ms：本次开机的单调时间
+ * 返回值：UTC时间(ms)，尚未同步返回0 */
+int64_t time_epoch_ms(int64_t mono_ms)
+{
+	int64_t epoch = 0;
+
+	taskENTER_CRITICAL();
+	if (synced) {
+		epoch = mono_ms + base_offset_ms + (mono_ms - base_mono_ms) * slope_ppb / 1000000000;
+	}
+	taskEXIT_CRITICAL();
+
+	return epoch;
+}
+
+/* 描述：获取同步状态和频率偏差估计 */
+void time_get_stats(time_stats_t *out)
+{
+	taskENTER_CRITICAL();
+	*out = stats;
+	taskEXIT_CRITICAL();
+}
+
+static void time_log_synced(int64_t epoch_ms)
+{
+	time_t timestamp = epoch_ms / 1000;
+	struct tm timeinfo;
+	char strftime_buf[20];
+
+	localtime_r(&timestamp, &timeinfo);
+	strftime(strftime_buf, sizeof(strftime_buf), "%Y-%m-%d %H:%M:%S", &timeinfo);
+	ESP_LOGI(TAG, "Time synced, current time is: %s", strftime_buf);
+}
+
+//比较系统时间和单调时间，识别第一次同步和之后的校时
+static void time_poll(void)
+{
+	struct timeval tv;
+
+	//两次读取之间被抢占时偏移不准，丢弃这次读数，否则会误判为校时
+	int64_t mono = time_mono_ms();
+	gettimeofday(&tv, NULL);
+	if (time_mono_ms() - mono > TIME_READ_MAX_MS) {
+		return;
+	}
+	int64_t epoch = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+	if (epoch < TIME_VALID_AFTER_MS) {
+		return;
+	}
+
+	int64_t offset = epoch - mono;
+	int64_t step = offset - last_offset_ms;
+	last_offset_ms = offset;
+
+	if (!synced) {
+		taskENTER_CRITICAL();
+		base_mono_ms = mono;
+		base_offset_ms = offset;
+		synced = true;
+		stats.synced = true;
+		stats.syncs = 1;
+		taskEXIT_CRITICAL();
+
+		time_log_synced(epoch);
+		boot_mark(BOOT_PHASE_TIME);
+		return;
+	}
+
+	if (llabs(step) < TIME_STEP_MIN_MS) {
+		return;
+	}
+
+	//校时：用两次校时之间偏移的变化估计频率偏差，并以本次校时为新的基准
+	int64_t interval = mono - base_mono_ms;
+	int64_t slope = slope_ppb;
+	if (interval >= TIME_DRIFT_MIN_INTERVAL_MS) {
+		int64_t measured = (offset - base_offset_ms) * 1000000000 / interval;
+		if (llabs(measured) <= TIME_DRIFT_MAX_PPB) {
+			slope = measured;
+		}
+	}
+
+	taskENTER_CRITICAL();
+	base_mono_ms = mono;
+	base_offset_ms = offset;
+	slope_ppb = slope;
+	stats.syncs++;
+	stats.last_step_ms = step;
+	stats.drift_ppb = -slope;
+	taskEXIT_CRITICAL();
+
+	ESP_LOGI(TAG, "Clock stepped %d ms after %u s, drift %d ppb", (int)step, (unsigned)(interval / 1000), (int)-slope);
+}
+
+static void time_task(void *arg)
 {
-    initialize_sntp();
+	int polls = 0;
+
+	//SNTP只依赖IP，获取IP之前发出的请求要等lwIP的重试间隔才会重发
+	boot_wait(BOOT_PHASE_NETWORK, portMAX_DELAY);
+	initialize_sntp();
 
-	//等待NTP同步完成
-    int retry = 0;
-    time_t timestamp = 0;
-    while (1) {
-        time(&timestamp);
-		if (timestamp > SECONDS_OF_ONE_YEAR) {
-			break;
+	while (true) {
+		time_poll();
+		if (time_is_synced()) {
+			vTaskDelay(TIME_POLL_MS / portTICK_PERIOD_MS);
+			continue;
 		}
 
-		ESP_LOGI(TAG, "Waiting (%d) more 3s for time sync (current timestamp=%ld) ...", ++retry, timestamp);
-		vTaskDelay(3000 / portTICK_PERIOD_MS);
-    }
+		if (++polls % (TIME_SYNC_LOG_MS / TIME_SYNC_POLL_MS) == 0) {
+			ESP_LOGI(TAG, "Waiting for time sync ...");
+		}
+		vTaskDelay(TIME_SYNC_POLL_MS / portTICK_PERIOD_MS);
+	}
+}
 
-	//获取本地时间
-    struct tm timeinfo;
+/* 描述：启动时间任务，获取IP后开始SNTP同步，不等待同步完成，同步后标记BOOT_PHASE_TIME */
+void time_init(void)
+{
     setenv("TZ", "CST-8", 1);
     tzset();
-	localtime_r(&timestamp, &timeinfo);
 
-	//打印
-    char strftime_buf[20];
-	strftime(strftime_buf, sizeof(strftime_buf), "%Y-%m-%d %H:%M:%S", &timeinfo);
-	ESP_LOGI(TAG, "Time synced, current time is: %s", strftime_buf);
+	xTaskCreate(time_task, "time_task", 2048, NULL, 2, NULL);
 }
@@ -1,5 +1,19 @@
 #ifndef __TIME_H__
 #define __TIME_H__
 
-void wait_time_sync(void);
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct {
+	bool synced;
+	uint32_t syncs;             //检测到的SNTP校时次数，包括第一次同步
+	int32_t last_step_ms;       //最近一次校时时系统时间的跳变量
+	int32_t drift_ppb;          //本机时钟相对UTC的频率偏差估计(十亿分之一)，正数表示本机偏快
+} time_stats_t;
+
+void time_init(void);
+bool time_is_synced(void);
+int64_t time_mono_ms(void);
+int64_t time_epoch_ms(int64_t mono_ms);
+void time_get_stats(time_stats_t *out);
 #endif
@@ -0,0 +1,153 @@
+/* 延迟日志解码器
+ * 把设备通过MQTT发送的二进制日志（/devices/<mac>/log）还原为与ESP_LOGx相同格式的文本，格式表与固件共用dlog_formats.h。
+ * 每行输入为一条消息，最后一个字段是十六进制的消息内容，之前的字段中以'/'开头的视为主题，不以/log结尾的行被忽略，
+ * 因此可以直接读取主机构建的-o输出，或 mosquitto_sub -t '/devices/+/log' -F '%t %x' 的输出 */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+
+#include "dlog_codec.h"
+
+#define LINE_MAX_LEN 8192
+#define TEXT_LEN 256
+
+static const char level_chars[] = "NEWIDV";
+
+static uint32_t messages;
+static uint32_t records;
+static uint32_t dropped;
+static uint32_t invalid;
+
+static int hex_value(char c)
+{
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	c = tolower((unsigned char)c);
+	if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+	return -1;
+}
+
+/* 描述：把十六进制文本转换为字节
+ * 返回值：字节数，含有非十六进制字符或长度为奇数返回-1 */
+static int hex_decode(const char *hex, uint8_t *out, size_t size)
+{
+	size_t len = strlen(hex);
+
+	if (len % 2 != 0 || len / 2 > size) {
+		return -1;
+	}
+	for (size_t i = 0; i < len / 2; i++) {
+		int hi = hex_value(hex[2 * i]);
+		int lo = hex_value(hex[2 * i + 1]);
+		if (hi < 0 || lo < 0) {
+			return -1;
+		}
+		out[i] = hi << 4 | lo;
+	}
+	return len / 2;
+}
+
+static void decode_message(const uint8_t *data, size_t len)
+{
+	char text[TEXT_LEN];
+	dlog_record_t record;
+	int n;
+
+	if (len < DLOG_STREAM_HEADER_LEN || data[0] != DLOG_STREAM_VERSION) {
+		invalid++;
+		return;
+	}
+
+	messages++;
+	uint16_t lost = data[2] | data[3] << 8;
+	if (lost) {
+		printf("W dlog: %u records dropped on device before this message\n", lost);
+		dropped += lost;
+	}
+
+	data += DLOG_STREAM_HEADER_LEN;
+	len -= DLOG_STREAM_HEADER_LEN;
+	while ((n = dlog_decode(data, len, &record)) > 0) {
+		if (dlog_format(text, sizeof(text), &record) < 0) {
+			snprintf(text, sizeof(text), "undecodable record, format %u (decoder older than firmware?)", record.id);
+			invalid++;
+		}
+		char level = record.level < sizeof(level_chars) - 1 ? level_chars[record.level] : '?';
+		printf("%c (%u) %s: %s\n", level, record.timestamp, dlog_tag(record.id), text);
+		records++;
+		data += n;
+		len -= n;
+	}
+	if (len) {
+		invalid++;
+	}
+}
+
+static void decode_line(char *line)
+{
+	static uint8_t data[LINE_MAX_LEN / 2];
+	char *fields[8];
+	int count = 0;
+
+	for (char *p = strtok(line, " \t\r\n"); p && count < sizeof(fields) / sizeof(fields[0]); p = strtok(NULL, " \t\r\n")) {
+		fields[count++] = p;
+	}
+	if (count == 0) {
+		return;
+	}
+
+	//带主题的行只解码日志主题
+	for (int i = 0; i < count - 1; i++) {
+		size_t len = strlen(fields[i]);
+		if (fields[i][0] == '/' && (len < 4 || strcmp(fields[i] + len - 4, "/log") != 0)) {
+			return;
+		}
+	}
+
+	int len = hex_decode(fields[count - 1], data, sizeof(data));
+	if (len < 0) {
+		invalid++;
+		return;
+	}
+	decode_message(data, len);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+			"Usage: %s [FILE]\n"
+			"  Decode deferred log messages from FILE or stdin, one hex encoded message per line\n",
+			name);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	static char line[LINE_MAX_LEN];
+	FILE *in = stdin;
+
+	if (getopt(argc, argv, "") != -1 || argc - optind > 1) {
+		usage(argv[0]);
+	}
+	if (optind < argc && strcmp(argv[optind], "-") != 0) {
+		in = fopen(argv[optind], "r");
+		if (in == NULL) {
+			perror(argv[optind]);
+			return 1;
+		}
+	}
+
+	while (fgets(line, sizeof(line), in)) {
+		decode_line(line);
+	}
+
+	fprintf(stderr, "%u messages, %u records, %u dropped on device, %u invalid\n", messages, records, dropped, invalid);
+	return invalid ? 2 : 0;
+}
@@ -0,0 +1,635 @@
+/* 设备集群压测工具
+ * 在一个进程中模拟大量温度计：使用与固件相同的用户名/密码规则连接MQTT服务器，订阅/devices/<mac>，
+ * 按可配置的周期和抖动向/sensor/temperature发布与mqtt_publish_data()完全一致的报文，并响应set_period命令。
+ * 另有一个监听连接订阅/sensor/temperature，用于统计端到端延迟。
+ * 所有连接都在一个epoll循环中处理 */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <netdb.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "mqtt_lite.h"
+#include "payload.h"
+#include "backoff.h"
+
+#define RX_BUF_LEN 2048
+#define TX_BUF_LEN 4096
+#define KEEPALIVE_SEC 60
+
+typedef enum {
+	DEV_IDLE,
+	DEV_CONNECTING,         //TCP连接中
+	DEV_WAIT_CONNACK,
+	DEV_ONLINE,
+} dev_state_t;
+
+typedef struct {
+	int fd;
+	dev_state_t state;
+	bool monitor;
+	uint8_t mac[6];
+	char mac_string[20];
+	char id[32];
+	char command_topic[40];
+	uint32_t sn;
+	uint32_t period_ms;
+	int16_t temperature;
+	uint16_t humiture;
+	int64_t boot_ms;            //模拟开机时间，报文中的up相对于它计算
+	int64_t next_connect_ms;
+	int64_t next_publish_ms;
+	int64_t next_ping_ms;
+	int64_t connect_start_us;
+	backoff_t backoff;          //与固件相同的重连退避
+	uint8_t rx[RX_BUF_LEN];
+	size_t rx_len;
+	uint8_t tx[TX_BUF_LEN];
+	size_t tx_len;
+} device_t;
+
+//延迟样本，结束时排序计算分位数
+typedef struct {
+	uint32_t *values;
+	size_t count;
+	size_t cap;
+} samples_t;
+
+static struct {
+	const char *host;
+	const char *port;
+	uint32_t devices;
+	uint32_t period_ms;
+	uint32_t jitter_ms;
+	uint32_t connect_rate;
+	uint32_t reconnect_ms;
+	uint32_t reconnect_cap_ms;
+	uint32_t duration_sec;
+	bool monitor;
+} opt = {
+	.host = "127.0.0.1",
+	.port = "1883",
+	.devices = 100,
+	.period_ms = 10000,
+	.jitter_ms = 500,
+	.connect_rate = 0,
+	.reconnect_ms = 2000,
+	.reconnect_cap_ms = 120000,
+	.duration_sec = 60,
+	.monitor = true,
+};
+
+static struct {
+	uint64_t connect_attempts;
+	uint64_t connect_ok;
+	uint64_t connect_failed;
+	uint64_t disconnects;
+	uint64_t publishes;
+	uint64_t publish_bytes;
+	uint64_t tx_dropped;
+	uint64_t commands;
+	uint64_t received;
+	uint32_t online;
+	uint32_t peak_connects_per_sec;
+} stats;
+
+static samples_t connect_latency_us;
+static samples_t e2e_latency_ms;
+static device_t *devices;
+static device_t monitor;
+static int epfd;
+static struct addrinfo *broker_addr;
+static volatile bool stop;
+
+static int64_t now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t now_ms(void)
+{
+	return now_us() / 1000;
+}
+
+//已同步设备上报的UTC时间(ms)
+static int64_t epoch_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void samples_add(samples_t *s, uint32_t v)
+{
+	if (s->count == s->cap) {
+		s->cap = s->cap ? s->cap * 2 : 1024;
+		s->values = realloc(s->values, s->cap * sizeof(uint32_t));
+	}
+	s->values[s->count++] = v;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+static void samples_print(const char *name, const char *unit, samples_t *s)
+{
+	if (s->count == 0) {
+		printf("%-22s no samples\n", name);
+		return;
+	}
+	qsort(s->values, s->count, sizeof(uint32_t), cmp_u32);
+	printf("%-22s n=%zu p50=%u p90=%u p99=%u max=%u %s\n", name, s->count,
+			s->values[s->count * 50 / 100], s->values[s->count * 90 / 100],
+			s->values[s->count * 99 / 100], s->values[s->count - 1], unit);
+}
+
+static int32_t jitter(void)
+{
+	if (opt.jitter_ms == 0) {
+		return 0;
+	}
+	return (int32_t)(random() % (2 * opt.jitter_ms + 1)) - (int32_t)opt.jitter_ms;
+}
+
+static void epoll_update(device_t *dev)
+{
+	struct epoll_event ev = {
+		.events = EPOLLIN | (dev->tx_len || dev->state == DEV_CONNECTING ? EPOLLOUT : 0),
+		.data.ptr = dev,
+	};
+	epoll_ctl(epfd, EPOLL_CTL_MOD, dev->fd, &ev);
+}
+
+static void device_close(device_t *dev, int64_t now)
+{
+	if (dev->fd >= 0) {
+		close(dev->fd);
+		dev->fd = -1;
+	}
+	if (dev->state == DEV_ONLINE) {
+		stats.online--;
+		stats.disconnects++;
+	} else if (dev->state != DEV_IDLE) {
+		stats.connect_failed++;
+	}
+	dev->state = DEV_IDLE;
+	dev->rx_len = 0;
+	dev->tx_len = 0;
+	dev->next_connect_ms = now + backoff_next(&dev->backoff);
+}
+
+static void device_flush(device_t *dev)
+{
+	while (dev->tx_len) {
+		ssize_t n = send(dev->fd, dev->tx, dev->tx_len, MSG_NOSIGNAL);
+		if (n <= 0) {
+			if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+				break;
+			}
+			device_close(dev, now_ms());
+			return;
+		}
+		memmove(dev->tx, dev->tx + n, dev->tx_len - n);
+		dev->tx_len -= n;
+	}
+	epoll_update(dev);
+}
+
+//把报文追加到发送缓冲区，缓冲区满时丢弃（相当于QoS 0丢包）
+static bool device_send(device_t *dev, const uint8_t *data, size_t len)
+{
+	if (len == 0 || dev->tx_len + len > TX_BUF_LEN) {
+		stats.tx_dropped++;
+		return false;
+	}
+	memcpy(dev->tx + dev->tx_len, data, len);
+	dev->tx_len += len;
+	device_flush(dev);
+	return true;
+}
+
+static void device_connect(device_t *dev, int64_t now)
+{
+	dev->fd = socket(broker_addr->ai_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	if (dev->fd < 0) {
+		perror("socket");
+		dev->next_connect_ms = now + backoff_next(&dev->backoff);
+		stats.connect_failed++;
+		return;
+	}
+
+	int one = 1;
+	setsockopt(dev->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	stats.connect_attempts++;
+	dev->connect_start_us = now_us();
+	dev->state = DEV_CONNECTING;
+
+	struct epoll_event ev = {.events = EPOLLIN | EPOLLOUT, .data.ptr = dev};
+	epoll_ctl(epfd, EPOLL_CTL_ADD, dev->fd, &ev);
+
+	if (connect(dev->fd, broker_addr->ai_addr, broker_addr->ai_addrlen) < 0 && errno != EINPROGRESS) {
+		device_close(dev, now);
+	}
+}
+
+//TCP连接建立后发送CONNECT
+static void device_tcp_connected(device_t *dev)
+{
+	int err = 0;
+	socklen_t len = sizeof(err);
+	getsockopt(dev->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+	if (err) {
+		device_close(dev, now_ms());
+		return;
+	}
+
+	uint8_t buf[256];
+	dev->state = DEV_WAIT_CONNACK;
+	device_send(dev, buf, mqtt_encode_connect(buf, sizeof(buf), dev->id, dev->id, dev->id, KEEPALIVE_SEC));
+}
+
+static void device_publish(device_t *dev, int64_t now)
+{
+	//温湿度在真实范围内随机游走
+	dev->temperature += (int)(random() % 11) - 5;
+	dev->humiture += (int)(random() % 11) - 5;
+	if (dev->temperature < -2000 || dev->temperature > 12500) {
+		dev->temperature = 2500;
+	}
+	if (dev->humiture > 10000) {
+		dev->humiture = 5000;
+	}
+
+	payload_sample_t sample = {
+		.mono_ms = now - dev->boot_ms,
+		.time_ms = epoch_ms(),
+		.temperature = dev->temperature,
+		.humiture = dev->humiture,
+		.count = 1,
+	};
+	payload_report_t report = {
+		.mac = dev->mac_string,
+		.mac_addr = dev->mac,
+		.sn = dev->sn,
+		.samples = &sample,
+		.count = 1,
+	};
+
+	char json[PAYLOAD_JSON_LEN(1)];
+	int len = payload_encode_json(json, sizeof(json), &report);
+	uint8_t buf[PAYLOAD_JSON_LEN(1) + 64];
+	if (len > 0 && device_send(dev, buf, mqtt_encode_publish(buf, sizeof(buf), "/sensor/temperature", (uint8_t *)json, len))) {
+		stats.publishes++;
+		stats.publish_bytes += len;
+		dev->next_ping_ms = now + KEEPALIVE_SEC * 1000 / 2;
+	}
+}
+
+//处理/devices/<mac>上的命令，与固件一样支持set_period
+static void device_command(device_t *dev, const uint8_t *payload, size_t len)
+{
+	char text[256];
+	len = len < sizeof(text) - 1 ? len : sizeof(text) - 1;
+	memcpy(text, payload, len);
+	text[len] = '\0';
+
+	stats.commands++;
+	if (strstr(text, "\"set_period\"") == NULL) {
+		return;
+	}
+	const char *value = strstr(text, "\"value\"");
+	if (value && (value = strchr(value, ':'))) {
+		long period = strtol(value + 1, NULL, 10);
+		if (period > 0) {
+			dev->period_ms = period;
+		}
+	}
+}
+
+//监听连接收到上报，根据MAC找到设备并计算端到端延迟
+static void monitor_report(const uint8_t *payload, size_t len, int64_t now)
+{
+	char text[PAYLOAD_JSON_LEN(16)];
+	len = len < sizeof(text) - 1 ? len : sizeof(text) - 1;
+	memcpy(text, payload, len);
+	text[len] = '\0';
+
+	unsigned m[6];
+	const char *mac = strstr(text, "\"mac\":\"");
+	const char *up = strstr(text, "\"up\":");
+	if (mac == NULL || up == NULL ||
+			sscanf(mac + 7, "%02X:%02X:%02X:%02X:%02X:%02X", &m[0], &m[1], &m[2], &m[3], &m[4], &m[5]) != 6) {
+		return;
+	}
+
+	uint32_t index = (m[3] << 16 | m[4] << 8 | m[5]) - 1;
+	if (index >= opt.devices) {
+		return;
+	}
+
+	stats.received++;
+	int64_t sent = devices[index].boot_ms + strtoll(up + 5, NULL, 10);
+	samples_add(&e2e_latency_ms, now > sent ? now - sent : 0);
+}
+
+static void device_packet(device_t *dev, const mqtt_packet_t *packet, int64_t now)
+{
+	uint8_t buf[128];
+
+	switch (packet->type & 0xF0) {
+		case MQTT_CONNACK:
+			if (packet->body_len < 2 || packet->body[1] != 0) {
+				device_close(dev, now);
+				return;
+			}
+			if (!dev->monitor) {
+				samples_add(&connect_latency_us, now_us() - dev->connect_start_us);
+			}
+			stats.connect_ok++;
+			stats.online++;
+			backoff_reset(&dev->backoff);
+			dev->state = DEV_ONLINE;
+			dev->next_ping_ms = now + KEEPALIVE_SEC * 1000 / 2;
+			device_send(dev, buf, mqtt_encode_subscribe(buf, sizeof(buf), 1, dev->monitor ? "/sensor/temperature" : dev->command_topic));
+			//首次上报分散在一个周期内
+			dev->next_publish_ms = now + random() % dev->period_ms;
+			break;
+
+		case MQTT_PUBLISH: {
+			const char *topic;
+			size_t topic_len, payload_len;
+			const uint8_t *payload;
+			if (mqtt_publish_parse(packet, &topic, &topic_len, &payload, &payload_len) != 0) {
+				break;
+			}
+			if (dev->monitor) {
+				monitor_report(payload, payload_len, now);
+			} else {
+				device_command(dev, payload, payload_len);
+			}
+			break;
+		}
+
+		default:
+			break;
+	}
+}
+
+static void device_read(device_t *dev, int64_t now)
+{
+	while (true) {
+		ssize_t n = recv(dev->fd, dev->rx + dev->rx_len, RX_BUF_LEN - dev->rx_len, 0);
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			break;
+		}
+		if (n <= 0) {
+			device_close(dev, now);
+			return;
+		}
+		dev->rx_len += n;
+
+		while (true) {
+			mqtt_packet_t packet;
+			int used = mqtt_decode(dev->rx, dev->rx_len, &packet);
+			if (used < 0) {
+				device_close(dev, now);
+				return;
+			}
+			if (used == 0) {
+				break;
+			}
+			device_packet(dev, &packet, now);
+			if (dev->fd < 0) {
+				return;
+			}
+			memmove(dev->rx, dev->rx + used, dev->rx_len - used);
+			dev->rx_len -= used;
+		}
+
+		//单个报文超过接收缓冲区
+		if (dev->rx_len == RX_BUF_LEN) {
+			device_close(dev, now);
+			return;
+		}
+	}
+}
+
+static void device_init(device_t *dev, uint32_t index, int64_t now)
+{
+	memset(dev, 0, sizeof(*dev));
+	dev->fd = -1;
+	dev->mac[0] = 0x24;
+	dev->mac[1] = 0x0A;
+	dev->mac[2] = 0xC4;
+	dev->mac[3] = (index + 1) >> 16;
+	dev->mac[4] = (index + 1) >> 8;
+	dev->mac[5] = index + 1;
+	sprintf(dev->mac_string, "%02X:%02X:%02X:%02X:%02X:%02X", dev->mac[0], dev->mac[1], dev->mac[2], dev->mac[3], dev->mac[4], dev->mac[5]);
+	//与esp-mqtt的platform_create_id_string()相同，固件把它同时作为用户名和密码
+	sprintf(dev->id, "ESP32_%02x%02X%02X", dev->mac[3], dev->mac[4], dev->mac[5]);
+	sprintf(dev->command_topic, "/devices/%s", dev->mac_string);
+	dev->sn = 0x10000000 + index;
+	dev->period_ms = opt.period_ms;
+	dev->temperature = 2000 + random() % 1000;
+	dev->humiture = 4000 + random() % 2000;
+	dev->boot_ms = now;
+	backoff_init(&dev->backoff, opt.reconnect_ms, opt.reconnect_cap_ms, dev->mac);
+	dev->next_connect_ms = now + (opt.connect_rate ? (int64_t)index * 1000 / opt.connect_rate : 0);
+}
+
+static void tick(int64_t now)
+{
+	static int64_t last_connect_sec;
+	static uint32_t connects_this_sec;
+
+	for (uint32_t i = 0; i < opt.devices + opt.monitor; i++) {
+		device_t *dev = i < opt.devices ? &devices[i] : &monitor;
+
+		if (dev->state == DEV_IDLE && now >= dev->next_connect_ms) {
+			if (now / 1000 != last_connect_sec) {
+				last_connect_sec = now / 1000;
+				connects_this_sec = 0;
+			}
+			connects_this_sec++;
+			if (connects_this_sec > stats.peak_connects_per_sec) {
+				stats.peak_connects_per_sec = connects_this_sec;
+			}
+			device_connect(dev, now);
+			continue;
+		}
+
+		if (dev->state != DEV_ONLINE) {
+			continue;
+		}
+
+		if (!dev->monitor && now >= dev->next_publish_ms) {
+			device_publish(dev, now);
+			dev->next_publish_ms += dev->period_ms + jitter();
+			if (dev->next_publish_ms < now) {
+				dev->next_publish_ms = now + dev->period_ms;
+			}
+		}
+
+		if (dev->state == DEV_ONLINE && now >= dev->next_ping_ms) {
+			uint8_t buf[2];
+			device_send(dev, buf, mqtt_encode_pingreq(buf, sizeof(buf)));
+			dev->next_ping_ms = now + KEEPALIVE_SEC * 1000 / 2;
+		}
+	}
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+			"Usage: %s [options]\n"
+			"  -H HOST    broker host (default 127.0.0.1)\n"
+			"  -p PORT    broker port (default 1883)\n"
+			"  -n N       number of simulated devices (default 100)\n"
+			"  -P MS      report period (default 10000)\n"
+			"  -j MS      report jitter, +/- (default 500)\n"
+			"  -r N       connect at most N devices per second, 0 connects all at once (default 0)\n"
+			"  -R MS      initial reconnect backoff, doubled per failure with MAC-seeded jitter like the firmware (default 2000)\n"
+			"  -C MS      maximum reconnect backoff (default 120000)\n"
+			"  -t SEC     test duration (default 60)\n"
+			"  -M         do not run the latency monitor connection\n",
+			name);
+	exit(1);
+}
+
+static void on_signal(int sig)
+{
+	stop = true;
+}
+
+int main(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "H:p:n:P:j:r:R:C:t:M")) != -1) {
+		switch (c) {
+			case 'H': opt.host = optarg; break;
+			case 'p': opt.port = optarg; break;
+			case 'n': opt.devices = atoi(optarg); break;
+			case 'P': opt.period_ms = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+			case 'j': opt.jitter_ms = atoi(optarg); break;
+			case 'r': opt.connect_rate = atoi(optarg); break;
+			case 'R': opt.reconnect_ms = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+			case 'C': opt.reconnect_cap_ms = atoi(optarg); break;
+			case 't': opt.duration_sec = atoi(optarg); break;
+			case 'M': opt.monitor = false; break;
+			default: usage(argv[0]);
+		}
+	}
+
+	struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+	int ret = getaddrinfo(opt.host, opt.port, &hints, &broker_addr);
+	if (ret != 0) {
+		fprintf(stderr, "%s: %s\n", opt.host, gai_strerror(ret));
+		return 1;
+	}
+
+	//每个设备一个套接字，尽量放开文件描述符限制
+	struct rlimit rl;
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+		if (rl.rlim_cur < opt.devices + 16) {
+			fprintf(stderr, "Warning: open file limit %lu is below %u devices\n", (unsigned long)rl.rlim_cur, opt.devices);
+		}
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGPIPE, SIG_IGN);
+	srandom(1);
+
+	epfd = epoll_create1(0);
+	devices = calloc(opt.devices, sizeof(device_t));
+	int64_t start = now_ms();
+	for (uint32_t i = 0; i < opt.devices; i++) {
+		device_init(&devices[i], i, start);
+	}
+	device_init(&monitor, 0xFFFFFE, start);
+	monitor.monitor = true;
+	monitor.next_connect_ms = start;
+	sprintf(monitor.id, "loadgen_monitor_%d", getpid());
+
+	printf("%u devices -> %s:%s, period %u ms +/- %u ms, connect rate %u/s\n",
+			opt.devices, opt.host, opt.port, opt.period_ms, opt.jitter_ms, opt.connect_rate);
+
+	int64_t next_report = start + 1000;
+	uint64_t last_publishes = 0, last_received = 0, last_attempts = 0;
+	struct epoll_event events[256];
+
+	while (!stop && now_ms() - start < (int64_t)opt.duration_sec * 1000) {
+		int n = epoll_wait(epfd, events, 256, 5);
+		int64_t now = now_ms();
+
+		for (int i = 0; i < n; i++) {
+			device_t *dev = events[i].data.ptr;
+			if (dev->fd < 0) {
+				continue;
+			}
+			if (dev->state == DEV_CONNECTING && (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+				device_tcp_connected(dev);
+				continue;
+			}
+			if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+				device_read(dev, now);
+			}
+			if (dev->fd >= 0 && (events[i].events & EPOLLOUT)) {
+				device_flush(dev);
+			}
+		}
+
+		tick(now);
+
+		if (now >= next_report) {
+			printf("t=%3llds online=%u connects=%llu failed=%llu att/s=%llu pub/s=%llu recv/s=%llu dropped=%llu\n",
+					(long long)(now - start) / 1000, stats.online,
+					(unsigned long long)stats.connect_ok, (unsigned long long)stats.connect_failed,
+					(unsigned long long)(stats.connect_attempts - last_attempts),
+					(unsigned long long)(stats.publishes - last_publishes),
+					(unsigned long long)(stats.received - last_received),
+					(unsigned long long)stats.tx_dropped);
+			fflush(stdout);
+			last_publishes = stats.publishes;
+			last_received = stats.received;
+			last_attempts = stats.connect_attempts;
+			next_report += 1000;
+		}
+	}
+
+	double elapsed = (now_ms() - start) / 1000.0;
+	printf("\n--- loadgen summary ---\n");
+	printf("duration               %.1f s\n", elapsed);
+	printf("connect attempts       %llu (ok %llu, failed %llu, peak %u/s)\n",
+			(unsigned long long)stats.connect_attempts, (unsigned long long)stats.connect_ok,
+			(unsigned long long)stats.connect_failed, stats.peak_connects_per_sec);
+	printf("disconnects            %llu\n", (unsigned long long)stats.disconnects);
+	printf("publishes              %llu (%.1f/s, %llu payload bytes, %llu dropped)\n",
+			(unsigned long long)stats.publishes, stats.publishes / elapsed,
+			(unsigned long long)stats.publish_bytes, (unsigned long long)stats.tx_dropped);
+	printf("commands received      %llu\n", (unsigned long long)stats.commands);
+	printf("reports seen by monitor %llu\n", (unsigned long long)stats.received);
+	samples_print("connect latency", "us", &connect_latency_us);
+	samples_print("end-to-end latency", "ms", &e2e_latency_ms);
+
+	return 0;
+}
@@ -0,0 +1,162 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "mqtt_lite.h"
+
+//写入剩余长度字段，返回占用的字节数
+static size_t put_remaining_length(uint8_t *p, size_t len)
+{
+	size_t n = 0;
+
+	do {
+		uint8_t byte = len % 128;
+		len /= 128;
+		p[n++] = len ? byte | 0x80 : byte;
+	} while (len);
+	return n;
+}
+
+static size_t put_string(uint8_t *p, const char *s)
+{
+	size_t len = strlen(s);
+
+	p[0] = len >> 8;
+	p[1] = len;
+	memcpy(&p[2], s, len);
+	return len + 2;
+}
+
+/* 描述：按固定头、剩余长度、内容的顺序组包
+ * 返回值：报文长度，缓冲区不足返回0 */
+static size_t finish(uint8_t *buf, size_t size, uint8_t type, const uint8_t *body, size_t body_len)
+{
+	uint8_t len_buf[4];
+	size_t len_size = put_remaining_length(len_buf, body_len);
+
+	if (1 + len_size + body_len > size) {
+		return 0;
+	}
+	buf[0] = type;
+	memcpy(&buf[1], len_buf, len_size);
+	memmove(&buf[1 + len_size], body, body_len);
+	return 1 + len_size + body_len;
+}
+
+size_t mqtt_encode_connect(uint8_t *buf, size_t size, const char *client_id, const char *username, const char *password, uint16_t keepalive)
+{
+	uint8_t body[256];
+	size_t n = 0;
+
+	if (10 + 6 + strlen(client_id) + strlen(username) + strlen(password) > sizeof(body)) {
+		return 0;
+	}
+
+	n += put_string(&body[n], "MQTT");
+	body[n++] = 4;          //协议级别3.1.1
+	body[n++] = 0xC2;       //用户名、密码、清除会话
+	body[n++] = keepalive >> 8;
+	body[n++] = keepalive;
+	n += put_string(&body[n], client_id);
+	n += put_string(&body[n], username);
+	n += put_string(&body[n], password);
+
+	return finish(buf, size, MQTT_CONNECT, body, n);
+}
+
+size_t mqtt_encode_subscribe(uint8_t *buf, size_t size, uint16_t packet_id, const char *topic)
+{
+	uint8_t body[128];
+	size_t n = 0;
+
+	if (5 + strlen(topic) > sizeof(body)) {
+		return 0;
+	}
+
+	body[n++] = packet_id >> 8;
+	body[n++] = packet_id;
+	n += put_string(&body[n], topic);
+	body[n++] = 0;          //QoS 0
+
+	return finish(buf, size, MQTT_SUBSCRIBE, body, n);
+}
+
+size_t mqtt_encode_publish(uint8_t *buf, size_t size, const char *topic, const uint8_t *payload, size_t payload_len)
+{
+	size_t topic_len = strlen(topic);
+	size_t body_len = 2 + topic_len + payload_len;
+	uint8_t len_buf[4];
+	size_t len_size = put_remaining_length(len_buf, body_len);
+
+	if (1 + len_size + body_len > size) {
+		return 0;
+	}
+
+	uint8_t *p = buf;
+	*p++ = MQTT_PUBLISH;
+	memcpy(p, len_buf, len_size);
+	p += len_size;
+	p += put_string(p, topic);
+	memcpy(p, payload, payload_len);
+	return 1 + len_size + body_len;
+}
+
+size_t mqtt_encode_pingreq(uint8_t *buf, size_t size)
+{
+	return finish(buf, size, MQTT_PINGREQ, NULL, 0);
+}
+
+/* 描述：从接收缓冲区中解析一个完整报文
+ * 返回值：报文总长度，数据不完整返回0，格式错误返回-1 */
+int mqtt_decode(const uint8_t *buf, size_t len, mqtt_packet_t *packet)
+{
+	size_t remaining = 0;
+	size_t i = 1;
+	int shift = 0;
+
+	while (true) {
+		if (i >= len) {
+			return 0;
+		}
+		if (i > 4) {
+			return -1;
+		}
+		remaining |= (size_t)(buf[i] & 0x7F) << shift;
+		shift += 7;
+		if ((buf[i++] & 0x80) == 0) {
+			break;
+		}
+	}
+
+	if (len < i + remaining) {
+		return 0;
+	}
+
+	packet->type = buf[0];
+	packet->body = &buf[i];
+	packet->body_len = remaining;
+	return i + remaining;
+}
+
+/* 描述：解析PUBLISH报文的主题和负载，只支持QoS 0
+ * 返回值：成功返回0 */
+int mqtt_publish_parse(const mqtt_packet_t *packet, const char **topic, size_t *topic_len, const uint8_t **payload, size_t *payload_len)
+{
+	if ((packet->type & 0xF0) != MQTT_PUBLISH || packet->body_len < 2) {
+		return -1;
+	}
+
+	size_t tlen = (packet->body[0] << 8) | packet->body[1];
+	size_t offset = 2 + tlen;
+	if ((packet->type & 0x06) != 0) {
+		offset += 2;        //QoS>0时跳过报文标识符
+	}
+	if (offset > packet->body_len) {
+		return -1;
+	}
+
+	*topic = (const char *)&packet->body[2];
+	*topic_len = tlen;
+	*payload = &packet->body[offset];
+	*payload_len = packet->body_len - offset;
+	return 0;
+}
@@ -0,0 +1,31 @@
+#ifndef __MQTT_LITE_H__
+#define __MQTT_LITE_H__
+#include <stdint.h>
+#include <stddef.h>
+
+/* 压测工具使用的最小MQTT 3.1.1编解码，只支持QoS 0发布和订阅 */
+
+#define MQTT_CONNECT     0x10
+#define MQTT_CONNACK     0x20
+#define MQTT_PUBLISH     0x30
+#define MQTT_PUBACK      0x40
+#define MQTT_SUBSCRIBE   0x82
+#define MQTT_SUBACK      0x90
+#define MQTT_PINGREQ     0xC0
+#define MQTT_PINGRESP    0xD0
+#define MQTT_DISCONNECT  0xE0
+
+//一个完整的报文
+typedef struct {
+	uint8_t type;               //固定头第一个字节
+	const uint8_t *body;        //可变头和负载
+	size_t body_len;
+} mqtt_packet_t;
+
+size_t mqtt_encode_connect(uint8_t *buf, size_t size, const char *client_id, const char *username, const char *password, uint16_t keepalive);
+size_t mqtt_encode_subscribe(uint8_t *buf, size_t size, uint16_t packet_id, const char *topic);
+size_t mqtt_encode_publish(uint8_t *buf, size_t size, const char *topic, const uint8_t *payload, size_t payload_len);
+size_t mqtt_encode_pingreq(uint8_t *buf, size_t size);
+int mqtt_decode(const uint8_t *buf, size_t len, mqtt_packet_t *packet);
+int mqtt_publish_parse(const mqtt_packet_t *packet, const char **topic, size_t *topic_len, const uint8_t **payload, size_t *payload_len);
+#endif
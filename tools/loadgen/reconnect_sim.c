@@ -0,0 +1,240 @@
+/* 重连风暴模拟
+ * 不连接服务器，按10ms步长离线模拟一批设备在同一时刻断线之后的重连过程：
+ * 服务器（或热点）在开始时下线，-d秒后恢复，恢复后每秒最多接受-c个连接，超出的连接被拒绝，设备按各自的策略再次尝试。
+ * 同时模拟两种策略并逐段输出每秒的连接尝试数和在线设备数：
+ *   fixed    固定间隔重连，所有设备同步重试，与esp-mqtt默认的reconnect_timeout_ms行为一致
+ *   backoff  固件使用的backoff.c，指数退避加MAC地址种子的抖动 */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "backoff.h"
+
+#define STEP_MS 10
+#define BAR_WIDTH 50
+
+typedef enum {
+	POLICY_FIXED,
+	POLICY_BACKOFF,
+	POLICY_NUM,
+} policy_t;
+
+typedef struct {
+	uint8_t mac[6];
+	bool online;
+	int64_t next_attempt_ms;
+	backoff_t backoff;
+} sim_device_t;
+
+typedef struct {
+	uint32_t attempts;
+	uint32_t accepted;
+	uint32_t peak;              //时间段内单秒最多的尝试次数
+	uint32_t online;            //时间段结束时在线的设备数
+} sim_bin_t;
+
+typedef struct {
+	uint32_t attempts;
+	uint32_t peak_attempts_per_sec;
+	uint32_t peak_after_outage;     //服务器恢复后单秒最多的尝试次数
+	int64_t recovered_ms;       //最后一台设备上线的时间，未全部上线为-1
+	sim_bin_t *bins;
+} sim_result_t;
+
+static const char *policy_names[POLICY_NUM] = {"fixed", "backoff"};
+
+static struct {
+	uint32_t devices;
+	uint32_t outage_sec;
+	uint32_t capacity;
+	uint32_t fixed_ms;
+	uint32_t base_ms;
+	uint32_t cap_ms;
+	uint32_t bin_sec;
+	uint32_t duration_sec;
+} opt = {
+	.devices = 1000,
+	.outage_sec = 30,
+	.capacity = 50,
+	.fixed_ms = 10000,
+	.base_ms = 2000,
+	.cap_ms = 120000,
+	.bin_sec = 5,
+	.duration_sec = 300,
+};
+
+//与loadgen相同的MAC地址分配
+static void device_init(sim_device_t *dev, uint32_t index)
+{
+	memset(dev, 0, sizeof(*dev));
+	dev->mac[0] = 0x24;
+	dev->mac[1] = 0x0A;
+	dev->mac[2] = 0xC4;
+	dev->mac[3] = (index + 1) >> 16;
+	dev->mac[4] = (index + 1) >> 8;
+	dev->mac[5] = index + 1;
+	backoff_init(&dev->backoff, opt.base_ms, opt.cap_ms, dev->mac);
+}
+
+static uint32_t next_delay(sim_device_t *dev, policy_t policy)
+{
+	return policy == POLICY_FIXED ? opt.fixed_ms : backoff_next(&dev->backoff);
+}
+
+static void simulate(policy_t policy, sim_result_t *result)
+{
+	sim_device_t *devices = calloc(opt.devices, sizeof(sim_device_t));
+	uint32_t bin_num = (opt.duration_sec + opt.bin_sec - 1) / opt.bin_sec;
+	uint32_t online = 0;
+	uint32_t accepted_this_sec = 0;
+	uint32_t attempts_this_sec = 0;
+
+	memset(result, 0, sizeof(*result));
+	result->bins = calloc(bin_num, sizeof(sim_bin_t));
+	result->recovered_ms = -1;
+
+	//所有设备在0时刻断线
+	for (uint32_t i = 0; i < opt.devices; i++) {
+		device_init(&devices[i], i);
+		devices[i].next_attempt_ms = next_delay(&devices[i], policy);
+	}
+
+	for (int64_t now = 0; now < (int64_t)opt.duration_sec * 1000; now += STEP_MS) {
+		sim_bin_t *bin = &result->bins[now / 1000 / opt.bin_sec];
+		bool broker_up = now >= (int64_t)opt.outage_sec * 1000;
+
+		if (now % 1000 == 0) {
+			accepted_this_sec = 0;
+			attempts_this_sec = 0;
+		}
+
+		for (uint32_t i = 0; i < opt.devices; i++) {
+			sim_device_t *dev = &devices[i];
+			if (dev->online || now < dev->next_attempt_ms) {
+				continue;
+			}
+
+			result->attempts++;
+			bin->attempts++;
+			attempts_this_sec++;
+			if (broker_up && accepted_this_sec < opt.capacity) {
+				accepted_this_sec++;
+				bin->accepted++;
+				dev->online = true;
+				backoff_reset(&dev->backoff);
+				online++;
+				if (online == opt.devices) {
+					result->recovered_ms = now;
+				}
+			} else {
+				dev->next_attempt_ms = now + next_delay(dev, policy);
+			}
+		}
+
+		if (attempts_this_sec > result->peak_attempts_per_sec) {
+			result->peak_attempts_per_sec = attempts_this_sec;
+		}
+		if (broker_up && attempts_this_sec > result->peak_after_outage) {
+			result->peak_after_outage = attempts_this_sec;
+		}
+		if (attempts_this_sec > bin->peak) {
+			bin->peak = attempts_this_sec;
+		}
+		bin->online = online;
+	}
+
+	free(devices);
+}
+
+static void print_result(policy_t policy, const sim_result_t *result)
+{
+	uint32_t bin_num = (opt.duration_sec + opt.bin_sec - 1) / opt.bin_sec;
+	uint32_t max_rate = 1;
+
+	for (uint32_t i = 0; i < bin_num; i++) {
+		if (result->bins[i].attempts / opt.bin_sec > max_rate) {
+			max_rate = result->bins[i].attempts / opt.bin_sec;
+		}
+	}
+
+	printf("\n%s: connection attempts per second, averaged over %u s\n", policy_names[policy], opt.bin_sec);
+	printf("%6s %8s %8s %8s %7s\n", "t(s)", "att/s", "peak/s", "ok/s", "online");
+	for (uint32_t i = 0; i < bin_num; i++) {
+		const sim_bin_t *bin = &result->bins[i];
+		uint32_t rate = bin->attempts / opt.bin_sec;
+		char bar[BAR_WIDTH + 1];
+		int width = (uint64_t)rate * BAR_WIDTH / max_rate;
+		memset(bar, '#', width);
+		bar[width] = '\0';
+		printf("%6u %8u %8u %8u %7u %s\n", i * opt.bin_sec, rate, bin->peak, bin->accepted / opt.bin_sec, bin->online, bar);
+		//全部上线后不再输出
+		if (bin->online == opt.devices && bin->attempts == 0) {
+			break;
+		}
+	}
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+			"Usage: %s [options]\n"
+			"  -n N       number of devices (default 1000)\n"
+			"  -d SEC     broker outage, all devices disconnect at t=0 (default 30)\n"
+			"  -c N       connections the broker accepts per second after the outage (default 50)\n"
+			"  -f MS      reconnect interval of the fixed policy (default 10000)\n"
+			"  -b MS      initial backoff of the backoff policy (default 2000)\n"
+			"  -m MS      maximum backoff of the backoff policy (default 120000)\n"
+			"  -i SEC     histogram bin width (default 5)\n"
+			"  -t SEC     simulated time (default 300)\n",
+			name);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int c;
+	sim_result_t results[POLICY_NUM];
+
+	while ((c = getopt(argc, argv, "n:d:c:f:b:m:i:t:")) != -1) {
+		switch (c) {
+			case 'n': opt.devices = atoi(optarg); break;
+			case 'd': opt.outage_sec = atoi(optarg); break;
+			case 'c': opt.capacity = atoi(optarg); break;
+			case 'f': opt.fixed_ms = atoi(optarg) > 0 ? atoi(optarg) : STEP_MS; break;
+			case 'b': opt.base_ms = atoi(optarg) > 0 ? atoi(optarg) : STEP_MS; break;
+			case 'm': opt.cap_ms = atoi(optarg); break;
+			case 'i': opt.bin_sec = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+			case 't': opt.duration_sec = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+			default: usage(argv[0]);
+		}
+	}
+
+	printf("%u devices, broker down for %u s then accepts %u connections/s\n",
+			opt.devices, opt.outage_sec, opt.capacity);
+	printf("fixed: retry every %u ms; backoff: %u ms doubling up to %u ms with MAC-seeded jitter\n",
+			opt.fixed_ms, opt.base_ms, opt.cap_ms);
+
+	for (int p = 0; p < POLICY_NUM; p++) {
+		simulate(p, &results[p]);
+		print_result(p, &results[p]);
+	}
+
+	printf("\n--- reconnect summary ---\n");
+	printf("%-8s %10s %12s %18s %14s\n", "policy", "attempts", "peak att/s", "peak after outage", "all online at");
+	for (int p = 0; p < POLICY_NUM; p++) {
+		char recovered[24];
+		if (results[p].recovered_ms < 0) {
+			snprintf(recovered, sizeof(recovered), "> %u s", opt.duration_sec);
+		} else {
+			snprintf(recovered, sizeof(recovered), "%.1f s", results[p].recovered_ms / 1000.0);
+		}
+		printf("%-8s %10u %12u %18u %14s\n", policy_names[p], results[p].attempts, results[p].peak_attempts_per_sec,
+				results[p].peak_after_outage, recovered);
+		free(results[p].bins);
+	}
+
+	return 0;
+}